@@ -0,0 +1,154 @@
+#include "arena.h"
+
+
+
+/* Round a size up to a whole number of cache lines.
+ */
+static inline size_t __arena_align(const size_t size)
+{
+	return (size + STARBOARD_ARENA_ALIGNMENT - 1) / STARBOARD_ARENA_ALIGNMENT * STARBOARD_ARENA_ALIGNMENT;
+}
+
+
+
+/* The header of a block takes up whole cache lines, so that its first allocation is aligned.
+ */
+#define STARBOARD_ARENA_HEADER ((sizeof(arena_block_t) + STARBOARD_ARENA_ALIGNMENT - 1) / \
+                                STARBOARD_ARENA_ALIGNMENT * STARBOARD_ARENA_ALIGNMENT)
+
+
+
+/* Allocate a new block with room for at least size bytes, and put it at the head of the chain.
+ * Returns the block, or NULL if out of memory.
+ */
+static arena_block_t* _arena_push_block(arena_t* arena, const size_t size)
+{
+	const size_t   bytes = __arena_align(size);
+	arena_block_t* block = (arena_block_t*)aligned_alloc(STARBOARD_ARENA_ALIGNMENT, STARBOARD_ARENA_HEADER + bytes);
+	                       // malloc block
+	if (block == NULL)
+		return NULL;
+	block->next = arena->head;
+	block->size = bytes;
+	block->used = 0;
+	arena->head = block;
+	return block;
+}
+
+
+
+/* Create an arena with one block of the given size.
+ * Returns: 0 success; -2 out of memory.
+ */
+int arena_init(arena_t* arena, const size_t size)
+{
+	arena->head = NULL;
+	arena->used = 0;
+	arena->peak = 0;
+	return (_arena_push_block(arena, (size > 0) ? size : STARBOARD_ARENA_BLOCK_MIN) == NULL) ? -2 : 0;
+}
+
+
+
+/* Take size bytes from the arena, aligned to STARBOARD_ARENA_ALIGNMENT. The memory is not zeroed.
+ * Returns the memory, or NULL if out of memory.
+ */
+void* arena_alloc(arena_t* arena, const size_t size)
+{
+	const size_t   bytes = __arena_align((size > 0) ? size : 1);
+	arena_block_t* block = arena->head;
+	if (block == NULL or block->size - block->used < bytes)
+	{
+		// Chain on a block at least twice as large as the last, so that repeated overflows stay few.
+		size_t grow = (block != NULL) ? 2 * block->size : 0;
+		if (grow < STARBOARD_ARENA_BLOCK_MIN)
+			grow = STARBOARD_ARENA_BLOCK_MIN;
+		block = _arena_push_block(arena, (bytes > grow) ? bytes : grow);
+		if (block == NULL)
+		{
+			printf("[ERROR] %s\n", "Could not grow arena; out of memory.");
+			return NULL;
+		}
+	}
+	void* out    = (char*)block + STARBOARD_ARENA_HEADER + block->used;
+	block->used += bytes;
+	arena->used += bytes;
+	if (arena->used > arena->peak)
+		arena->peak = arena->used;
+	return out;
+}
+
+
+
+/* Remember the current position in the arena.
+ */
+arena_mark_t arena_mark(const arena_t* arena)
+{
+	arena_mark_t mark = {arena->head, (arena->head != NULL) ? arena->head->used : 0};
+	return mark;
+}
+
+
+
+/* Give back everything allocated since the mark was taken, freeing any blocks chained on since.
+ */
+void arena_release(arena_t* arena, const arena_mark_t mark)
+{
+	while (arena->head != NULL and arena->head != mark.block)
+	{
+		arena_block_t* next = arena->head->next;
+		arena->used -= arena->head->used;
+		free(arena->head);
+		arena->head = next;
+	}
+	if (arena->head != NULL)
+	{
+		arena->used      -= arena->head->used - mark.used;
+		arena->head->used = mark.used;
+	}
+}
+
+
+
+/* Count the bytes in use across all blocks.
+ */
+size_t arena_used(const arena_t* arena)
+{
+	return arena->used;
+}
+
+
+
+/* Give back everything in the arena. If it ever needed more than one block, it is replaced by a single block
+ * as large as its peak use, so the next build of the same geometry fits without chaining.
+ * REMARK. If that block cannot be allocated, the arena is left empty, and will grow on demand.
+ */
+void arena_reset(arena_t* arena)
+{
+	if (arena->head != NULL and arena->head->next == NULL)
+	{
+		arena->head->used = 0;
+		arena->used       = 0;
+		return;
+	}
+	const size_t peak = arena->peak;
+	arena_free(arena);
+	_arena_push_block(arena, peak);
+	arena->peak = 0;
+}
+
+
+
+/* Free every block of the arena.
+ */
+void arena_free(arena_t* arena)
+{
+	while (arena->head != NULL)
+	{
+		arena_block_t* next = arena->head->next;
+		free(arena->head);
+		arena->head = next;
+	}
+	arena->used = 0;
+	arena->peak = 0;
+}
@@ -0,0 +1,71 @@
+#ifndef STARBOARD_ARENA
+#define STARBOARD_ARENA
+
+#include <iso646.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+
+//
+// A bump allocator for the geometry of one object. Every stage of the pipeline from the chain's columns to the
+// ribbon takes its arrays from the object's arena, which is sized ahead of time from the chain, so building the
+// geometry makes one allocation rather than dozens. Nothing is freed on its own: the whole arena is reset before
+// the geometry is rebuilt, and freed with the object. Scratch space that a stage needs only while it runs is
+// given back by releasing the arena to a mark taken beforehand.
+//
+// If a request does not fit, another block is chained on rather than failing, and the next reset merges the
+// blocks into one large enough for everything that was allocated.
+//
+
+#define STARBOARD_ARENA_ALIGNMENT   64               // Every allocation starts on a cache line.
+#define STARBOARD_ARENA_BLOCK_MIN   (64 * 1024)      // The smallest block worth chaining on.
+#define STARBOARD_ARENA_PER_RESIDUE 768              // Bytes of geometry per residue, for sizing the arena.
+
+
+
+/* One block of memory, with the allocations following its header. Blocks are chained newest first.
+ */
+typedef struct arena_block
+{
+	struct arena_block* next;
+	size_t              size;    // Bytes after the header.
+	size_t              used;
+} arena_block_t;
+
+
+
+/* An arena, which is the chain of its blocks.
+ */
+typedef struct arena
+{
+	arena_block_t* head;
+	size_t         used;    // Bytes in use across all blocks.
+	size_t         peak;    // The most bytes ever in use at once, across all blocks.
+} arena_t;
+
+
+
+/* A point in an arena to release back to.
+ */
+typedef struct arena_mark
+{
+	arena_block_t* block;
+	size_t         used;
+} arena_mark_t;
+
+
+
+extern int   arena_init(arena_t*, const size_t);
+extern void* arena_alloc(arena_t*, const size_t);
+
+extern arena_mark_t arena_mark(const arena_t*);
+extern void         arena_release(arena_t*, const arena_mark_t);
+
+extern size_t arena_used(const arena_t*);
+extern void   arena_reset(arena_t*);
+extern void   arena_free(arena_t*);
+
+#endif
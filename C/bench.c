@@ -0,0 +1,457 @@
+#include "pdb.h"
+#include "select.h"
+#include "curve.h"
+#include "dssp.h"
+
+#include <iso646.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+
+
+//
+// Stand-alone benchmarks for the CPU-side stages of the pipeline, after checks of known regressions on small
+// made-up structures. Build with `make bench`, then run ./bench <file.pdb> [repeats].
+//
+
+
+
+/* Get a monotonic timestamp in seconds.
+ */
+static inline double _now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + 1e-9 * (double)t.tv_nsec;
+}
+
+
+
+/* Time the best of a number of runs of a PDB loader, which should leave its result in chain.
+ */
+static double _bench_loader(int (*loader)(chain_t*, const char*), const char* filename, unsigned int repeats, \
+                            chain_t* chain)
+{
+	double best = 1e30;
+	for (unsigned int i = 0; i < repeats; ++i)
+	{
+		if (i > 0)
+		{
+			free(chain->atoms);
+			chain_free_columns(chain);
+		}
+		double t = _now();
+		loader(chain, filename);
+		t = _now() - t;
+		if (t < best)
+			best = t;
+	}
+	return best;
+}
+
+
+
+/* Check that two chains hold the same atoms, returning the number of mismatched atoms.
+ */
+static unsigned int _compare_chains(const chain_t* a, const chain_t* b)
+{
+	if (a->atoms_len != b->atoms_len)
+		return a->atoms_len > b->atoms_len ? a->atoms_len : b->atoms_len;
+	unsigned int mismatches = 0;
+	for (unsigned int i = 0; i < a->atoms_len; ++i)
+	{
+		const atom_t* p = &a->atoms[i];
+		const atom_t* q = &b->atoms[i];
+		if (p->id != q->id or p->res_id != q->res_id or p->icode != q->icode or strcmp(p->res_type, q->res_type) or \
+		    strcmp(p->type, q->type) or strcmp(p->chain, q->chain) or p->x != q->x or p->y != q->y or p->z != q->z)
+			++mismatches;
+	}
+	return mismatches;
+}
+
+
+
+/* Check that two chains have the same columns and residues, returning the number of mismatched atoms.
+ */
+static unsigned int _compare_columns(const chain_t* a, const chain_t* b)
+{
+	const columns_t* p = &a->cols;
+	const columns_t* q = &b->cols;
+	if (a->atoms_len != b->atoms_len or a->residues.len != b->residues.len or \
+	    a->residues.chains_len != b->residues.chains_len)
+		return a->atoms_len > b->atoms_len ? a->atoms_len : b->atoms_len;
+	unsigned int mismatches = 0;
+	for (unsigned int i = 0; i < a->atoms_len; ++i)
+		if (p->ids[i] != q->ids[i] or p->res_ids[i] != q->res_ids[i] or p->x[i] != q->x[i] or p->y[i] != q->y[i] or \
+		    p->z[i] != q->z[i] or p->atom_names[i] != q->atom_names[i] or p->elements[i] != q->elements[i] or \
+		    p->icodes[i] != q->icodes[i] or a->residues.of_atom[i] != b->residues.of_atom[i] or \
+		    strncmp(p->res_name_table[p->res_names[i]], q->res_name_table[q->res_names[i]], 4) or \
+		    strncmp(p->chain_table[p->chains[i]], q->chain_table[q->chains[i]], 5))
+			++mismatches;
+	return mismatches;
+}
+
+
+
+/* Wrappers to run the mmap reader with one thread, and with one thread per core regardless of file size.
+ */
+static unsigned int BenchThreads = 1;
+static int _parse_pdb_serial(chain_t* chain, const char* filename)
+{
+	return parse_pdb_threads(chain, filename, 1);
+}
+static int _parse_pdb_parallel(chain_t* chain, const char* filename)
+{
+	return parse_pdb_threads(chain, filename, BenchThreads);
+}
+static int _parse_pdb_columns(chain_t* chain, const char* filename)    // What a hit in the cache stands in for.
+{
+	int e = parse_pdb_threads(chain, filename, BenchThreads);
+	return (e > 0 and chain_build_columns(chain) == 0) ? e : -1;
+}
+
+
+
+/* Print one benchmark result, relative to a baseline time.
+ */
+static void _report_loader(const char* name, const chain_t* chain, double t, double t_baseline)
+{
+	printf("[BENCHMARK] %-20s %u atoms in %.4f seconds, i.e. %.2f million atoms per second (%.1fx).\n", \
+	       name, chain->atoms_len, t, 1e-6 * chain->atoms_len / t, t_baseline / t);
+}
+
+
+
+/* Compare the serial and parallel mmap readers against the original stdio reader.
+ */
+static void bench_parse_pdb(const char* filename, unsigned int repeats)
+{
+	long cores   = sysconf(_SC_NPROCESSORS_ONLN);
+	BenchThreads = (cores > 1) ? (unsigned int)cores : 2;
+	
+	chain_t reference, serial, parallel, columns, cached;
+	double  t_stdio    = _bench_loader(parse_pdb_stdio,     filename, repeats, &reference);
+	double  t_serial   = _bench_loader(_parse_pdb_serial,   filename, repeats, &serial);
+	double  t_parallel = _bench_loader(_parse_pdb_parallel, filename, repeats, &parallel);
+	double  t_columns  = _bench_loader(_parse_pdb_columns,  filename, repeats, &columns);
+	double  t_cached   = _bench_loader(parse_pdb,           filename, repeats + 1, &cached); // The first run
+	_report_loader("parse_pdb_stdio:", &reference, t_stdio, t_stdio);                       // writes the cache.
+	_report_loader("parse_pdb, serial:", &serial, t_serial, t_stdio);
+	_report_loader("parse_pdb, parallel:", &parallel, t_parallel, t_stdio);
+	_report_loader("parse_pdb, columns:", &columns, t_columns, t_stdio);
+	_report_loader("parse_pdb, cached:", &cached, t_cached, t_stdio);
+	printf("[BENCHMARK] %s: %u threads.\n", "Parallel reader used", BenchThreads);
+	chain_build_columns(&reference);
+	printf("[BENCHMARK] %s: %u, %u, %u.\n", \
+	       "Atoms that differ from the stdio reader (serial, parallel, cached columns)", \
+	       _compare_chains(&reference, &serial), _compare_chains(&reference, &parallel), \
+	       _compare_columns(&reference, &cached));
+	free(reference.atoms);
+	free(serial.atoms);
+	free(parallel.atoms);
+	free(columns.atoms);
+	free(cached.atoms);
+	chain_free_columns(&columns);
+	chain_free_columns(&reference);
+	chain_free_columns(&cached);
+}
+
+
+
+/* Load a structure and build its columns, as main.c does.
+ * Returns the number of atoms, or less than 0 if it could not be loaded, in which case there is nothing to free.
+ */
+static int _load_chain(const char* filename, chain_t* chain)
+{
+	int e = parse_pdb(chain, filename);
+	if (e <= 0)
+		return -1;
+	if (chain_build_columns(chain) < 0)
+	{
+		free(chain->atoms);
+		return -2;
+	}
+	return e;
+}
+
+
+
+/* Free a chain that _load_chain() loaded.
+ */
+static void _free_chain(chain_t* chain)
+{
+	chain_free_columns(chain);
+	free(chain->atoms);
+}
+
+
+
+/* Load a structure and gather the coordinates of its alpha carbons, of which there are at least three.
+ * Returns them, with their number in len, or NULL if there are none to benchmark, in which case there is nothing
+ * to free. Otherwise both they and the chain must be freed.
+ */
+static vec4* _load_alphas(const char* filename, chain_t* chain, unsigned int* len)
+{
+	if (_load_chain(filename, chain) < 0)
+		return NULL;
+	uint64_t*     bits;
+	int           n      = select_atoms(chain, "name CA", &bits); // malloc bits
+	vec4*         coords = NULL;
+	unsigned int* alphas = (unsigned int*)malloc((n > 0 ? n : 1) * sizeof(unsigned int));
+	*len = 0;
+	if (n >= 3 and alphas != NULL)
+	{
+		*len   = select_indices(bits, chain->atoms_len, alphas);
+		coords = (vec4*)malloc(*len * sizeof(vec4)); // malloc coords
+		if (coords != NULL)
+			chain_gather_vec4s(coords, chain, alphas, *len);
+	}
+	if (n >= 0)
+		free(bits);
+	free(alphas);
+	if (coords == NULL)
+		_free_chain(chain);
+	return coords;
+}
+
+
+
+/* Compare the batched arc kernel against three_points_arc(), one triplet at a time, over the alpha carbons of a
+ * structure.
+ */
+static void bench_arcs(const char* filename, unsigned int repeats)
+{
+	chain_t      chain;
+	unsigned int indices;
+	vec4*        coords = _load_alphas(filename, &chain, &indices); // malloc coords
+	if (coords == NULL)
+		return;
+	
+	// The batched kernel reads and writes arrays of components.
+	float* memory = (float*)malloc(10 * indices * sizeof(float));
+	vec4*  O      = (vec4*) malloc(indices * sizeof(vec4));
+	float* R      = (float*)malloc(indices * sizeof(float));
+	vec4*  Z      = (vec4*) malloc(indices * sizeof(vec4));
+	float* const P[3]  = {memory, memory + indices, memory + 2 * indices};
+	float* const Oc[3] = {memory + 3 * indices, memory + 4 * indices, memory + 5 * indices};
+	float* const Zc[3] = {memory + 6 * indices, memory + 7 * indices, memory + 8 * indices};
+	float*       Rc    = memory + 9 * indices;
+	for (unsigned int i = 0; i < indices; ++i)
+		for (unsigned int k = 0; k < 3; ++k)
+			P[k][i] = coords[i][k];
+	
+	double t_single = 1e30, t_batch = 1e30;
+	int    straight = 0;
+	for (unsigned int r = 0; r < repeats; ++r)
+	{
+		double t = _now();
+		for (unsigned int i = 1; i + 1 < indices; ++i)
+			three_points_arc(coords[i - 1], coords[i], coords[i + 1], &O[i], &R[i], &Z[i]);
+		t = _now() - t;
+		if (t < t_single)
+			t_single = t;
+		t = _now();
+		straight = three_points_arcs((const float* const*)P, indices, Oc, Rc, Zc);
+		t = _now() - t;
+		if (t < t_batch)
+			t_batch = t;
+	}
+	
+	// Measure how far apart the two are, relative to the radius, where three_points_arc() found an arc.
+	double       worst    = 0.0;
+	unsigned int compared = 0;
+	for (unsigned int i = 1; i + 1 < indices; ++i)
+	{
+		if (not isfinite(R[i]) or R[i] <= 0.0 or Rc[i] <= 0.0)
+			continue;
+		double d = 0.0;
+		for (unsigned int k = 0; k < 3; ++k)
+			d += (O[i][k] - Oc[k][i]) * (O[i][k] - Oc[k][i]);
+		if (sqrt(d) / Rc[i] > worst)
+			worst = sqrt(d) / Rc[i];
+		++compared;
+	}
+	printf("[BENCHMARK] %-20s %u triplets in %.4f seconds, i.e. %.1f ns per triplet.\n", \
+	       "three_points_arc:", indices - 2, t_single, 1e9 * t_single / (indices - 2));
+	printf("[BENCHMARK] %-20s %u triplets in %.4f seconds, i.e. %.1f ns per triplet (%.1fx).\n", \
+	       "three_points_arcs:", indices - 2, t_batch, 1e9 * t_batch / (indices - 2), t_single / t_batch);
+	printf("[BENCHMARK] %s: %i; %s: %.2e over %u.\n", "Straight triplets", straight, \
+	       "Largest difference in centre, relative to radius", worst, compared);
+	free(memory);
+	free(O);
+	free(R);
+	free(Z);
+	free(coords);
+	_free_chain(&chain);
+}
+
+
+
+/* Time each curve engine at the default quality over the alpha carbons of a structure, as one run of points.
+ */
+static void bench_curves(const char* filename, unsigned int repeats)
+{
+	chain_t      chain;
+	unsigned int indices;
+	vec4*        coords = _load_alphas(filename, &chain, &indices); // malloc coords
+	arena_t      arena;
+	if (coords == NULL)
+		return;
+	if (arena_init(&arena, 0) < 0)
+	{
+		free(coords);
+		_free_chain(&chain);
+		return;
+	}
+	
+	static const char* NAMES[] = {"arc:", "catmull-rom:", "b-spline:"};
+	const curve_quality_t quality = curve_quality_level(STARBOARD_CURVE_QUALITY_DEFAULT);
+	double t_arc = 0.0;
+	for (unsigned int engine = CURVE_ENGINE_ARC; engine <= CURVE_ENGINE_B_SPLINE; ++engine)
+	{
+		double t_best = 1e30;
+		int    points = 0;
+		for (unsigned int r = 0; r < repeats; ++r)
+		{
+			vec4*         p;
+			vec4*         O;
+			float*        R;
+			vec4*         Z;
+			unsigned int* offsets;
+			arena_reset(&arena);
+			double t = _now();
+			if (engine == CURVE_ENGINE_ARC)
+				points = interpolate_arc_curve(&arena, &quality, coords, indices, &p, &O, &R, &Z, &offsets);
+			else
+				points = interpolate_spline_curve(&arena, &quality, (curve_engine_t)engine, coords, indices, \
+				                                  &p, &O, &R, &Z, &offsets);
+			t = _now() - t;
+			if (t < t_best)
+				t_best = t;
+		}
+		if (engine == CURVE_ENGINE_ARC)
+			t_arc = t_best;
+		printf("[BENCHMARK] %-20s %i points in %.4f seconds, i.e. %.1f ns per point (%.1fx).\n", \
+		       NAMES[engine], points, t_best, 1e9 * t_best / (points > 0 ? points : 1), t_arc / t_best);
+	}
+	arena_free(&arena);
+	free(coords);
+	_free_chain(&chain);
+}
+
+
+
+/* Time the secondary structure assignment of a structure with one thread, and with one per core.
+ */
+static void bench_dssp(const char* filename, unsigned int repeats)
+{
+	chain_t chain;
+	if (_load_chain(filename, &chain) < 0)
+		return;
+	char*   structure = (char*)malloc((chain.residues.len + 1) * sizeof(char)); // malloc structure
+	arena_t arena;
+	if (structure == NULL or arena_init(&arena, 0) < 0)
+	{
+		free(structure);
+		_free_chain(&chain);
+		return;
+	}
+	
+	double t_serial = 0.0;
+	for (unsigned int threads = 1; threads <= 2; ++threads)
+	{
+		pool_t pool;
+		pool_init(&pool, (threads == 1) ? 1 : 0);
+		double t_best   = 1e30;
+		int    backbone = 0;
+		for (unsigned int r = 0; r < repeats; ++r)
+		{
+			double t = _now();
+			backbone = dssp_assign(&pool, &arena, &chain, structure);
+			t = _now() - t;
+			if (t < t_best)
+				t_best = t;
+		}
+		if (threads == 1)
+			t_serial = t_best;
+		unsigned int helix = 0, strand = 0;
+		for (unsigned int i = 0; i < chain.residues.len; ++i)
+		{
+			helix  += (structure[i] == 'H');
+			strand += (structure[i] == 'E');
+		}
+		printf("[BENCHMARK] %-20s %i residues in %.4f seconds on %u threads (%.1fx); %u H, %u E.\n", \
+		       "dssp_assign:", backbone, t_best, pool_threads(&pool), t_serial / t_best, helix, strand);
+		pool_free(&pool);
+	}
+	arena_free(&arena);
+	free(structure);
+	_free_chain(&chain);
+}
+
+
+
+/* Check that `within` only measures from real atoms: 80 atoms of chain A far from the origin, so the last word of
+ * the bitsets is padded, and one atom of chain B near the origin, where the padding's coordinates would be.
+ * Returns the number of atoms selected wrongly.
+ */
+static unsigned int check_select_within(void)
+{
+	const unsigned int n    = 81;
+	char*              data = (char*)malloc(n * 82 + 1);    // malloc data
+	if (data == NULL)
+		return n;
+	size_t size = 0;
+	for (unsigned int i = 0; i < n; ++i)
+	{
+		const bool  b = (i + 1 == n);
+		const float x = b ? 0.5f : 50.0f + 0.1f * (float)(i % 10);
+		const float y = b ? 0.0f : 50.0f + 0.1f * (float)(i / 10);
+		size += (size_t)sprintf(data + size, "ATOM  %5u  CA  ALA %c%4u    %8.3f%8.3f%8.3f  1.00  0.00           C\n", \
+		                        i + 1, b ? 'B' : 'A', i + 1, x, y, b ? 0.0f : 50.0f);
+	}
+	chain_t   chain;
+	uint64_t* bits  = NULL;
+	int       found = -1;
+	if (parse_pdb_mapped(&chain, data, size, 1) == (int)n)
+	{
+		if (chain_build_columns(&chain) >= 0)
+		{
+			found = select_atoms(&chain, "within 1 of chain A", &bits); // malloc bits
+			free(bits);
+			chain_free_columns(&chain);
+		}
+		free(chain.atoms);
+	}
+	free(data);
+	const unsigned int wrong = (found < 0) ? n : (unsigned int)abs(found - (int)(n - 1));
+	printf("[%s] %s: %i of %u atoms, expected %u.\n", (wrong == 0) ? "CHECK" : "ERROR", \
+	       "within 1 of chain A", found, n, n - 1);
+	return wrong;
+}
+
+
+
+/* Begin main program flow.
+ */
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("[ERROR] %s\n", "Usage: bench file.pdb [repeats]");
+		return -1;
+	}
+	unsigned int repeats = (argc > 2) ? (unsigned int)strtoul(argv[2], NULL, 10) : 5;
+	if (repeats == 0)
+		repeats = 1;
+	
+	check_select_within();
+	
+	bench_parse_pdb(argv[1], repeats);
+	bench_arcs(argv[1], repeats);
+	bench_curves(argv[1], repeats);
+	bench_dssp(argv[1], repeats);
+	return 0;
+}
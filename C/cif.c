@@ -0,0 +1,513 @@
+#include "cif.h"
+
+
+
+/* Map the tags of the _atom_site loop to the fields they populate. Where both an author-defined and a
+ * label column exist, the author-defined one takes priority because it matches PDB-format numbering.
+ */
+static const struct
+{
+	const char*  tag;
+	cif_field_t  field;
+	unsigned int priority;
+} CIF_TAGS[] = \
+{ \
+	{"group_PDB",          CIF_GROUP,     1}, \
+	{"id",                 CIF_ID,        1}, \
+	{"label_atom_id",      CIF_ATOM_NAME, 1}, \
+	{"auth_atom_id",       CIF_ATOM_NAME, 2}, \
+	{"label_comp_id",      CIF_RES_NAME,  1}, \
+	{"auth_comp_id",       CIF_RES_NAME,  2}, \
+	{"label_asym_id",      CIF_CHAIN,     1}, \
+	{"auth_asym_id",       CIF_CHAIN,     2}, \
+	{"label_seq_id",       CIF_RES_ID,    1}, \
+	{"auth_seq_id",        CIF_RES_ID,    2}, \
+	{"pdbx_PDB_ins_code",  CIF_ICODE,     1}, \
+	{"Cartn_x",            CIF_X,         1}, \
+	{"Cartn_y",            CIF_Y,         1}, \
+	{"Cartn_z",            CIF_Z,         1}, \
+	{"pdbx_PDB_model_num", CIF_MODEL,     1} \
+};
+#define STARBOARD_CIF_TAGS_LEN (sizeof(CIF_TAGS) / sizeof(CIF_TAGS[0]))
+
+
+
+/* Test whether mapped data looks like an mmCIF file, i.e. its first data line opens a data block.
+ */
+bool is_cif(const char* data, const size_t size)
+{
+	size_t i = 0;
+	while (i < size)
+	{
+		while (i < size and (data[i] == ' ' or data[i] == '\t' or data[i] == '\r' or data[i] == '\n'))
+			++i;
+		if (i < size and data[i] == '#')    // Skip comment lines.
+		{
+			const char* eol = (const char*)memchr(data + i, '\n', size - i);
+			i = (eol == NULL) ? size : (size_t)(eol - data);
+			continue;
+		}
+		return (size - i >= 5 and memcmp(data + i, "data_", 5) == 0);
+	}
+	return false;
+}
+
+
+
+/* Prepare a reader, and an empty atom array with room for atoms_cap atoms in the chain it will fill.
+ * Returns 0 on success, otherwise error.
+ */
+int cif_reader_init(cif_reader_t* r, chain_t* chain, const unsigned int atoms_cap)
+{
+	memset(r, 0, sizeof(cif_reader_t));
+	r->state     = CIF_SEEKING;
+	r->atoms_cap = (atoms_cap > 0) ? atoms_cap : 1024;
+	chain->atoms     = (atom_t*)malloc(r->atoms_cap * sizeof(atom_t));    // malloc chain->atoms
+	chain->atoms_len = 0;
+	return (chain->atoms == NULL) ? -1 : 0;
+}
+
+
+
+/* Decode an unsigned integer value. The CIF placeholders '.' and '?' decode as 0.
+ * Returns: 0 success; -1 not an unsigned integer; -2 out of range.
+ */
+static inline int __cif_scan_ui(unsigned int* out, const char* p, const size_t len)
+{
+	if (len == 1 and (p[0] == '.' or p[0] == '?'))
+	{
+		*out = 0;
+		return 0;
+	}
+	unsigned long v = 0;
+	for (size_t i = 0; i < len; ++i)
+	{
+		const unsigned int d = (unsigned int)(unsigned char)p[i] - '0';
+		if (d >= 10)
+			return -1;
+		v = 10 * v + d;
+		if (v > INT_MAX)
+			return -2;
+	}
+	*out = (unsigned int)v;
+	return 0;
+}
+
+
+
+/* Decode a decimal value such as a coordinate. Unlike the fixed PDB columns, any number of decimals may be
+ * given, along with an exponent or a standard uncertainty suffix, e.g. "1.5e2" or "12.345(6)".
+ * Returns: 0 success; -1 malformed value.
+ */
+static inline int __cif_scan_f(float* out, const char* p, size_t len)
+{
+	static const double POW10[19] = \
+	{ \
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, \
+		1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 \
+	};
+	
+	size_t i        = 0;
+	bool   negative = false;
+	if (i < len and (p[i] == '-' or p[i] == '+'))
+		negative = (p[i++] == '-');
+	uint64_t     v        = 0;
+	unsigned int digits   = 0;
+	unsigned int decimals = 0;
+	bool         point    = false;
+	for (; i < len; ++i)
+	{
+		const unsigned int d = (unsigned int)(unsigned char)p[i] - '0';
+		if (d < 10)
+		{
+			v = 10 * v + d;
+			decimals += point;
+			++digits;
+		}
+		else if (p[i] == '.' and not point)
+			point = true;
+		else
+			break;
+	}
+	if (digits == 0)
+		return -1;
+	
+	// A standard uncertainty in brackets ends the value.
+	if (i < len and p[i] == '(')
+		len = i;
+	
+	// Exponents, and more digits than a double holds exactly, are rare enough to leave to strtof().
+	if (i < len or digits > 18)
+	{
+		if (i < len and p[i] != 'e' and p[i] != 'E')
+			return -1;
+		char buffer[len + 1];
+		memcpy(buffer, p, len);
+		buffer[len] = '\0';
+		char* end;
+		*out = strtof(buffer, &end);
+		return (end == buffer + len) ? 0 : -1;
+	}
+	const float f = (float)((double)v / POW10[decimals]);
+	*out = negative ? -f : f;
+	return 0;
+}
+
+
+
+/* Copy a name value into a fixed-size field, truncating it if needed. Placeholders become empty names.
+ */
+static inline void __cif_copy_name(char* out, const size_t size, const char* p, size_t len, const bool quoted)
+{
+	if (not quoted and len == 1 and (p[0] == '.' or p[0] == '?'))
+		len = 0;
+	if (len > size - 1)
+		len = size - 1;
+	memcpy(out, p, len);
+	out[len] = '\0';
+}
+
+
+
+/* Feed one value of the current _atom_site row to the reader, and append the atom once the row is complete.
+ */
+static inline void _cif_value(cif_reader_t* r, chain_t* chain, const char* p, const size_t len, const bool quoted)
+{
+	atom_t* a = &r->atom;
+	char    icode[2];
+	int     f = (r->col < STARBOARD_CIF_COLUMNS_MAX) ? r->fields[r->col] : -1;
+	switch (f)
+	{
+		case CIF_GROUP:     r->keep = (len == 4 and memcmp(p, "ATOM", 4) == 0);                    break;
+		case CIF_ID:        if (__cif_scan_ui(&a->id, p, len))     r->e = -2;                     break;
+		case CIF_RES_ID:    if (__cif_scan_ui(&a->res_id, p, len)) r->e = -3;                     break;
+		case CIF_RES_NAME:  __cif_copy_name(a->res_type, sizeof(a->res_type), p, len, quoted);     break;
+		case CIF_ATOM_NAME: __cif_copy_name(a->type,     sizeof(a->type),     p, len, quoted);     break;
+		case CIF_CHAIN:     __cif_copy_name(a->chain,    sizeof(a->chain),    p, len, quoted);     break;
+		case CIF_ICODE:     __cif_copy_name(icode, sizeof(icode), p, len, quoted); a->icode = icode[0]; break;
+		case CIF_X:         if (__cif_scan_f(&a->x, p, len)) r->e = -6;                           break;
+		case CIF_Y:         if (__cif_scan_f(&a->y, p, len)) r->e = -7;                           break;
+		case CIF_Z:         if (__cif_scan_f(&a->z, p, len)) r->e = -8;                           break;
+		case CIF_MODEL:     if (__cif_scan_ui(&r->model, p, len)) r->e = -10;                     break;
+		default:                                                                                  break;
+	}
+	if (++r->col < r->ncols)
+		return;
+	
+	// The row is complete. Only the first model is read, and the rows of each model are contiguous, so the
+	// first row of another model ends the loop.
+	if (r->priority[CIF_MODEL] > 0 and r->e == 0)
+	{
+		if (not r->model_seen)
+		{
+			r->first_model = r->model;
+			r->model_seen  = true;
+		}
+		else if (r->model != r->first_model)
+		{
+			r->state = CIF_DONE;
+			return;
+		}
+	}
+	if (not r->keep)
+		++r->ignored;
+	else if (r->e < 0)
+		printf("[WARNING] %s: %i.\n", "Could not read _atom_site row, failed with code", r->e);
+	else
+	{
+		if (chain->atoms_len == r->atoms_cap)
+		{
+			atom_t* atoms = (atom_t*)realloc(chain->atoms, 2 * r->atoms_cap * sizeof(atom_t));
+			if (atoms == NULL)
+			{
+				r->e     = -9;
+				r->state = CIF_DONE;
+				return;
+			}
+			chain->atoms  = atoms;
+			r->atoms_cap *= 2;
+		}
+		chain->atoms[chain->atoms_len++] = *a;
+	}
+	r->col = 0;
+	r->e   = 0;
+	memset(a, 0, sizeof(atom_t));
+	r->keep = (r->priority[CIF_GROUP] == 0);    // Without a group_PDB column, keep every row.
+}
+
+
+
+/* Feed one token to the reader. Quoted tokens are always values, never keywords or tags.
+ */
+static inline void _cif_token(cif_reader_t* r, chain_t* chain, const char* p, const size_t len, const bool quoted)
+{
+	// Only test for keywords when the first character could begin one, which values almost never do.
+	const char c    = (not quoted and len > 0) ? (p[0] | 0x20) : '\0';    // Lower case, for letters.
+	const bool tag  = (c == ('_' | 0x20) and p[0] == '_');
+	const bool loop = (c == 'l' and len == 5 and strncasecmp(p, "loop_", 5) == 0);
+	const bool data = (c == 'd' and len >= 5 and strncasecmp(p, "data_", 5) == 0);
+	switch (r->state)
+	{
+		case CIF_SEEKING:
+		case CIF_OTHER:
+			if (loop)
+			{
+				r->state = CIF_HEADER;
+				r->ncols = 0;
+				memset(r->fields,   -1, sizeof(r->fields));
+				memset(r->priority,  0, sizeof(r->priority));
+			}
+			else if (tag)    // A tag outside a loop ends any loop we were skipping.
+				r->state = CIF_SEEKING;
+		break;
+		
+		case CIF_HEADER:
+			if (tag and (len <= 11 or memcmp(p, "_atom_site.", 11) != 0))
+			{
+				if (r->ncols == 0)
+					r->state = CIF_OTHER;    // Some other category's loop.
+				else
+					++r->ncols;
+			}
+			else if (tag)
+			{
+				// Note which field, if any, this column populates.
+				const char*  name     = p + 11;
+				const size_t name_len = len - 11;
+				for (unsigned int i = 0; i < STARBOARD_CIF_TAGS_LEN and r->ncols < STARBOARD_CIF_COLUMNS_MAX; ++i)
+				{
+					const cif_field_t f = CIF_TAGS[i].field;
+					if (strlen(CIF_TAGS[i].tag) == name_len and memcmp(CIF_TAGS[i].tag, name, name_len) == 0 \
+					    and CIF_TAGS[i].priority > r->priority[f])
+					{
+						// Clear any lower priority column for this field before taking it.
+						for (unsigned int j = 0; j < r->ncols and j < STARBOARD_CIF_COLUMNS_MAX; ++j)
+							if (r->fields[j] >= 0 and (cif_field_t)r->fields[j] == f)
+								r->fields[j] = -1;
+						r->fields[r->ncols] = f;
+						r->priority[f]      = CIF_TAGS[i].priority;
+					}
+				}
+				++r->ncols;
+			}
+			else
+			{
+				// The first value ends the header, and begins the rows.
+				if (r->priority[CIF_X] == 0 or r->priority[CIF_Y] == 0 or r->priority[CIF_Z] == 0)
+				{
+					printf("[WARNING] %s\n", "The _atom_site loop has no Cartn_x, Cartn_y, Cartn_z columns.");
+					r->state = CIF_DONE;
+					break;
+				}
+				r->state = CIF_ROWS;
+				r->col   = 0;
+				r->e     = 0;
+				r->keep  = (r->priority[CIF_GROUP] == 0);
+				memset(&r->atom, 0, sizeof(atom_t));
+				_cif_value(r, chain, p, len, quoted);
+			}
+		break;
+		
+		case CIF_ROWS:
+			if (loop or tag or data)    // There is only one _atom_site loop, so stop at whatever follows it.
+				r->state = CIF_DONE;
+			else
+				_cif_value(r, chain, p, len, quoted);
+		break;
+		
+		case CIF_DONE:
+		break;
+	}
+}
+
+
+
+/* Classify the bytes of a line: set a bit in blank[] for each whitespace byte, and every bit after the end of the
+ * line, 16 bytes at a time where SSE2 is available.
+ * Returns true if the line contains quotes or a '#', which the bitmap alone cannot tokenize.
+ */
+static inline bool __cif_classify(const char* p, const size_t len, uint64_t* blank, const size_t words)
+{
+	memset(blank, 0, words * sizeof(uint64_t));
+	unsigned int special = 0;
+	size_t       i       = 0;
+	#ifdef __SSE2__
+	const __m128i SPACE = _mm_set1_epi8(' ');
+	const __m128i TAB   = _mm_set1_epi8('\t');
+	const __m128i CR    = _mm_set1_epi8('\r');
+	const __m128i SQ    = _mm_set1_epi8('\'');
+	const __m128i DQ    = _mm_set1_epi8('"');
+	const __m128i HASH  = _mm_set1_epi8('#');
+	for (; i + 16 <= len; i += 16)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+		const __m128i b = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, SPACE), _mm_cmpeq_epi8(v, TAB)), \
+		                               _mm_cmpeq_epi8(v, CR));
+		const __m128i s = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, SQ), _mm_cmpeq_epi8(v, DQ)), \
+		                               _mm_cmpeq_epi8(v, HASH));
+		blank[i / 64] |= (uint64_t)(unsigned int)_mm_movemask_epi8(b) << (i % 64);
+		special       |= (unsigned int)_mm_movemask_epi8(s);
+	}
+	#endif
+	for (; i < len; ++i)    // The tail, or everything without SSE2.
+	{
+		const char c = p[i];
+		blank[i / 64] |= (uint64_t)(c == ' ' or c == '\t' or c == '\r') << (i % 64);
+		special       |= (c == '\'' or c == '"' or c == '#');
+	}
+	
+	// Mark everything past the end as blank, so that the last token is terminated.
+	blank[len / 64] |= ~(uint64_t)0 << (len % 64);
+	for (size_t w = len / 64 + 1; w < words; ++w)
+		blank[w] = ~(uint64_t)0;
+	return special != 0;
+}
+
+
+
+/* Split a line into tokens and feed them to the reader. Most lines are split on the whitespace bitmap alone;
+ * lines with quoted values or comments are split byte by byte.
+ */
+static inline bool __cif_blank(const char c)
+{
+	return (c == ' ' or c == '\t' or c == '\r');
+}
+static void _cif_line(cif_reader_t* r, chain_t* chain, const char* line, size_t len)
+{
+	// A line beginning with ';' opens or closes a text field, and the whole field is a single value.
+	if (len > 0 and line[0] == ';')
+	{
+		if (not r->in_text)
+		{
+			r->in_text = true;
+			return;
+		}
+		r->in_text = false;
+		_cif_token(r, chain, "?", 1, true);
+		++line;
+		--len;
+	}
+	else if (r->in_text)
+		return;
+	
+	const size_t words = len / 64 + 1;
+	uint64_t     blank[words];
+	if (not __cif_classify(line, len, blank, words))
+	{
+		// A token starts at a non-blank byte after a blank one, and ends at a blank byte after a non-blank one.
+		// Starts and ends alternate, so take the lowest bit of whichever one comes next.
+		uint64_t carry    = 0;    // Whether the previous word ended inside a token.
+		bool     in_token = false;
+		size_t   start    = 0;
+		for (size_t w = 0; w < words; ++w)
+		{
+			const uint64_t solid  = ~blank[w];
+			const uint64_t after  = (solid << 1) | carry;
+			uint64_t       starts = solid & ~after;
+			uint64_t       ends   = ~solid & after;
+			carry = solid >> 63;
+			while (true)
+			{
+				if (not in_token)
+				{
+					if (starts == 0)
+						break;
+					start     = 64 * w + __builtin_ctzll(starts);
+					starts   &= starts - 1;
+					in_token  = true;
+				}
+				else
+				{
+					if (ends == 0)
+						break;
+					const size_t end = 64 * w + __builtin_ctzll(ends);
+					ends     &= ends - 1;
+					in_token  = false;
+					_cif_token(r, chain, line + start, end - start, false);
+				}
+			}
+		}
+		return;
+	}
+	
+	for (size_t i = 0; i < len; )
+	{
+		while (i < len and __cif_blank(line[i]))
+			++i;
+		if (i == len or line[i] == '#')    // A '#' at the start of a token comments out the rest of the line.
+			break;
+		size_t start = i;
+		if (line[i] == '\'' or line[i] == '"')
+		{
+			// A quoted value ends at a matching quote which is followed by a blank or the end of the line.
+			const char q = line[i];
+			start = ++i;
+			while (i < len and not (line[i] == q and (i + 1 == len or __cif_blank(line[i + 1]))))
+				++i;
+			_cif_token(r, chain, line + start, i - start, true);
+			++i;
+		}
+		else
+		{
+			while (i < len and not __cif_blank(line[i]))
+				++i;
+			_cif_token(r, chain, line + start, i - start, false);
+		}
+	}
+}
+
+
+
+/* Feed the lines in [begin, end) to the reader. Only complete lines are consumed, unless this is the last piece
+ * of the file, so that a caller reading in pieces can carry the remainder over to the next one.
+ * Returns the number of bytes consumed.
+ */
+size_t cif_feed(cif_reader_t* r, chain_t* chain, const char* begin, const char* end, const bool last)
+{
+	const char* line = begin;
+	while (line < end and r->state != CIF_DONE)
+	{
+		const char* eol = (const char*)memchr(line, '\n', end - line);
+		if (eol == NULL)
+		{
+			if (not last)
+				break;
+			eol = end;
+		}
+		_cif_line(r, chain, line, eol - line);
+		line = (eol < end) ? eol + 1 : end;
+	}
+	return (r->state == CIF_DONE) ? (size_t)(end - begin) : (size_t)(line - begin);
+}
+
+
+
+/* Parse mapped mmCIF data into an array of atom structures.
+ */
+int parse_cif_mapped(chain_t* chain, const char* data, const size_t size)
+{
+	// _atom_site rows are usually 80 to 100 bytes long.
+	cif_reader_t r;
+	if (cif_reader_init(&r, chain, size / 100 + 1024) < 0)
+		return -2;
+	cif_feed(&r, chain, data, data + size, true);
+	printf("[DEBUG] %s: %u.\n", "Ignored non-ATOM rows", r.ignored);
+	if (r.e == -9)
+		return -2;
+	return chain->atoms_len;
+}
+
+
+
+/* Parse an mmCIF file into an array of atom structures.
+ */
+int parse_cif(chain_t* chain, const char* filename)
+{
+	struct stat st;
+	const char* data = map_file(filename, &st);
+	if (data == NULL)
+		return -1;
+	int e = parse_cif_mapped(chain, data, (size_t)st.st_size);
+	munmap((void*)data, (size_t)st.st_size);
+	return e;
+}
@@ -0,0 +1,91 @@
+#ifndef STARBOARD_CIF
+#define STARBOARD_CIF
+
+#include <iso646.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "pdb.h"
+
+
+//
+// A reader for the _atom_site loop of mmCIF/PDBx files, which have no limit on atom count and allow chain
+// identifiers of several characters. Columns are found by name in the loop header, so any column order works.
+//
+
+#define STARBOARD_CIF_COLUMNS_MAX 64    // Columns after this many in the loop header are never read.
+
+
+
+/* The _atom_site columns which are read into an atom structure.
+ */
+typedef enum cif_field
+{
+	CIF_GROUP,        // group_PDB: only ATOM rows are kept, as in parse_pdb().
+	CIF_ID,           // id
+	CIF_ATOM_NAME,    // auth_atom_id, or label_atom_id
+	CIF_RES_NAME,     // auth_comp_id, or label_comp_id
+	CIF_CHAIN,        // auth_asym_id, or label_asym_id
+	CIF_RES_ID,       // auth_seq_id, or label_seq_id
+	CIF_ICODE,        // pdbx_PDB_ins_code
+	CIF_X,            // Cartn_x
+	CIF_Y,            // Cartn_y
+	CIF_Z,            // Cartn_z
+	CIF_MODEL,        // pdbx_PDB_model_num: only the first model is read, as in parse_pdb().
+	CIF_FIELDS
+} cif_field_t;
+
+
+
+/* Where the reader is within the file.
+ */
+typedef enum cif_state
+{
+	CIF_SEEKING,    // Looking for a loop_ keyword.
+	CIF_HEADER,     // Reading the tags after loop_.
+	CIF_OTHER,      // Inside a loop other than _atom_site, so skip values until the next loop_.
+	CIF_ROWS,       // Reading _atom_site values.
+	CIF_DONE
+} cif_state_t;
+
+
+
+/* The state of a reader, which is fed whole lines and so can consume a file in pieces.
+ */
+typedef struct cif_reader
+{
+	cif_state_t  state;
+	bool         in_text;                                   // Inside a ;-delimited text field.
+	signed char  fields[STARBOARD_CIF_COLUMNS_MAX];         // Field read from each column, or -1.
+	unsigned int priority[CIF_FIELDS];                      // Rank of the tag that set each field's column.
+	unsigned int ncols;
+	unsigned int col;                                       // Column of the next value in the current row.
+	atom_t       atom;                                      // The row being assembled.
+	unsigned int model;                                     // The model number of the row being assembled.
+	unsigned int first_model;
+	bool         model_seen;
+	bool         keep;
+	int          e;
+	unsigned int atoms_cap;
+	unsigned int ignored;
+} cif_reader_t;
+
+
+
+extern bool is_cif(const char*, const size_t);
+
+extern int cif_reader_init(cif_reader_t*, chain_t*, const unsigned int);
+
+extern size_t cif_feed(cif_reader_t*, chain_t*, const char*, const char*, const bool);
+
+extern int parse_cif_mapped(chain_t*, const char*, const size_t);
+
+extern int parse_cif(chain_t*, const char*);
+
+#endif
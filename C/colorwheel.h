@@ -1,4 +1,5 @@
 #include "linmath/linmath.h"
+#include "arena.h"
 
 #include <iso646.h>
 #include <stdlib.h>
@@ -116,12 +117,61 @@ void generate_pastel_colors(vec4* colors, unsigned int n, float a)
 
 /* TODO.
  */
-void repeat_color(const vec4 color, unsigned int n, \
+void repeat_color(arena_t* arena, const vec4 color, unsigned int n, \
                   vec4** colors_out)
 {
 	// Set the residue colours to the specified colour.
-	*colors_out = (vec4*)malloc(n * sizeof(vec4)); // malloc colors
+	*colors_out = (vec4*)arena_alloc(arena, n * sizeof(vec4));
 	vec4* colors = *colors_out;
+	if (colors == NULL)
+		return;
 	for (unsigned int i = 0; i < n; ++i)
 		memcpy(colors[i], color, sizeof(vec4));
 }
+
+
+
+// Colour maps, which residues can take their colours from by a value from 0 to 1. Map 0 stands for a residue's
+// own colour, so only the maps after it have texels, STARBOARD_COLORMAP_TEXELS each.
+#define STARBOARD_COLORMAP_TEXELS 256
+
+typedef enum colormap
+{
+	COLORMAP_NONE,
+	COLORMAP_RAINBOW,    // Blue, through green, to red.
+	COLORMAP_BWR,        // Blue, through white, to red.
+	COLORMAP_GREY,       // Black to white.
+	COLORMAP_LEN
+} colormap_t;
+
+static const char* COLORMAP_NAMES[COLORMAP_LEN] = {"none", "rainbow", "bwr", "grey"};
+
+
+
+/* Generate the texels of every colour map after map 0, in order, as RGBA bytes.
+ */
+void generate_colormaps(unsigned char* out)
+{
+	static const vec4 BLACK = {0.00, 0.00, 0.00, 1.0}, BLUE = {0.23, 0.30, 0.75, 1.0}, \
+	                  WHITE = {0.87, 0.87, 0.87, 1.0}, RED  = {0.71, 0.02, 0.15, 1.0};
+	for (unsigned int m = 1; m < COLORMAP_LEN; ++m)
+		for (unsigned int i = 0; i < STARBOARD_COLORMAP_TEXELS; ++i)
+		{
+			const float t = (float)i / (STARBOARD_COLORMAP_TEXELS - 1);
+			vec4        color;
+			if (m == COLORMAP_RAINBOW)
+				HSVA_to_RGBA(0.67 * (1.0 - t), 1.0, 1.0, 1.0, &color);
+			else
+			{
+				// The other maps run in a straight line from one colour to the next.
+				const float* from = (m == COLORMAP_GREY) ? BLACK : ((t < 0.5) ? BLUE : WHITE);
+				const float* to   = (m == COLORMAP_GREY) ? WHITE : ((t < 0.5) ? WHITE : RED);
+				const float  u    = (m == COLORMAP_GREY) ? t : ((t < 0.5) ? 2.0 * t : 2.0 * t - 1.0);
+				for (unsigned int k = 0; k < 4; ++k)
+					color[k] = from[k] + u * (to[k] - from[k]);
+			}
+			unsigned char* texel = out + 4 * ((m - 1) * STARBOARD_COLORMAP_TEXELS + i);
+			for (unsigned int k = 0; k < 4; ++k)
+				texel[k] = (unsigned char)lrintf(255.0 * color[k]);
+		}
+}
@@ -51,8 +51,34 @@ command_t get_command(params_t* out)
 	// Attempt to identify the command parsed.
 	if (out->argc > 0)
 	{
-		if (strcasecmp(out->argv[0], "load") == 0)
+		if (strcasecmp(out->argv[0], "assembly") == 0)
+			cmd = COMMAND_ASSEMBLY;
+		else if (strcasecmp(out->argv[0], "color") == 0)
+			cmd = COMMAND_COLOR;
+		else if (strcasecmp(out->argv[0], "curve") == 0)
+			cmd = COMMAND_CURVE;
+		else if (strcasecmp(out->argv[0], "delete") == 0)
+			cmd = COMMAND_DELETE;
+		else if (strcasecmp(out->argv[0], "extrude") == 0)
+			cmd = COMMAND_EXTRUDE;
+		else if (strcasecmp(out->argv[0], "hide") == 0)
+			cmd = COMMAND_HIDE;
+		else if (strcasecmp(out->argv[0], "highlight") == 0)
+			cmd = COMMAND_HIGHLIGHT;
+		else if (strcasecmp(out->argv[0], "load") == 0)
 			cmd = COMMAND_LOAD;
+		else if (strcasecmp(out->argv[0], "model") == 0)
+			cmd = COMMAND_MODEL;
+		else if (strcasecmp(out->argv[0], "move") == 0)
+			cmd = COMMAND_MOVE;
+		else if (strcasecmp(out->argv[0], "quality") == 0)
+			cmd = COMMAND_QUALITY;
+		else if (strcasecmp(out->argv[0], "select") == 0)
+			cmd = COMMAND_SELECT;
+		else if (strcasecmp(out->argv[0], "show") == 0)
+			cmd = COMMAND_SHOW;
+		else if (strcasecmp(out->argv[0], "spectrum") == 0)
+			cmd = COMMAND_SPECTRUM;
 		else if (strcasecmp(out->argv[0], "status") == 0)
 			cmd = COMMAND_STATUS;
 	}
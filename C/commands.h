@@ -11,7 +11,20 @@
 typedef enum command
 {
 	COMMAND_NULL,
+	COMMAND_ASSEMBLY,
+	COMMAND_COLOR,
+	COMMAND_CURVE,
+	COMMAND_DELETE,
+	COMMAND_EXTRUDE,
+	COMMAND_HIDE,
+	COMMAND_HIGHLIGHT,
 	COMMAND_LOAD,
+	COMMAND_MODEL,
+	COMMAND_MOVE,
+	COMMAND_QUALITY,
+	COMMAND_SELECT,
+	COMMAND_SHOW,
+	COMMAND_SPECTRUM,
 	COMMAND_STATUS
 } command_t;
 
@@ -0,0 +1,392 @@
+#ifndef STARBOARD_CULL
+#define STARBOARD_CULL
+
+#include <iso646.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include "scene.h"
+
+
+//
+// The indices of a buffer are cut into pieces of about as many residues each, and each piece is given the box
+// around the vertices it draws. The pieces are the leaves of a tree of boxes, a bounding volume hierarchy, in the
+// order of the indices, so that each node covers one range of them. Each frame, the tree of every buffer is walked
+// against the view frustum, from the box around the whole object down, and only the ranges of the pieces in view
+// are drawn, from the same buffers as before. A node wholly in view is drawn without looking any further down.
+//
+// Pieces of a strip share the indices of the primitive that joins them, so that drawing two pieces next to each
+// other draws what drawing the strip did, and pieces in view next to each other are drawn as one range. The copies
+// of an object in a biological assembly are culled one by one, and the pieces in view of any of them are drawn.
+//
+
+#define STARBOARD_CULL_RESIDUES 64         // Residues in each piece of a buffer, at most, unless one has more.
+#define STARBOARD_CULL_MARGIN   2.0        // Room (Å) around the vertices of a piece, for what a shader extrudes.
+#define STARBOARD_CULL_RESTART  0xFFFFFFFF // The restart index in the indices as they are built (see ribbon.h).
+
+
+
+/* A node of a tree of boxes, and the range of indices that it covers, counting those it shares with the next.
+ */
+typedef struct cull_node
+{
+	GLfloat      low[3];
+	GLfloat      high[3];
+	unsigned int first;
+	unsigned int count;
+	unsigned int skip;            // The node after this one's subtree, which is the next one if it is a leaf.
+	unsigned int vertex_low;      // The vertices that the range draws are between these.
+	unsigned int vertex_high;
+} cull_node_t;
+
+/* The tree of boxes of the indices of a buffer, with the nodes in preorder, i.e. the first child of a node
+ * follows it, and the second follows the first's subtree. An empty tree draws every index.
+ */
+typedef struct cull_tree
+{
+	cull_node_t* nodes;
+	unsigned int len;
+} cull_tree_t;
+
+/* The planes of a view frustum, which a point is inside if a x + b y + c z + d is not negative for all six.
+ */
+typedef struct cull_frustum
+{
+	GLfloat planes[6][4];
+} cull_frustum_t;
+
+
+
+/* Find how indices of a class of primitive can be cut into pieces: where each piece can start, in steps from the
+ * start of its strip, and how many indices it shares with the piece before, i.e. the vertices of a primitive but
+ * one, or none for separate primitives. Other classes are not cut.
+ * Returns whether they can be.
+ */
+static bool _cull_class(GLint element_class, unsigned int* step, unsigned int* overlap)
+{
+	switch (element_class)
+	{
+		case GL_TRIANGLE_STRIP:         *step = 2; *overlap = 2; return true;    // Keeps the winding.
+		case GL_LINE_STRIP:             *step = 1; *overlap = 1; return true;
+		case GL_LINE_STRIP_ADJACENCY:   *step = 1; *overlap = 3; return true;
+		case GL_TRIANGLES:              *step = 3; *overlap = 0; return true;
+		case GL_LINES:                  *step = 2; *overlap = 0; return true;
+		default:                        return false;
+	}
+}
+
+
+
+/* Find the box of a leaf around the vertices that its range of indices draws.
+ */
+static void _cull_leaf_box(cull_node_t* leaf, const GLuint* indices, const GLfloat* positions, size_t stride)
+{
+	for (unsigned int k = 0; k < 3; ++k)
+	{
+		leaf->low[k]  =  INFINITY;
+		leaf->high[k] = -INFINITY;
+	}
+	leaf->vertex_low  = 0xFFFFFFFF;
+	leaf->vertex_high = 0;
+	for (unsigned int i = leaf->first; i < leaf->first + leaf->count; ++i)
+	{
+		if (indices[i] == STARBOARD_CULL_RESTART)
+			continue;
+		const GLfloat* p = (const GLfloat*)((const char*)positions + indices[i] * stride);
+		for (unsigned int k = 0; k < 3; ++k)
+		{
+			leaf->low[k]  = fminf(leaf->low[k],  p[k]);
+			leaf->high[k] = fmaxf(leaf->high[k], p[k]);
+		}
+		leaf->vertex_low  = (indices[i] < leaf->vertex_low)  ? indices[i] : leaf->vertex_low;
+		leaf->vertex_high = (indices[i] > leaf->vertex_high) ? indices[i] : leaf->vertex_high;
+	}
+	for (unsigned int k = 0; k < 3; ++k)
+	{
+		leaf->low[k]  -= STARBOARD_CULL_MARGIN;
+		leaf->high[k] += STARBOARD_CULL_MARGIN;
+	}
+}
+
+
+
+/* Join the boxes of the children of node i, and the ranges they cover.
+ */
+static void _cull_join(cull_tree_t* tree, unsigned int i)
+{
+	cull_node_t*       node  = &tree->nodes[i];
+	const cull_node_t* left  = &tree->nodes[i + 1];
+	const cull_node_t* right = &tree->nodes[left->skip];
+	for (unsigned int k = 0; k < 3; ++k)
+	{
+		node->low[k]  = fminf(left->low[k],  right->low[k]);
+		node->high[k] = fmaxf(left->high[k], right->high[k]);
+	}
+	node->first       = left->first;
+	node->count       = right->first + right->count - left->first;
+	node->vertex_low  = (left->vertex_low  < right->vertex_low)  ? left->vertex_low  : right->vertex_low;
+	node->vertex_high = (left->vertex_high > right->vertex_high) ? left->vertex_high : right->vertex_high;
+}
+
+
+
+/* Add the subtree over leaves l up to r (not included) to a tree, in preorder, halving them at each node, so that
+ * the pieces of a chain, which are near each other, share nodes.
+ */
+static void _cull_subtree(cull_tree_t* tree, const cull_node_t* leaves, unsigned int l, unsigned int r)
+{
+	const unsigned int i = tree->len++;
+	if (r - l == 1)
+	{
+		tree->nodes[i]      = leaves[l];
+		tree->nodes[i].skip = tree->len;
+		return;
+	}
+	const unsigned int mid = l + (r - l) / 2;
+	_cull_subtree(tree, leaves, l, mid);
+	_cull_subtree(tree, leaves, mid, r);
+	tree->nodes[i].skip = tree->len;
+	_cull_join(tree, i);
+}
+
+
+
+/* Build the tree of boxes of n indices of a class of primitive, which draw vertices at positions of three floats,
+ * every stride bytes, of residues every residue_stride bytes. A piece ends once it reaches a residue as many
+ * residues from where it started as STARBOARD_CULL_RESIDUES, where a piece can start. Indices of a class that
+ * cannot be cut are one piece.
+ * Returns 0, or -1 if there is no memory, in which case the tree is empty, and every index is drawn.
+ */
+int cull_tree_build(cull_tree_t* tree, const GLuint* indices, unsigned int n, GLint element_class, \
+                    const GLfloat* positions, size_t stride, const GLuint* residues, size_t residue_stride)
+{
+	tree->nodes = NULL;
+	tree->len   = 0;
+	if (n == 0)
+		return 0;
+	unsigned int step = 1, overlap = 0;
+	const bool   cut  = _cull_class(element_class, &step, &overlap);
+	cull_node_t* leaves = (cull_node_t*)malloc(n * sizeof(cull_node_t)); // malloc leaves
+	if (leaves == NULL)
+		return -1;
+	
+	// Cut the indices where a piece reaches far enough along the chain.
+	unsigned int leaves_len = 0;
+	unsigned int first      = 0;
+	unsigned int start      = 0;    // Of the strip.
+	GLuint       residue    = STARBOARD_CULL_RESTART;
+	for (unsigned int i = 0; i < n; ++i)
+	{
+		if (indices[i] == STARBOARD_CULL_RESTART)
+		{
+			start = i + 1;
+			continue;
+		}
+		const GLuint r = *(const GLuint*)((const char*)residues + indices[i] * residue_stride);
+		if (residue == STARBOARD_CULL_RESTART)
+			residue = r;
+		const unsigned int along = (r > residue) ? r - residue : residue - r;
+		if (cut and along >= STARBOARD_CULL_RESIDUES and i > first and (i - start) % step == 0)
+		{
+			leaves[leaves_len].first = first;
+			leaves[leaves_len].count = ((i + overlap < n) ? i + overlap : n) - first;
+			++leaves_len;
+			first   = i;
+			residue = r;
+		}
+	}
+	leaves[leaves_len].first = first;
+	leaves[leaves_len].count = n - first;
+	++leaves_len;
+	for (unsigned int l = 0; l < leaves_len; ++l)
+		_cull_leaf_box(&leaves[l], indices, positions, stride);
+	
+	tree->nodes = (cull_node_t*)malloc((2 * leaves_len - 1) * sizeof(cull_node_t)); // malloc tree->nodes
+	if (tree->nodes != NULL)
+		_cull_subtree(tree, leaves, 0, leaves_len);
+	free(leaves); // free leaves
+	return (tree->nodes != NULL) ? 0 : -1;
+}
+
+
+
+/* Free the nodes of a tree, which is then empty.
+ */
+void cull_tree_free(cull_tree_t* tree)
+{
+	free(tree->nodes); // free tree->nodes
+	tree->nodes = NULL;
+	tree->len   = 0;
+}
+
+
+
+/* Find the boxes of the leaves of a tree that draw any of vertices first to last again, after they have moved in
+ * place, and of the nodes above them, from the same indices and positions that cull_tree_build() had.
+ */
+void cull_tree_refit(cull_tree_t* tree, const GLuint* indices, const GLfloat* positions, size_t stride, \
+                     unsigned int first, unsigned int last)
+{
+	if (tree->len == 0 or first > tree->nodes[0].vertex_high or last < tree->nodes[0].vertex_low)
+		return;
+	for (unsigned int i = 0; i < tree->len; ++i)
+	{
+		cull_node_t* leaf = &tree->nodes[i];
+		if (leaf->skip == i + 1 and first <= leaf->vertex_high and last >= leaf->vertex_low)
+			_cull_leaf_box(leaf, indices, positions, stride);
+	}
+	for (unsigned int i = tree->len; i > 0; --i)    // The children of a node come after it.
+		if (tree->nodes[i - 1].skip != i)
+			_cull_join(tree, i - 1);
+}
+
+
+
+/* Multiply two matrices of 16 floats by columns.
+ */
+static void _cull_multiply(const GLfloat a[16], const GLfloat b[16], GLfloat out[16])
+{
+	for (unsigned int c = 0; c < 4; ++c)
+		for (unsigned int r = 0; r < 4; ++r)
+		{
+			out[4 * c + r] = 0.0;
+			for (unsigned int k = 0; k < 4; ++k)
+				out[4 * c + r] += a[4 * k + r] * b[4 * c + k];
+		}
+}
+
+
+
+/* Find the frustum of a camera in the space of a model, from the camera's view-projection matrix, the model's
+ * matrix and the operator of a copy of the model, or NULL for none, all by columns, so that boxes are tested where
+ * they are, without transforming them.
+ */
+void cull_frustum(const GLfloat view_projection[16], const GLfloat model[16], const GLfloat* instance, \
+                  cull_frustum_t* out)
+{
+	GLfloat m[16];
+	_cull_multiply(view_projection, model, m);
+	if (instance != NULL)
+	{
+		GLfloat n[16];
+		_cull_multiply(m, instance, n);
+		memcpy(m, n, sizeof(m));
+	}
+	
+	// Each plane is the last row of the matrix plus or minus another, for -w <= x, y, z <= w in clip space.
+	for (unsigned int p = 0; p < 6; ++p)
+	{
+		const unsigned int row  = p / 2;
+		const GLfloat      sign = (p % 2 == 0) ? 1.0 : -1.0;
+		for (unsigned int c = 0; c < 4; ++c)
+			out->planes[p][c] = m[4 * c + 3] + sign * m[4 * c + row];
+	}
+}
+
+
+
+/* Find where a box is with respect to a frustum.
+ * Returns -1 if it is wholly outside, 1 if it is wholly inside, or 0 if it might be either.
+ */
+static int _cull_box(const cull_frustum_t* frustum, const GLfloat low[3], const GLfloat high[3])
+{
+	int side = 1;
+	for (unsigned int p = 0; p < 6; ++p)
+	{
+		const GLfloat* plane = frustum->planes[p];
+		GLfloat        most  = plane[3];    // Of the corner furthest inside the plane, and the one least inside.
+		GLfloat        least = plane[3];
+		for (unsigned int k = 0; k < 3; ++k)
+		{
+			most  += plane[k] * ((plane[k] >= 0.0) ? high[k] : low[k]);
+			least += plane[k] * ((plane[k] >= 0.0) ? low[k]  : high[k]);
+		}
+		if (most < 0.0)
+			return -1;
+		if (least < 0.0)
+			side = 0;
+	}
+	return side;
+}
+
+
+
+/* Find the ranges of indices of a buffer to draw with a frustum, by walking its tree from the box around them all,
+ * and skipping every node that is wholly outside the frustum. Ranges next to each other are joined, so that an
+ * object wholly in view is one range. There is room in ranges_out for as many ranges as the tree has leaves.
+ * Returns the number of ranges.
+ */
+unsigned int cull_tree_visible(const cull_tree_t* tree, const cull_frustum_t* frustum, scene_range_t* ranges_out)
+{
+	unsigned int len = 0;
+	unsigned int i   = 0;
+	while (i < tree->len)
+	{
+		const cull_node_t* node = &tree->nodes[i];
+		const int          side = _cull_box(frustum, node->low, node->high);
+		if (side < 0)
+		{
+			i = node->skip;
+			continue;
+		}
+		if (side == 0 and node->skip != i + 1)
+		{
+			++i;    // Look at its children.
+			continue;
+		}
+		if (len > 0 and node->first <= ranges_out[len - 1].first + ranges_out[len - 1].count)
+			ranges_out[len - 1].count = node->first + node->count - ranges_out[len - 1].first;
+		else
+		{
+			ranges_out[len].first = node->first;
+			ranges_out[len].count = node->count;
+			++len;
+		}
+		i = node->skip;
+	}
+	return len;
+}
+
+
+
+/* Order ranges by where they start.
+ */
+static int _cull_compare_ranges(const void* a, const void* b)
+{
+	const scene_range_t* A = (const scene_range_t*)a;
+	const scene_range_t* B = (const scene_range_t*)b;
+	return (A->first < B->first) ? -1 : (A->first > B->first) ? 1 : 0;
+}
+
+
+
+/* Join ranges of indices that cull_tree_visible() found for several copies of a buffer into as few as cover them
+ * all, in order, e.g. to draw the pieces in view of any copy in every copy.
+ * Returns the number of ranges.
+ */
+unsigned int cull_ranges_join(scene_range_t* ranges, unsigned int len)
+{
+	if (len < 2)
+		return len;
+	qsort(ranges, len, sizeof(scene_range_t), _cull_compare_ranges);
+	unsigned int joined = 1;
+	for (unsigned int i = 1; i < len; ++i)
+	{
+		scene_range_t* last = &ranges[joined - 1];
+		if (ranges[i].first <= last->first + last->count)
+		{
+			const unsigned int end = ranges[i].first + ranges[i].count;
+			if (end > last->first + last->count)
+				last->count = end - last->first;
+		}
+		else
+			ranges[joined++] = ranges[i];
+	}
+	return joined;
+}
+
+#endif
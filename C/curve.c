@@ -82,6 +82,196 @@ int three_points_arc(vec4 A, vec4 B, vec4 C, vec4* O, float* R, vec4* Z)
 
 
 
+/* The lanes of the batched arc kernel: eight floats with AVX, four with SSE, and one (the scalar code) otherwise.
+ * Every ARCV_ operation maps onto one intrinsic.
+ */
+#if defined(__AVX__)
+	#define ARCV_LANES             8
+	typedef __m256 arcv_t;
+	#define ARCV_LOAD(p)           _mm256_loadu_ps(p)
+	#define ARCV_STORE(p, a)       _mm256_storeu_ps(p, a)
+	#define ARCV_SET1(f)           _mm256_set1_ps(f)
+	#define ARCV_ADD(a, b)         _mm256_add_ps(a, b)
+	#define ARCV_SUB(a, b)         _mm256_sub_ps(a, b)
+	#define ARCV_MUL(a, b)         _mm256_mul_ps(a, b)
+	#define ARCV_DIV(a, b)         _mm256_div_ps(a, b)
+	#define ARCV_SQRT(a)           _mm256_sqrt_ps(a)
+	#define ARCV_LE(a, b)          _mm256_cmp_ps(a, b, _CMP_LE_OQ)
+	#define ARCV_SELECT(m, a, b)   _mm256_blendv_ps(b, a, m)
+	#define ARCV_MOVEMASK(m)       _mm256_movemask_ps(m)
+#elif defined(__SSE2__)
+	#define ARCV_LANES             4
+	typedef __m128 arcv_t;
+	#define ARCV_LOAD(p)           _mm_loadu_ps(p)
+	#define ARCV_STORE(p, a)       _mm_storeu_ps(p, a)
+	#define ARCV_SET1(f)           _mm_set1_ps(f)
+	#define ARCV_ADD(a, b)         _mm_add_ps(a, b)
+	#define ARCV_SUB(a, b)         _mm_sub_ps(a, b)
+	#define ARCV_MUL(a, b)         _mm_mul_ps(a, b)
+	#define ARCV_DIV(a, b)         _mm_div_ps(a, b)
+	#define ARCV_SQRT(a)           _mm_sqrt_ps(a)
+	#define ARCV_LE(a, b)          _mm_cmple_ps(a, b)
+	#define ARCV_SELECT(m, a, b)   _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b))
+	#define ARCV_MOVEMASK(m)       _mm_movemask_ps(m)
+#endif
+
+// Triplets whose two sides are this close to parallel (the square of the sine of the angle between them) are
+// treated as straight, and given the default arc.
+#define STARBOARD_CURVE_STRAIGHT 1e-8f
+
+
+
+/* Find the arc through the points i - 1, i, i + 1 of P, by the closed-form circumcentre. With a = A - C and
+ * b = B - C, the centre is C + ((|a|^2 b - |b|^2 a) x (a x b)) / (2 |a x b|^2), the radius is
+ * |a| |b| |a - b| / (2 |a x b|), and the normal to the plane of the arc is a x b, normed.
+ * Returns 1 if the points are (nearly) collinear, and the default arc was written, or 0 otherwise.
+ */
+static inline int __three_points_arc_scalar(const float* const P[3], const unsigned int i, \
+                                            float* const O[3], float* R, float* const Z[3])
+{
+	const float ax = P[0][i - 1] - P[0][i + 1], ay = P[1][i - 1] - P[1][i + 1], az = P[2][i - 1] - P[2][i + 1];
+	const float bx = P[0][i]     - P[0][i + 1], by = P[1][i]     - P[1][i + 1], bz = P[2][i]     - P[2][i + 1];
+	const float cx = ay * bz - az * by, cy = az * bx - ax * bz, cz = ax * by - ay * bx;
+	const float a2 = ax * ax + ay * ay + az * az;
+	const float b2 = bx * bx + by * by + bz * bz;
+	const float c2 = cx * cx + cy * cy + cz * cz;
+	if (c2 <= STARBOARD_CURVE_STRAIGHT * a2 * b2)
+	{
+		O[0][i] = P[0][i];
+		O[1][i] = P[1][i];
+		O[2][i] = P[2][i];
+		R[i]    = 0.0;
+		Z[0][i] = 0.0;
+		Z[1][i] = 0.0;
+		Z[2][i] = 1.0;
+		return 1;
+	}
+	const float dx = a2 * bx - b2 * ax, dy = a2 * by - b2 * ay, dz = a2 * bz - b2 * az;
+	const float s  = 0.5 / c2;
+	const float ex = ax - bx, ey = ay - by, ez = az - bz;
+	const float n  = 1.0 / sqrtf(c2);
+	O[0][i] = P[0][i + 1] + s * (dy * cz - dz * cy);
+	O[1][i] = P[1][i + 1] + s * (dz * cx - dx * cz);
+	O[2][i] = P[2][i + 1] + s * (dx * cy - dy * cx);
+	R[i]    = sqrtf(a2 * b2 * (ex * ex + ey * ey + ez * ez) * s * 0.5);
+	Z[0][i] = n * cx;
+	Z[1][i] = n * cy;
+	Z[2][i] = n * cz;
+	return 0;
+}
+
+
+
+/* Find the arc through every point of P and its two neighbours at once, as three_points_arc() does for one
+ * triplet, but by the closed-form circumcentre rather than by a change of basis. The points, and the centres O,
+ * radii R and normals Z written for each of them, are arrays of each component (x, y, z) of length n. The first
+ * and last points, and the middle of any straight triplet, get the default arc: centred on the point itself,
+ * with radius 0 and normal +z.
+ * Returns the number of straight triplets.
+ */
+int three_points_arcs(const float* const P[3], const unsigned int n, float* const O[3], float* R, float* const Z[3])
+{
+	if (n == 0)
+		return 0;
+	int          straight = 0;
+	unsigned int i        = 1;
+	#ifdef ARCV_LANES
+	const arcv_t EPS  = ARCV_SET1(STARBOARD_CURVE_STRAIGHT);
+	const arcv_t HALF = ARCV_SET1(0.5);
+	const arcv_t ZERO = ARCV_SET1(0.0);
+	const arcv_t ONE  = ARCV_SET1(1.0);
+	for (; i + ARCV_LANES + 1 <= n; i += ARCV_LANES)
+	{
+		const arcv_t Cx = ARCV_LOAD(P[0] + i + 1), Cy = ARCV_LOAD(P[1] + i + 1), Cz = ARCV_LOAD(P[2] + i + 1);
+		const arcv_t Bx = ARCV_LOAD(P[0] + i),     By = ARCV_LOAD(P[1] + i),     Bz = ARCV_LOAD(P[2] + i);
+		const arcv_t ax = ARCV_SUB(ARCV_LOAD(P[0] + i - 1), Cx);
+		const arcv_t ay = ARCV_SUB(ARCV_LOAD(P[1] + i - 1), Cy);
+		const arcv_t az = ARCV_SUB(ARCV_LOAD(P[2] + i - 1), Cz);
+		const arcv_t bx = ARCV_SUB(Bx, Cx), by = ARCV_SUB(By, Cy), bz = ARCV_SUB(Bz, Cz);
+		const arcv_t cx = ARCV_SUB(ARCV_MUL(ay, bz), ARCV_MUL(az, by));
+		const arcv_t cy = ARCV_SUB(ARCV_MUL(az, bx), ARCV_MUL(ax, bz));
+		const arcv_t cz = ARCV_SUB(ARCV_MUL(ax, by), ARCV_MUL(ay, bx));
+		const arcv_t a2 = ARCV_ADD(ARCV_ADD(ARCV_MUL(ax, ax), ARCV_MUL(ay, ay)), ARCV_MUL(az, az));
+		const arcv_t b2 = ARCV_ADD(ARCV_ADD(ARCV_MUL(bx, bx), ARCV_MUL(by, by)), ARCV_MUL(bz, bz));
+		const arcv_t c2 = ARCV_ADD(ARCV_ADD(ARCV_MUL(cx, cx), ARCV_MUL(cy, cy)), ARCV_MUL(cz, cz));
+		const arcv_t m  = ARCV_LE(c2, ARCV_MUL(EPS, ARCV_MUL(a2, b2)));    // Straight lanes.
+		
+		const arcv_t dx = ARCV_SUB(ARCV_MUL(a2, bx), ARCV_MUL(b2, ax));
+		const arcv_t dy = ARCV_SUB(ARCV_MUL(a2, by), ARCV_MUL(b2, ay));
+		const arcv_t dz = ARCV_SUB(ARCV_MUL(a2, bz), ARCV_MUL(b2, az));
+		const arcv_t s  = ARCV_DIV(HALF, c2);
+		const arcv_t ex = ARCV_SUB(ax, bx), ey = ARCV_SUB(ay, by), ez = ARCV_SUB(az, bz);
+		const arcv_t e2 = ARCV_ADD(ARCV_ADD(ARCV_MUL(ex, ex), ARCV_MUL(ey, ey)), ARCV_MUL(ez, ez));
+		const arcv_t q  = ARCV_DIV(ONE, ARCV_SQRT(c2));
+		const arcv_t ox = ARCV_ADD(Cx, ARCV_MUL(s, ARCV_SUB(ARCV_MUL(dy, cz), ARCV_MUL(dz, cy))));
+		const arcv_t oy = ARCV_ADD(Cy, ARCV_MUL(s, ARCV_SUB(ARCV_MUL(dz, cx), ARCV_MUL(dx, cz))));
+		const arcv_t oz = ARCV_ADD(Cz, ARCV_MUL(s, ARCV_SUB(ARCV_MUL(dx, cy), ARCV_MUL(dy, cx))));
+		const arcv_t r  = ARCV_SQRT(ARCV_MUL(ARCV_MUL(ARCV_MUL(a2, b2), e2), ARCV_MUL(s, HALF)));
+		
+		// Straight lanes divided by (nearly) zero, so overwrite them with the default arc.
+		ARCV_STORE(O[0] + i, ARCV_SELECT(m, Bx, ox));
+		ARCV_STORE(O[1] + i, ARCV_SELECT(m, By, oy));
+		ARCV_STORE(O[2] + i, ARCV_SELECT(m, Bz, oz));
+		ARCV_STORE(R + i,    ARCV_SELECT(m, ZERO, r));
+		ARCV_STORE(Z[0] + i, ARCV_SELECT(m, ZERO, ARCV_MUL(q, cx)));
+		ARCV_STORE(Z[1] + i, ARCV_SELECT(m, ZERO, ARCV_MUL(q, cy)));
+		ARCV_STORE(Z[2] + i, ARCV_SELECT(m, ONE,  ARCV_MUL(q, cz)));
+		straight += __builtin_popcount((unsigned int)ARCV_MOVEMASK(m));
+	}
+	#endif
+	for (; i + 1 < n; ++i)
+		straight += __three_points_arc_scalar(P, i, O, R, Z);
+	
+	// The ends have only one neighbour each.
+	for (unsigned int k = 0, j = 0; k < 2; ++k, j = n - 1)
+	{
+		O[0][j] = P[0][j];
+		O[1][j] = P[1][j];
+		O[2][j] = P[2][j];
+		R[j]    = 0.0;
+		Z[0][j] = 0.0;
+		Z[1][j] = 0.0;
+		Z[2][j] = 1.0;
+	}
+	return straight;
+}
+
+
+
+/* Find the arcs through every point of an array of vec4s and its two neighbours with three_points_arcs(),
+ * converting to and from its arrays of components in scratch space from the arena.
+ * Returns the number of straight triplets, or less than 0 on error.
+ */
+static int _three_points_arcs_vec4(arena_t* arena, const vec4* points, const unsigned int n, \
+                                   vec4* O, float* R, vec4* Z)
+{
+	const arena_mark_t mark   = arena_mark(arena);
+	float*             memory = (float*)arena_alloc(arena, 9 * n * sizeof(float));
+	if (memory == NULL)
+		return -1;
+	float* const P[3]  = {memory, memory + n, memory + 2 * n};
+	float* const Oc[3] = {memory + 3 * n, memory + 4 * n, memory + 5 * n};
+	float* const Zc[3] = {memory + 6 * n, memory + 7 * n, memory + 8 * n};
+	for (unsigned int i = 0; i < n; ++i)
+		for (unsigned int k = 0; k < 3; ++k)
+			P[k][i] = points[i][k];
+	int straight = three_points_arcs((const float* const*)P, n, Oc, R, Zc);
+	for (unsigned int i = 0; i < n; ++i)
+	{
+		for (unsigned int k = 0; k < 3; ++k)
+		{
+			O[i][k] = Oc[k][i];
+			Z[i][k] = Zc[k][i];
+		}
+		O[i][3] = 1.0;
+		Z[i][3] = 0.0;
+	}
+	arena_release(arena, mark);
+	return straight;
+}
+
+
+
 /* Take two points, A, B, and the centre of a circle that intersects them, O, and bisect the arc between them.
  */
 int bisect_arc(vec4 A, vec4 B, vec4 O, vec4* N)
@@ -126,154 +316,683 @@ int bisect_arc(vec4 A, vec4 B, vec4 O, vec4* N)
 
 
 
-/* Bisect twice based on different radii and take the mean result.
+/* Find the point a fraction t of the way along the arc from A to B about the centre O, interpolating the angle
+ * and the distance from O. At t = 0.5 this is the point that bisect_arc() finds.
+ * Returns 0 on success, or less than 0 if there is no arc (O is A or B, or A and B are in line with O).
  */
-static inline void __average_bisect(vec4 P1, vec4 P2, vec4 O1, vec4 O2, vec4* B, vec4* O, float* R, vec4* Z)
+static inline int __arc_point(vec4 A, vec4 B, vec4 O, const float t, vec4* N)
 {
-	// Perform the arc bisection twice and output the average result.
-	vec4 bisect1, bisect2, bisect_add;
-	int e = bisect_arc(P1, P2, O1, &bisect1);
-	int f = bisect_arc(P1, P2, O2, &bisect2);
-	if (e < 0 or f < 0)
+	vec4 a, b;
+	vec4_sub(a, A, O);
+	vec4_sub(b, B, O);
+	const float ra = vec3_len(a);
+	const float rb = vec3_len(b);
+	if (ra < 1e-4 or rb < 1e-4)
+		return -1;
+	float c = vec3_mul_inner(a, b) / (ra * rb);
+	c = (c > 1.0) ? 1.0 : ((c < -1.0) ? -1.0 : c);
+	const float w = acosf(c);
+	const float s = sinf(w);
+	if (s < 1e-4)
+		return -2;
+	const float fa = sinf((1.0 - t) * w) / (s * ra);
+	const float fb = sinf(t * w) / (s * rb);
+	const float r  = (1.0 - t) * ra + t * rb;
+	for (unsigned int k = 0; k < 3; ++k)
+		(*N)[k] = O[k] + r * (fa * a[k] + fb * b[k]);
+	(*N)[3] = A[3];
+	return 0;
+}
+
+
+
+/* Find the point a fraction t of the way from P1 to P2 along the arcs of each, and take the mean result. If either
+ * arc is missing, the point is on the straight line instead.
+ */
+static inline void __average_arc_point(vec4 P1, vec4 P2, vec4 O1, vec4 O2, const float t, vec4* N)
+{
+	vec4 N1, N2;
+	if (__arc_point(P1, P2, O1, t, &N1) < 0 or __arc_point(P1, P2, O2, t, &N2) < 0)
 	{
-		//printf("[NOTICE] %s %i, %i.\n", "Calls to bisect_arc failed with codes:", e, f);
-		memcpy(bisect1, P1, sizeof(vec4));
-		memcpy(bisect2, P2, sizeof(vec4));
+		vec4_scale(N1, P1, 1.0 - t);
+		vec4_scale(N2, P2, t);
+		vec4_add(*N, N1, N2);
+		return;
 	}
-	vec4_add(bisect_add, bisect1, bisect2);
-	vec4_scale(*B, bisect_add, 0.5);
-	// Calculate the new arc centre, radius, and normal. 
-	three_points_arc(P1, *B, P2, O, R, Z);
+	vec4_add(*N, N1, N2);
+	vec4_scale(*N, *N, 0.5);
 }
 
 
 
-/* Take a set of n points with arc parameters and output 2n - 1 interpolated points.
+/* Translate a quality level into subdivision settings. Level 0 is the original scheme, which bisects every segment
+ * once; higher levels let each piece sweep a smaller angle, and let straight segments go unsplit. The splines cut
+ * every segment into level + 1 pieces, or two at level 0.
  */
-static inline int _interpolate_coords_by_arcs(vec4* coords, unsigned int count, \
-                                              vec4* centres, float* radii, vec4* normals, \
-                                              vec4** p_out, vec4** O_out, float** R_out, vec4** Z_out)
+curve_quality_t curve_quality_level(unsigned int level)
 {
-	// Create storage space for the new set of points, arc centres, etc.
-	unsigned int count_new = 2 * count - 1;
-	*p_out = (vec4*) malloc(count_new * sizeof(vec4));
-	*O_out = (vec4*) malloc(count_new * sizeof(vec4));
-	*R_out = (float*)malloc(count_new * sizeof(float));
-	*Z_out = (vec4*) malloc(count_new * sizeof(vec4));
-	if (*p_out == NULL or *O_out == NULL or *R_out == NULL or *Z_out == NULL)
+	if (level > STARBOARD_CURVE_QUALITY_MAX)
+		level = STARBOARD_CURVE_QUALITY_MAX;
+	curve_quality_t q = {2, 2, 0.0, 2};
+	if (level > 0)
 	{
-		printf("[WARNING] %s\n", "A call to malloc() returned NULL.");
-		return -1;
+		q.min    = (level + 1) / 2;
+		q.max    = 4 * level;
+		q.angle  = (float)(M_PI / 3.0) / level;
+		q.pieces = level + 1;
 	}
-	vec4*  p = *p_out;
-	vec4*  O = *O_out;
-	float* R = *R_out;
-	vec4*  Z = *Z_out;
+	return q;
+}
+
+
+
+/* Choose the number of pieces to split the segment from A to B into. The segment lies on both of their arcs, and
+ * the tighter of the two decides the angle it sweeps.
+ */
+static inline unsigned int __subdivisions(const curve_quality_t* q, vec4 A, vec4 B, const float RA, const float RB)
+{
+	float R = (RA > 0.0 and (RB <= 0.0 or RA < RB)) ? RA : RB;
+	if (q->angle <= 0.0 or R <= 0.0)
+		return q->min;
+	vec4 AB;
+	vec4_sub(AB, B, A);
+	const float half  = vec3_len(AB) / (2.0 * R);
+	const float angle = 2.0 * asinf((half < 1.0) ? half : 1.0);
+	unsigned int n = (unsigned int)ceilf(angle / q->angle);
+	return (n < q->min) ? q->min : ((n > q->max) ? q->max : n);
+}
+
+
+
+/* Take a set of n points with arc parameters and the first point of each segment, and write the interpolated
+ * points, and their arc parameters, to p, O, R and Z.
+ * Returns the number of points written, or less than 0 on error.
+ */
+static inline int _interpolate_coords_by_arcs(arena_t* arena, vec4* coords, unsigned int count, \
+                                              vec4* centres, float* radii, vec4* normals, \
+                                              const unsigned int* offsets, \
+                                              vec4* p, vec4* O, float* R, vec4* Z)
+{
+	unsigned int count_new = offsets[count - 1] + 1;
 	
 	// Iterate over every point (bar the last). Take it and its next neighbour, and interpolate. 
-	vec4 bisect;
-	for (unsigned int i = 0, j = 0; i < count - 1; ++i, j += 2)
+	for (unsigned int i = 0; i < count - 1; ++i)
 	{
-		// Perform an arc bisection on the points i and i + 1.
-		__average_bisect(coords[i], coords[i + 1], centres[i], centres[i + 1], \
-		                 &p[j + 1], &O[j + 1],     &R[j + 1],  &Z[j + 1]);
-		memcpy(p[j],  coords[i],  sizeof(vec4));
+		const unsigned int j = offsets[i];
+		const unsigned int s = offsets[i + 1] - j;
+		memcpy(p[j], coords[i], sizeof(vec4));
+		for (unsigned int k = 1; k < s; ++k)
+			__average_arc_point(coords[i], coords[i + 1], centres[i], centres[i + 1], (float)k / s, &p[j + k]);
+	}
+	memcpy(p[count_new - 1], coords[count - 1], sizeof(vec4));
+	
+	// Each new point's arc runs through it and its neighbours in p, so one batch finds them all. The old points
+	// keep the arcs they had.
+	int e = _three_points_arcs_vec4(arena, p, count_new, O, R, Z);
+	if (e < 0)
+		return -1;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		const unsigned int j = offsets[i];
 		memcpy(O[j],  centres[i], sizeof(vec4));
 		memcpy(&R[j], &radii[i],  sizeof(float));
 		memcpy(Z[j],  normals[i], sizeof(vec4));
 	}
-	// Append the last point, which we skipped (because last + 1 would be an overflow). 
-	memcpy(p[count_new - 1],  coords[count - 1],  sizeof(vec4));
-	memcpy(O[count_new - 1],  centres[count - 1], sizeof(vec4));
-	memcpy(&R[count_new - 1], &radii[count - 1],  sizeof(float));
-	memcpy(Z[count_new - 1],  normals[count - 1], sizeof(vec4));
 	return count_new;
 }
 
 
 
-/* Map n points to 2n + 1 interpolated points.
+/* Map n points to an interpolated curve, splitting the segment after each point into as many pieces as the
+ * quality settings ask for given its curvature. The last point is followed by a straight segment, split like the
+ * one before it, so every point starts a segment, i.e. a residue of the ribbon. The outputs, including the
+ * first point of each segment (plus the last point), are allocated from the arena at their final size; the arc
+ * parameters of the original points are scratch space, given back before returning.
+ * Returns the number of points, or less than 0 on error.
  */
-int interpolate_arc_curve(vec4* coords, unsigned int count, \
-                          vec4** p_out, vec4** O_out, float** R_out, vec4** Z_out)
+int interpolate_arc_curve(arena_t* arena, const curve_quality_t* quality, vec4* coords, unsigned int count, \
+                          vec4** p_out, vec4** O_out, float** R_out, vec4** Z_out, unsigned int** offsets_out)
 {
 	static const vec4 UP = {0.0, 0.0, 1.0, 0.0}; // This is a default orientation for the ribbon on error.
-	
-	// Create arrays for the calculated centres, radii, and normals to the arc i.e. the ribbon. 
-	vec4  centres[count];
-	float radii[count];
-	vec4  normals[count];
-	// Iterate over all the points bar the first and the last, and find the arc parameters for those points
-	// based on their previous and next neighbour.
-	int e;
-	for (unsigned int i = 1; i < count - 1; ++i)
+	if (count < 2)
 	{
-		e = three_points_arc(coords[i - 1], coords[i], coords[i + 1], &centres[i], &radii[i], &normals[i]);
-		if (e < 0) // On error, assign sensible default parameters.
-		{
-			printf("[NOTICE] %s: %i.\n", "Call to three_points_arc(...) returned code", e);
-			memcpy(centres[i], coords[i], sizeof(vec4));
-			radii[i] = 0.0;
-			memcpy(normals[i], UP, sizeof(vec4));
-		}
+		printf("[WARNING] %s: %u.\n", "Too few points to interpolate a curve", count);
+		return -2;
 	}
-	// Fill in the information for the first and last point. 
-	memcpy(centres[0],         coords[0],         sizeof(vec4));
-	memcpy(centres[count - 1], coords[count - 1], sizeof(vec4));
-	radii[0]         = 0.0;
-	radii[count - 1] = 0.0;
-	memcpy(normals[0],         UP, sizeof(vec4));
-	memcpy(normals[count - 1], UP, sizeof(vec4));
 	
-	// Take the coordinates, and the arc parameters we just calculated, and interpolate all the points. 
-	int f = _interpolate_coords_by_arcs(coords, count, centres, radii, normals, \
-                                            p_out, O_out, R_out, Z_out);
-	        // malloc p_out, O_out, R_out, Z_out
-	// Parse the return value of _interpolate_coords_by_arcs(...).
-	unsigned int count_new;
-	if (f <= 0) // A return value of zero or less should never happen, but indicates error.
-		return f - 1;
-	else // A return value of one or more indicates the number of points returned.
-		count_new = f + 2;
-	// Map "A -|- B -|- C" to "A -|- B -|- C -|- " i.e. we need two extra half-widths at the end. 
-	*p_out = (vec4*) realloc(*p_out, count_new * sizeof(vec4));
-	*O_out = (vec4*) realloc(*O_out, count_new * sizeof(vec4));
-	*R_out = (float*)realloc(*R_out, count_new * sizeof(float));
-	*Z_out = (vec4*) realloc(*Z_out, count_new * sizeof(vec4));
-	if (*p_out == NULL or *O_out == NULL or *R_out == NULL or *Z_out == NULL)
-	{
-		printf("[WARNING] %s\n", "A call to realloc() returned NULL.");
-		return -3;
-	}
+	// Create arrays for the calculated centres, radii, and normals to the arc i.e. the ribbon. The outputs are
+	// sized from these, so are allocated above them, and these stay in the arena until it is reset; they are
+	// small next to the outputs.
+	*offsets_out = (unsigned int*)arena_alloc(arena, (count + 1) * sizeof(unsigned int));
+	unsigned int* offsets = *offsets_out;
+	vec4*         centres = (vec4*) arena_alloc(arena, count * sizeof(vec4));
+	float*        radii   = (float*)arena_alloc(arena, count * sizeof(float));
+	vec4*         normals = (vec4*) arena_alloc(arena, count * sizeof(vec4));
+	if (offsets == NULL or centres == NULL or radii == NULL or normals == NULL)
+		return -1;
+	
+	// Find the arc parameters for every point based on its previous and next neighbour, all in one batch.
+	int e = _three_points_arcs_vec4(arena, coords, count, centres, radii, normals);
+	if (e < 0)
+		return -1;
+	//if (e > 0)
+	//	printf("[NOTICE] %s: %i.\n", "Straight triplets given the default arc", e);
+	
+	// Split each segment according to its curvature, and the last (straight) one like the one before it.
+	offsets[0] = 0;
+	for (unsigned int i = 0; i < count - 1; ++i)
+		offsets[i + 1] = offsets[i] + __subdivisions(quality, coords[i], coords[i + 1], radii[i], radii[i + 1]);
+	offsets[count] = offsets[count - 1] + (offsets[count - 1] - offsets[count - 2]);
+	unsigned int count_new = offsets[count] + 1;
+	*p_out = (vec4*) arena_alloc(arena, count_new * sizeof(vec4));
+	*O_out = (vec4*) arena_alloc(arena, count_new * sizeof(vec4));
+	*R_out = (float*)arena_alloc(arena, count_new * sizeof(float));
+	*Z_out = (vec4*) arena_alloc(arena, count_new * sizeof(vec4));
 	vec4*  p = *p_out;
 	vec4*  O = *O_out;
 	float* R = *R_out;
 	vec4*  Z = *Z_out;
-	// Calculate the position of the points in this last residue.
+	if (p == NULL or O == NULL or R == NULL or Z == NULL)
+		return -1;
+	
+	// Take the coordinates, and the arc parameters we just calculated, and interpolate all the points. 
+	int f = _interpolate_coords_by_arcs(arena, coords, count, centres, radii, normals, offsets, p, O, R, Z);
+	if (f <= 0) // A return value of zero or less should never happen, but indicates error.
+		return f - 1;
+	
+	// Calculate the position of the points in this last residue, continuing from the last step before it.
 	vec4 DN;
-	vec4_sub(DN, p[count_new - 3], p[count_new - 4]); // Goes from N-3 -> N-2.
-	vec4_add(p[count_new - 2], p[count_new - 3], DN); // N-1 = N-2 + (N-3 -> N-2).
-	vec4_add(p[count_new - 1], p[count_new - 2], DN); // N   = N-1 + (N-3 -> N-2).
-	// Give those points radii, centres, etc.
-	memcpy(O[count_new - 2], p[count_new - 2], sizeof(vec4));
-	R[count_new - 2] = 0.0;
-	memcpy(Z[count_new - 2], UP, sizeof(vec4));
-	memcpy(O[count_new - 1], p[count_new - 1], sizeof(vec4));
-	R[count_new - 1] = 0.0;
-	memcpy(Z[count_new - 1], UP, sizeof(vec4));
+	vec4_sub(DN, p[offsets[count - 1]], p[offsets[count - 1] - 1]);
+	for (unsigned int j = offsets[count - 1] + 1; j < count_new; ++j)
+	{
+		vec4_add(p[j], p[j - 1], DN);
+		// Give those points radii, centres, etc.
+		memcpy(O[j], p[j], sizeof(vec4));
+		R[j] = 0.0;
+		memcpy(Z[j], UP, sizeof(vec4));
+	}
+	return count_new;
+}
+
+
+
+/* Recompute the curve of a run of n points after points first to last of them have moved, keeping the number of
+ * points each has, so that the result can be patched over the old one. An arc depends only on a point and its
+ * neighbours, so only the points of residues first - 2 to last + 1 change; those residues are returned through
+ * from and to. The offsets, p, O, R and Z are those that interpolate_arc_curve() made for the run, and may be
+ * part of larger arrays. Scratch space is taken from the arena, and given back before returning.
+ * Returns 0 on success, or less than 0 on error.
+ */
+int update_arc_curve(arena_t* arena, vec4* coords, unsigned int count, const unsigned int* offsets, \
+                     unsigned int first, unsigned int last, vec4* p, vec4* O, float* R, vec4* Z, \
+                     unsigned int* from, unsigned int* to)
+{
+	static const vec4 UP = {0.0, 0.0, 1.0, 0.0};
+	if (count < 2 or first > last or last >= count)
+		return -2;
+	const arena_mark_t mark = arena_mark(arena);
+	
+	// The arcs of the moved points and their neighbours change. Find them with one more point either side, so
+	// that every arc has the neighbours it had before (or none, at the ends of the run).
+	const unsigned int lo  = (first > 0) ? first - 1 : 0;
+	const unsigned int hi  = (last + 1 < count) ? last + 1 : count - 1;
+	const unsigned int wlo = (lo > 0) ? lo - 1 : 0;
+	const unsigned int whi = (hi + 1 < count) ? hi + 1 : count - 1;
+	const unsigned int m   = whi - wlo + 1;
+	vec4*  Ow = (vec4*) arena_alloc(arena, m * sizeof(vec4));
+	float* Rw = (float*)arena_alloc(arena, m * sizeof(float));
+	vec4*  Zw = (vec4*) arena_alloc(arena, m * sizeof(vec4));
+	if (Ow == NULL or Rw == NULL or Zw == NULL or _three_points_arcs_vec4(arena, coords + wlo, m, Ow, Rw, Zw) < 0)
+	{
+		arena_release(arena, mark);
+		return -1;
+	}
+	for (unsigned int i = first; i <= last; ++i)
+		memcpy(p[offsets[i]], coords[i], sizeof(vec4));
+	for (unsigned int i = lo; i <= hi; ++i)
+	{
+		memcpy(O[offsets[i]],  Ow[i - wlo],  sizeof(vec4));
+		memcpy(&R[offsets[i]], &Rw[i - wlo], sizeof(float));
+		memcpy(Z[offsets[i]],  Zw[i - wlo],  sizeof(vec4));
+	}
+	
+	// The segments after each of those points, and the one before the first, run along the changed arcs.
+	*from = (first > 1) ? first - 2 : 0;
+	*to   = hi;
+	const unsigned int end = (*to < count - 1) ? *to : count - 2;    // The last segment between two points.
+	for (unsigned int i = *from; i <= end; ++i)
+	{
+		const unsigned int j = offsets[i];
+		const unsigned int s = offsets[i + 1] - j;
+		for (unsigned int k = 1; k < s; ++k)
+			__average_arc_point(coords[i], coords[i + 1], O[j], O[offsets[i + 1]], (float)k / s, &p[j + k]);
+	}
+	
+	// Each new point's arc runs through its neighbours, which stop at the points either end of those segments.
+	const unsigned int plo = offsets[*from];
+	const unsigned int phi = offsets[end + 1];
+	const unsigned int pm  = phi - plo + 1;
+	vec4*  Op = (vec4*) arena_alloc(arena, pm * sizeof(vec4));
+	float* Rp = (float*)arena_alloc(arena, pm * sizeof(float));
+	vec4*  Zp = (vec4*) arena_alloc(arena, pm * sizeof(vec4));
+	if (Op == NULL or Rp == NULL or Zp == NULL or _three_points_arcs_vec4(arena, p + plo, pm, Op, Rp, Zp) < 0)
+	{
+		arena_release(arena, mark);
+		return -1;
+	}
+	for (unsigned int i = *from; i <= end; ++i)
+		for (unsigned int j = offsets[i] + 1; j < offsets[i + 1]; ++j)
+		{
+			memcpy(O[j],  Op[j - plo],  sizeof(vec4));
+			memcpy(&R[j], &Rp[j - plo], sizeof(float));
+			memcpy(Z[j],  Zp[j - plo],  sizeof(vec4));
+		}
+	
+	// The last residue continues from the step before it, so follows any change to it.
+	if (end == count - 2)
+	{
+		*to = count - 1;
+		vec4 DN;
+		vec4_sub(DN, p[offsets[count - 1]], p[offsets[count - 1] - 1]);
+		for (unsigned int j = offsets[count - 1] + 1; j <= offsets[count]; ++j)
+		{
+			vec4_add(p[j], p[j - 1], DN);
+			memcpy(O[j], p[j], sizeof(vec4));
+			R[j] = 0.0;
+			memcpy(Z[j], UP, sizeof(vec4));
+		}
+	}
+	arena_release(arena, mark);
+	return 0;
+}
+
+
+
+/* The Catmull-Rom and uniform cubic B-spline bases, as the weight of each of the four control points (columns)
+ * for each power of t (rows).
+ */
+static const float CATMULL_ROM[4][4] = {{ 0.0,        1.0,        0.0,        0.0      }, \
+                                        {-0.5,        0.0,        0.5,        0.0      }, \
+                                        { 1.0,       -2.5,        2.0,       -0.5      }, \
+                                        {-0.5,        1.5,       -1.5,        0.5      }};
+static const float B_SPLINE[4][4]    = {{ 1.0 / 6.0,  4.0 / 6.0,  1.0 / 6.0,  0.0      }, \
+                                        {-0.5,        0.0,        0.5,        0.0      }, \
+                                        { 0.5,       -1.0,        0.5,        0.0      }, \
+                                        {-1.0 / 6.0,  0.5,       -0.5,        1.0 / 6.0}};
+
+
+
+/* Tabulate the weights of a spline's control points, and of their derivatives, at each step of a segment cut into
+ * the given number of pieces.
+ */
+void curve_spline_basis(curve_engine_t engine, unsigned int pieces, curve_basis_t* basis)
+{
+	pieces = (pieces < 1) ? 1 : ((pieces > STARBOARD_CURVE_PIECES_MAX) ? STARBOARD_CURVE_PIECES_MAX : pieces);
+	const float (*M)[4] = (engine == CURVE_ENGINE_B_SPLINE) ? B_SPLINE : CATMULL_ROM;
+	basis->pieces = pieces;
+	for (unsigned int k = 0; k <= pieces; ++k)
+	{
+		const float t     = (float)k / pieces;
+		const float T[4]  = {1.0, t,   t * t, t * t * t};
+		const float T1[4] = {0.0, 1.0, 2 * t, 3 * t * t};
+		const float T2[4] = {0.0, 0.0, 2.0,   6 * t};
+		for (unsigned int j = 0; j < 4; ++j)
+		{
+			basis->W[k][j]  = 0.0;
+			basis->D1[k][j] = 0.0;
+			basis->D2[k][j] = 0.0;
+			for (unsigned int r = 0; r < 4; ++r)
+			{
+				basis->W[k][j]  += T[r]  * M[r][j];
+				basis->D1[k][j] += T1[r] * M[r][j];
+				basis->D2[k][j] += T2[r] * M[r][j];
+			}
+		}
+	}
+}
+
+
+
+/* Fill in the control points of pieces first to last of a spline through n points, as arrays of each component.
+ * Piece i runs from point i to point i + 1, under points i - 1 to i + 2, so X[c][0] is point first - 1. Beyond
+ * either end, the points continue in a straight line, in steps like the last.
+ */
+static void _spline_controls(vec4* coords, const unsigned int n, const unsigned int first, const unsigned int last, \
+                             float* const X[3])
+{
+	for (unsigned int j = first; j <= last + 3; ++j)    // Control j is point j - 1.
+		for (unsigned int c = 0; c < 3; ++c)
+		{
+			if (j == 0)
+				X[c][j - first] = 2 * coords[0][c] - coords[1][c];
+			else if (j <= n)
+				X[c][j - first] = coords[j - 1][c];
+			else
+				X[c][j - first] = (j - n + 1) * coords[n - 1][c] - (j - n) * coords[n - 2][c];
+		}
+}
+
+
+
+/* Evaluate a spline at step k of piece i, with X[c][i] its first control point, writing the point, and its centre
+ * of curvature, radius of curvature, and binormal. Where the spline is straight, the radius and binormal are left
+ * 0, for _spline_carry_normals() to fill in.
+ * Returns 1 if the spline is straight there, or 0 otherwise.
+ */
+static inline int __spline_point_scalar(const curve_basis_t* B, const float* const X[3], const unsigned int i, \
+                                        const unsigned int k, vec4 p, vec4 O, float* R, vec4 Z)
+{
+	// Sums are taken in the same order as in the lanes of _spline_evaluate(), so a point comes out the same
+	// whichever way it is found.
+	float P[3], D[3], E[3];
+	for (unsigned int c = 0; c < 3; ++c)
+	{
+		P[c] = (B->W[k][0]  * X[c][i] + B->W[k][1]  * X[c][i + 1]) + \
+		       (B->W[k][2]  * X[c][i + 2] + B->W[k][3]  * X[c][i + 3]);
+		D[c] = (B->D1[k][0] * X[c][i] + B->D1[k][1] * X[c][i + 1]) + \
+		       (B->D1[k][2] * X[c][i + 2] + B->D1[k][3] * X[c][i + 3]);
+		E[c] = (B->D2[k][0] * X[c][i] + B->D2[k][1] * X[c][i + 1]) + \
+		       (B->D2[k][2] * X[c][i + 2] + B->D2[k][3] * X[c][i + 3]);
+	}
+	const float bx = D[1] * E[2] - D[2] * E[1], by = D[2] * E[0] - D[0] * E[2], bz = D[0] * E[1] - D[1] * E[0];
+	const float b2 = bx * bx + by * by + bz * bz;
+	const float d2 = D[0] * D[0] + D[1] * D[1] + D[2] * D[2];
+	const float e2 = E[0] * E[0] + E[1] * E[1] + E[2] * E[2];
+	p[0] = P[0];
+	p[1] = P[1];
+	p[2] = P[2];
+	p[3] = 1.0;
+	if (b2 <= STARBOARD_CURVE_STRAIGHT * (d2 * e2) or b2 <= 0.0)
+	{
+		memcpy(O, p, sizeof(vec4));
+		*R = 0.0;
+		memset(Z, 0, sizeof(vec4));
+		return 1;
+	}
+	// The centre is P + |D|^2 (b x D) / |b|^2, and the radius |D|^3 / |b|, with b = D x E the binormal.
+	const float f = d2 / b2;
+	O[0] = P[0] + f * (by * D[2] - bz * D[1]);
+	O[1] = P[1] + f * (bz * D[0] - bx * D[2]);
+	O[2] = P[2] + f * (bx * D[1] - by * D[0]);
+	O[3] = 1.0;
+	*R   = sqrtf(d2 * f) * sqrtf(d2);
+	const float q = 1.0f / sqrtf(b2);
+	Z[0] = q * bx;
+	Z[1] = q * by;
+	Z[2] = q * bz;
+	Z[3] = 0.0;
+	return 0;
+}
+
+
+
+/* Evaluate pieces first to last of a spline through n points, every piece at each step from 0 up to (but not
+ * including) the next piece, and the last piece at its end too if it is the last of the spline. Step k of piece i
+ * is written to index i * pieces + k of p, O, R and Z. The controls start with those of the first piece.
+ * The steps of many pieces are found at once, as a product of the basis with the control points, lane by lane.
+ */
+static void _spline_evaluate(const curve_basis_t* B, const float* const X[3], const unsigned int n, \
+                             const unsigned int first, const unsigned int last, vec4* p, vec4* O, float* R, vec4* Z)
+{
+	const unsigned int s = B->pieces;
+	const unsigned int m = last - first + 1;
+	for (unsigned int k = 0; k < s; ++k)
+	{
+		unsigned int i = 0;
+		#ifdef ARCV_LANES
+		const arcv_t W0 = ARCV_SET1(B->W[k][0]),  W1 = ARCV_SET1(B->W[k][1]);
+		const arcv_t W2 = ARCV_SET1(B->W[k][2]),  W3 = ARCV_SET1(B->W[k][3]);
+		const arcv_t D0 = ARCV_SET1(B->D1[k][0]), D1 = ARCV_SET1(B->D1[k][1]);
+		const arcv_t D2 = ARCV_SET1(B->D1[k][2]), D3 = ARCV_SET1(B->D1[k][3]);
+		const arcv_t E0 = ARCV_SET1(B->D2[k][0]), E1 = ARCV_SET1(B->D2[k][1]);
+		const arcv_t E2 = ARCV_SET1(B->D2[k][2]), E3 = ARCV_SET1(B->D2[k][3]);
+		const arcv_t EPS = ARCV_SET1(STARBOARD_CURVE_STRAIGHT);
+		const arcv_t ONE = ARCV_SET1(1.0);
+		float        out[10][ARCV_LANES];
+		for (; i + ARCV_LANES <= m; i += ARCV_LANES)
+		{
+			arcv_t P[3], D[3], E[3];
+			for (unsigned int c = 0; c < 3; ++c)
+			{
+				const arcv_t X0 = ARCV_LOAD(X[c] + i),     X1 = ARCV_LOAD(X[c] + i + 1);
+				const arcv_t X2 = ARCV_LOAD(X[c] + i + 2), X3 = ARCV_LOAD(X[c] + i + 3);
+				P[c] = ARCV_ADD(ARCV_ADD(ARCV_MUL(W0, X0), ARCV_MUL(W1, X1)), ARCV_ADD(ARCV_MUL(W2, X2), ARCV_MUL(W3, X3)));
+				D[c] = ARCV_ADD(ARCV_ADD(ARCV_MUL(D0, X0), ARCV_MUL(D1, X1)), ARCV_ADD(ARCV_MUL(D2, X2), ARCV_MUL(D3, X3)));
+				E[c] = ARCV_ADD(ARCV_ADD(ARCV_MUL(E0, X0), ARCV_MUL(E1, X1)), ARCV_ADD(ARCV_MUL(E2, X2), ARCV_MUL(E3, X3)));
+			}
+			const arcv_t bx = ARCV_SUB(ARCV_MUL(D[1], E[2]), ARCV_MUL(D[2], E[1]));
+			const arcv_t by = ARCV_SUB(ARCV_MUL(D[2], E[0]), ARCV_MUL(D[0], E[2]));
+			const arcv_t bz = ARCV_SUB(ARCV_MUL(D[0], E[1]), ARCV_MUL(D[1], E[0]));
+			const arcv_t b2 = ARCV_ADD(ARCV_ADD(ARCV_MUL(bx, bx), ARCV_MUL(by, by)), ARCV_MUL(bz, bz));
+			const arcv_t d2 = ARCV_ADD(ARCV_ADD(ARCV_MUL(D[0], D[0]), ARCV_MUL(D[1], D[1])), ARCV_MUL(D[2], D[2]));
+			const arcv_t e2 = ARCV_ADD(ARCV_ADD(ARCV_MUL(E[0], E[0]), ARCV_MUL(E[1], E[1])), ARCV_MUL(E[2], E[2]));
+			const arcv_t f  = ARCV_DIV(d2, b2);
+			const arcv_t q  = ARCV_DIV(ONE, ARCV_SQRT(b2));
+			ARCV_STORE(out[0], P[0]);
+			ARCV_STORE(out[1], P[1]);
+			ARCV_STORE(out[2], P[2]);
+			ARCV_STORE(out[3], ARCV_ADD(P[0], ARCV_MUL(f, ARCV_SUB(ARCV_MUL(by, D[2]), ARCV_MUL(bz, D[1])))));
+			ARCV_STORE(out[4], ARCV_ADD(P[1], ARCV_MUL(f, ARCV_SUB(ARCV_MUL(bz, D[0]), ARCV_MUL(bx, D[2])))));
+			ARCV_STORE(out[5], ARCV_ADD(P[2], ARCV_MUL(f, ARCV_SUB(ARCV_MUL(bx, D[1]), ARCV_MUL(by, D[0])))));
+			ARCV_STORE(out[6], ARCV_MUL(ARCV_SQRT(ARCV_MUL(d2, f)), ARCV_SQRT(d2)));
+			ARCV_STORE(out[7], ARCV_MUL(q, bx));
+			ARCV_STORE(out[8], ARCV_MUL(q, by));
+			ARCV_STORE(out[9], ARCV_MUL(q, bz));
+			const int straight = ARCV_MOVEMASK(ARCV_LE(b2, ARCV_MUL(EPS, ARCV_MUL(d2, e2))));
+			
+			// Write the lanes out to the points they belong to, with straight lanes given no arc.
+			for (unsigned int l = 0; l < ARCV_LANES; ++l)
+			{
+				const unsigned int j = (first + i + l) * s + k;
+				p[j][0] = out[0][l];
+				p[j][1] = out[1][l];
+				p[j][2] = out[2][l];
+				p[j][3] = 1.0;
+				if ((straight >> l) & 1 or not (out[6][l] > 0.0))
+				{
+					memcpy(O[j], p[j], sizeof(vec4));
+					R[j] = 0.0;
+					memset(Z[j], 0, sizeof(vec4));
+					continue;
+				}
+				O[j][0] = out[3][l];
+				O[j][1] = out[4][l];
+				O[j][2] = out[5][l];
+				O[j][3] = 1.0;
+				R[j]    = out[6][l];
+				Z[j][0] = out[7][l];
+				Z[j][1] = out[8][l];
+				Z[j][2] = out[9][l];
+				Z[j][3] = 0.0;
+			}
+		}
+		#endif
+		for (; i < m; ++i)
+		{
+			const unsigned int j = (first + i) * s + k;
+			__spline_point_scalar(B, X, i, k, p[j], O[j], &R[j], Z[j]);
+		}
+	}
+	if (last == n - 1)
+	{
+		const unsigned int j = (last + 1) * s;
+		__spline_point_scalar(B, X, m - 1, s, p[j], O[j], &R[j], Z[j]);
+	}
+}
+
+
+
+/* Give the points from first to last where a spline is straight the binormal of the point before, so that the
+ * ribbon carries on flat through them rather than turning to a fixed direction; only if the spline is straight
+ * from its start do they fall back to +z. The points after last that took their binormal from one of these are
+ * updated too, and the last point that changed is returned.
+ */
+static unsigned int _spline_carry_normals(float* R, vec4* Z, const unsigned int first, const unsigned int last, \
+                                          const unsigned int len)
+{
+	static const vec4 UP = {0.0, 0.0, 1.0, 0.0};
+	unsigned int j = first;
+	for (; j < len and (j <= last or R[j] == 0.0); ++j)
+		if (R[j] == 0.0)
+			memcpy(Z[j], (j > 0) ? Z[j - 1] : UP, sizeof(vec4));
+	return j - 1;
+}
+
+
+
+/* Map n points to a curve along a spline through (Catmull-Rom) or near (B-spline) them, cutting the segment after
+ * each point into the quality settings' number of pieces. As with interpolate_arc_curve(), the last point is
+ * followed by a straight segment, so every point starts a residue of the ribbon, and the outputs are allocated
+ * from the arena, along with the first point of each segment (plus the last point). The arc parameters of each
+ * point are its centre and radius of curvature, and its binormal.
+ * Returns the number of points, or less than 0 on error.
+ */
+int interpolate_spline_curve(arena_t* arena, const curve_quality_t* quality, curve_engine_t engine, \
+                             vec4* coords, unsigned int count, \
+                             vec4** p_out, vec4** O_out, float** R_out, vec4** Z_out, unsigned int** offsets_out)
+{
+	if (count < 2)
+	{
+		printf("[WARNING] %s: %u.\n", "Too few points to interpolate a curve", count);
+		return -2;
+	}
+	curve_basis_t basis;
+	curve_spline_basis(engine, quality->pieces, &basis);
+	const unsigned int s         = basis.pieces;
+	const unsigned int count_new = count * s + 1;
+	
+	// Every segment has the same number of pieces, so the outputs can be allocated before the scratch space.
+	*offsets_out = (unsigned int*)arena_alloc(arena, (count + 1) * sizeof(unsigned int));
+	*p_out       = (vec4*) arena_alloc(arena, count_new * sizeof(vec4));
+	*O_out       = (vec4*) arena_alloc(arena, count_new * sizeof(vec4));
+	*R_out       = (float*)arena_alloc(arena, count_new * sizeof(float));
+	*Z_out       = (vec4*) arena_alloc(arena, count_new * sizeof(vec4));
+	if (*offsets_out == NULL or *p_out == NULL or *O_out == NULL or *R_out == NULL or *Z_out == NULL)
+		return -1;
+	for (unsigned int i = 0; i <= count; ++i)
+		(*offsets_out)[i] = i * s;
+	
+	const arena_mark_t mark   = arena_mark(arena);
+	float*             memory = (float*)arena_alloc(arena, 3 * (count + 3) * sizeof(float));
+	if (memory == NULL)
+		return -1;
+	float* const X[3] = {memory, memory + count + 3, memory + 2 * (count + 3)};
+	_spline_controls(coords, count, 0, count - 1, X);
+	_spline_evaluate(&basis, (const float* const*)X, count, 0, count - 1, *p_out, *O_out, *R_out, *Z_out);
+	_spline_carry_normals(*R_out, *Z_out, 0, count_new - 1, count_new);
+	arena_release(arena, mark);
 	return count_new;
 }
 
 
 
-/* TODO.
+/* Recompute the curve of a run of n points after points first to last of them have moved, as update_arc_curve()
+ * does, for a curve made by interpolate_spline_curve(). A piece of the spline depends on the points either side
+ * of it and one more each way, so the residues first - 2 to last + 1 change, along with the end of the one before
+ * them, and any after them that are straight and so take their binormal from before; the residues that changed
+ * are returned through from and to.
+ * Returns 0 on success, or less than 0 on error.
  */
-int curve_extract_residues(atom_t* alphas, unsigned int alphas_len, unsigned int** residues_out)
+int update_spline_curve(arena_t* arena, curve_engine_t engine, vec4* coords, unsigned int count, \
+                        const unsigned int* offsets, unsigned int first, unsigned int last, \
+                        vec4* p, vec4* O, float* R, vec4* Z, unsigned int* from, unsigned int* to)
 {
-	*residues_out = (unsigned int*)malloc(alphas_len * sizeof(unsigned int));
+	if (count < 2 or first > last or last >= count)
+		return -2;
+	curve_basis_t basis;
+	curve_spline_basis(engine, offsets[1] - offsets[0], &basis);
+	const unsigned int s = basis.pieces;
+	*from = (first > 1) ? first - 2 : 0;
+	*to   = (last + 1 < count) ? last + 1 : count - 1;
+	
+	const unsigned int m      = *to - *from + 1;
+	const arena_mark_t mark   = arena_mark(arena);
+	float*             memory = (float*)arena_alloc(arena, 3 * (m + 3) * sizeof(float));
+	if (memory == NULL)
+		return -1;
+	float* const X[3] = {memory, memory + m + 3, memory + 2 * (m + 3)};
+	_spline_controls(coords, count, *from, *to, X);
+	
+	// The outputs are indexed from the first point of the run.
+	p += offsets[0];
+	O += offsets[0];
+	R += offsets[0];
+	Z += offsets[0];
+	_spline_evaluate(&basis, (const float* const*)X, count, *from, *to, p, O, R, Z);
+	const unsigned int end = (*to == count - 1) ? count * s : (*to + 1) * s - 1;
+	const unsigned int j   = _spline_carry_normals(R, Z, *from * s, end, count * s + 1);
+	*to = (j / s < count) ? j / s : count - 1;
+	if (*from > 0)
+		--*from;    // The residue before ends on the first point that changed.
+	arena_release(arena, mark);
+	return 0;
+}
+
+
+
+/* Find the residue of each alpha carbon in the chain's residue index, so that a segment of the curve leads
+ * straight to the atoms of its residue.
+ */
+int curve_extract_residues(arena_t* arena, const chain_t* chain, unsigned int* alphas, unsigned int alphas_len, \
+                           unsigned int** residues_out)
+{
+	*residues_out = (unsigned int*)arena_alloc(arena, alphas_len * sizeof(unsigned int));
 	unsigned int* residues = *residues_out;
+	if (residues == NULL)
+		return -1;
 	
 	for (unsigned int i = 0; i < alphas_len; ++i)
-		residues[i] = alphas[i].res_id;
+		residues[i] = chain->residues.of_atom[alphas[i]];
 	return alphas_len;
 }
+
+
+
+/* Split the alpha carbons of a chain into the runs that the backbone joins, breaking wherever the chain changes
+ * or consecutive alpha carbons are too far apart to be bonded. Runs of a single alpha carbon are left out, as
+ * they have no curve. The segments, with where each starts in the curve's offsets, are allocated from the arena;
+ * where their points and vertices start is left for whoever builds them.
+ * Returns the number of segments, or less than 0 on error.
+ */
+int curve_split_segments(arena_t* arena, const chain_t* chain, const unsigned int* alphas, vec4* coords, \
+                         unsigned int alphas_len, curve_segment_t** segments_out)
+{
+	// Count the breaks first, so the segments can be allocated at their final size.
+	static const float BREAK2 = STARBOARD_CURVE_BREAK * STARBOARD_CURVE_BREAK;
+	const uint16_t*    chains = chain->cols.chains;
+	unsigned int       breaks = 0;
+	vec4               D;
+	for (unsigned int i = 1; i < alphas_len; ++i)
+	{
+		vec4_sub(D, coords[i], coords[i - 1]);
+		breaks += (chains[alphas[i]] != chains[alphas[i - 1]] or vec3_mul_inner(D, D) > BREAK2);
+	}
+	*segments_out = (curve_segment_t*)arena_alloc(arena, (breaks + 1) * sizeof(curve_segment_t));
+	curve_segment_t* segments = *segments_out;
+	if (segments == NULL)
+		return -1;
+	
+	unsigned int n       = 0;
+	unsigned int offsets = 0;
+	unsigned int first   = 0;
+	for (unsigned int i = 1; i <= alphas_len; ++i)
+	{
+		if (i < alphas_len)
+		{
+			vec4_sub(D, coords[i], coords[i - 1]);
+			if (chains[alphas[i]] == chains[alphas[i - 1]] and vec3_mul_inner(D, D) <= BREAK2)
+				continue;
+		}
+		if (i - first > 1)
+		{
+			memset(&segments[n], 0, sizeof(curve_segment_t));
+			segments[n].first   = first;
+			segments[n].len     = i - first;
+			segments[n].offsets = offsets;
+			offsets += i - first + 1;
+			++n;
+		}
+		first = i;
+	}
+	return n;
+}
@@ -1,4 +1,5 @@
 #include "pdb.h"
+#include "arena.h"
 
 #include "linmath/linmath.h"
 
@@ -6,44 +7,135 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <GL/glew.h>
-#include <GL/gl.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+
+
+/* A run of alpha carbons that the backbone joins without a break, and where its curve and ribbon are found in
+ * those of the whole chain.
+ */
+typedef struct curve_segment
+{
+	unsigned int first;          // First alpha carbon (and residue) of the segment.
+	unsigned int len;            // Number of alpha carbons.
+	unsigned int offsets;        // First of the segment's len + 1 entries in the curve's offsets.
+	unsigned int points;         // First point of the segment.
+	unsigned int points_len;
+	unsigned int vertices;       // First vertex of the segment's ribbon.
+	unsigned int vertices_len;
+} curve_segment_t;
 
 
 
 /* Describe a curve comprised of alpha carbon atoms which have had their positions interpolated
- * by finding circles that pass through successive triplets of points. 
+ * by finding circles that pass through successive triplets of points. The curve is broken wherever the chain
+ * is, and each piece is a segment.
  */
 typedef struct curve
 {
-	atom_t*      alphas;
-	unsigned int alphas_len;
+	unsigned int* alphas;        // Indices of the alpha carbons in the chain's columns.
+	unsigned int  alphas_len;
 	vec4*        alpha_coords;
 	
-	unsigned int* residues;
+	unsigned int* residues;      // Residue of each alpha carbon, in the chain's residue index.
 	unsigned int  residues_len;
 	
 	vec4*        points;
 	unsigned int points_len;
+	unsigned int* offsets;       // First point of each residue's piece of the curve, then the last point of its
+	                             // segment. The j-th residue of segment s spans points offsets[s.offsets + j]
+	                             // to offsets[s.offsets + j + 1], inclusive.
 	vec4*        arc_centres;
 	float*       arc_radii;
 	vec4*        z_normals;
+	
+	curve_segment_t* segments;   // Runs of at least two alpha carbons; one that is alone has no curve.
+	unsigned int     segments_len;
 } curve_t;
 
 
 
+#define STARBOARD_CURVE_QUALITY_MAX     8       // Quality levels run from 0 (fixed bisection) to this.
+#define STARBOARD_CURVE_PIECES_MAX      16      // The most pieces a spline segment can be cut into.
+
+
+
+/* How finely to subdivide the segment between consecutive alpha carbons. Each segment is split into enough
+ * pieces that none sweeps more than angle radians of its arc, within [min, max]; an angle of 0 always gives min.
+ */
+typedef struct curve_quality
+{
+	unsigned int min;
+	unsigned int max;
+	float        angle;
+	unsigned int pieces;    // Pieces per segment for the spline engines, which do not adapt.
+} curve_quality_t;
+
+
+
+/* The ways of drawing a smooth curve through the alpha carbons. The arc engine interpolates along the circle
+ * through each point and its neighbours; the spline engines evaluate a cubic over each four consecutive points.
+ * A Catmull-Rom spline passes through the alpha carbons, and a B-spline smooths them out, and passes near them.
+ */
+typedef enum curve_engine
+{
+	CURVE_ENGINE_ARC,
+	CURVE_ENGINE_CATMULL_ROM,
+	CURVE_ENGINE_B_SPLINE
+} curve_engine_t;
+
+
+
+/* The weights of the four control points of a spline, and of their first and second derivatives, at each step of
+ * a segment cut into a number of pieces, from t = 0 up to and including t = 1.
+ */
+typedef struct curve_basis
+{
+	unsigned int pieces;
+	float        W[STARBOARD_CURVE_PIECES_MAX + 1][4];
+	float        D1[STARBOARD_CURVE_PIECES_MAX + 1][4];
+	float        D2[STARBOARD_CURVE_PIECES_MAX + 1][4];
+} curve_basis_t;
+
+
+
 //
 // The goal of this module is a _very_ simple smooth arc representation of the protein backbone.
 //
 
+#define STARBOARD_CURVE_QUALITY_DEFAULT 2
+#define STARBOARD_CURVE_BREAK           4.2f    // Consecutive alpha carbons further apart (Å) are not bonded.
+
+extern curve_quality_t curve_quality_level(unsigned int);
+
 extern int three_points_arc(vec4, vec4, vec4, \
                             vec4*, float*, vec4*); 
 
+extern int three_points_arcs(const float* const[3], const unsigned int, \
+                             float* const[3], float*, float* const[3]);
+
 extern int bisect_arc(vec4, vec4, vec4, \
                       vec4*);
 
-extern int interpolate_arc_curve(vec4*, unsigned int, \
-                                 vec4**, vec4**, float**, vec4**);
+extern int interpolate_arc_curve(arena_t*, const curve_quality_t*, vec4*, unsigned int, \
+                                 vec4**, vec4**, float**, vec4**, unsigned int**);
+
+extern int update_arc_curve(arena_t*, vec4*, unsigned int, const unsigned int*, unsigned int, unsigned int, \
+                            vec4*, vec4*, float*, vec4*, unsigned int*, unsigned int*);
+
+extern void curve_spline_basis(curve_engine_t, unsigned int, curve_basis_t*);
+
+extern int interpolate_spline_curve(arena_t*, const curve_quality_t*, curve_engine_t, vec4*, unsigned int, \
+                                    vec4**, vec4**, float**, vec4**, unsigned int**);
+
+extern int update_spline_curve(arena_t*, curve_engine_t, vec4*, unsigned int, const unsigned int*, \
+                               unsigned int, unsigned int, vec4*, vec4*, float*, vec4*, unsigned int*, unsigned int*);
+
+extern int curve_extract_residues(arena_t*, const chain_t*, unsigned int*, unsigned int, unsigned int**);
 
-extern int curve_extract_residues(atom_t*, unsigned int, unsigned int**);
+extern int curve_split_segments(arena_t*, const chain_t*, const unsigned int*, vec4*, unsigned int, \
+                                curve_segment_t**);
 
@@ -0,0 +1,496 @@
+#include "dssp.h"
+
+
+
+/* The backbone of every residue that has one, in chain order, with what the search and the assignment share.
+ */
+typedef struct dssp_backbone
+{
+	unsigned int  len;
+	unsigned int* residues;          // Residue of each, in the chain's residue index.
+	vec4*         N;
+	vec4*         CA;
+	vec4*         C;
+	vec4*         O;
+	vec4*         H;
+	bool*         has_h;             // Whether the NH can donate; not the first of a run, nor a proline.
+	unsigned int* runs;              // The run of peptide-bonded residues each belongs to.
+	unsigned int (*acceptors)[2];    // The two strongest acceptors of each NH, or UINT_MAX if fewer bond.
+	float        (*energies)[2];
+	
+	float         origin[3];         // The grid of alpha carbons, as buckets of cells, with the residues sorted by
+	unsigned int  buckets_mask;      // bucket.
+	unsigned int* bucket_starts;
+	unsigned int* order;
+	vec4*         sorted;            // The alpha carbons in the same order, so a bucket is read in one sweep.
+} dssp_backbone_t;
+
+
+
+/* The types of bridge between two residues, as DSSP defines them.
+ */
+typedef enum dssp_bridge_type
+{
+	DSSP_BRIDGE_NONE,
+	DSSP_BRIDGE_PARALLEL,
+	DSSP_BRIDGE_ANTIPARALLEL
+} dssp_bridge_type_t;
+
+
+
+/* A bridge between residues i < j, and a run of consecutive bridges between two strands.
+ */
+typedef struct dssp_bridge
+{
+	unsigned int       i, j;
+	dssp_bridge_type_t type;
+	unsigned int       ladder;
+} dssp_bridge_t;
+
+typedef struct dssp_ladder
+{
+	dssp_bridge_type_t type;
+	unsigned int       i_first, i_last;
+	unsigned int       j_first, j_last;    // Partners of i_first and i_last; j runs down an antiparallel ladder.
+	unsigned int       bridges;
+	bool               linked;             // Joined to another ladder across a bulge.
+} dssp_ladder_t;
+
+
+
+/* Find the distance between the first three components of two points.
+ */
+static inline float __dssp_distance(const vec4 a, const vec4 b)
+{
+	const float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+	return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+
+
+/* Find the energy (kcal/mol) of the hydrogen bond from the NH of residue d to the C=O of residue a, with the
+ * charges and coupling constant of DSSP, i.e. 0.084 * 332 * (1/r(ON) + 1/r(CH) - 1/r(OH) - 1/r(CN)).
+ */
+static inline float __dssp_energy(const dssp_backbone_t* bb, const unsigned int d, const unsigned int a)
+{
+	static const float Q = -27.888, E_MIN = -9.9;
+	const float HO = __dssp_distance(bb->H[d], bb->O[a]);
+	const float HC = __dssp_distance(bb->H[d], bb->C[a]);
+	const float NC = __dssp_distance(bb->N[d], bb->C[a]);
+	const float NO = __dssp_distance(bb->N[d], bb->O[a]);
+	if (HO < 0.5 or HC < 0.5 or NC < 0.5 or NO < 0.5)
+		return E_MIN;
+	const float E = Q / HO - Q / HC + Q / NC - Q / NO;
+	return (E < E_MIN) ? E_MIN : E;
+}
+
+
+
+/* Find the cell of the grid that a point falls in, along each axis. Cells are as wide as the cutoff, so the alpha
+ * carbons that can bond to one in a cell are all in that cell or the 26 around it.
+ */
+static inline void __dssp_cell(const dssp_backbone_t* bb, const vec4 p, unsigned int cell[3])
+{
+	for (unsigned int k = 0; k < 3; ++k)
+		cell[k] = (unsigned int)((p[k] - bb->origin[k]) / STARBOARD_DSSP_CA_CUTOFF) + 1;
+}
+
+
+
+/* Find the bucket that a cell is hashed to. Only the cells that hold alpha carbons take up room, however spread out
+ * the structure is; cells that share a bucket are told apart by distance.
+ */
+static inline unsigned int __dssp_bucket(const dssp_backbone_t* bb, const unsigned int x, const unsigned int y, \
+                                         const unsigned int z)
+{
+	return ((x * 73856093u) ^ (y * 19349663u) ^ (z * 83492791u)) & bb->buckets_mask;
+}
+
+
+
+/* Find the strongest two acceptors of the NH of each donor in one block, among the residues in the cells next to
+ * its own. Donors are taken in the order of their buckets, so that those in a block search the same few buckets.
+ * This is a task of the thread pool, and writes only to the entries of its own donors.
+ */
+static void _dssp_search(void* context, unsigned int block, unsigned int thread)
+{
+	(void)thread;
+	dssp_backbone_t*   bb      = (dssp_backbone_t*)context;
+	const float        CUTOFF2 = STARBOARD_DSSP_CA_CUTOFF * STARBOARD_DSSP_CA_CUTOFF;
+	const unsigned int first   = block * STARBOARD_DSSP_BLOCK;
+	const unsigned int last    = (first + STARBOARD_DSSP_BLOCK < bb->len) ? first + STARBOARD_DSSP_BLOCK : bb->len;
+	for (unsigned int o = first; o < last; ++o)
+	{
+		const unsigned int d         = bb->order[o];
+		unsigned int*      acceptors = bb->acceptors[d];
+		float*             energies  = bb->energies[d];
+		acceptors[0] = acceptors[1] = UINT_MAX;
+		energies[0]  = energies[1]  = 0.0;
+		if (not bb->has_h[d])
+			continue;
+		// Visit the buckets of the 27 cells around the donor's. Two cells can share a bucket, so an acceptor can
+		// come up twice, but is only kept once.
+		unsigned int c[3], buckets[27];
+		__dssp_cell(bb, bb->CA[d], c);
+		for (unsigned int k = 0; k < 27; ++k)
+			buckets[k] = __dssp_bucket(bb, c[0] + k % 3 - 1, c[1] + k / 3 % 3 - 1, c[2] + k / 9 - 1);
+		const float x = bb->CA[d][0], y = bb->CA[d][1], z = bb->CA[d][2];
+		for (unsigned int b = 0; b < 27; ++b)
+		{
+			const unsigned int end = bb->bucket_starts[buckets[b] + 1];
+			for (unsigned int n = bb->bucket_starts[buckets[b]]; n < end; ++n)
+			{
+				const float dx = bb->sorted[n][0] - x, dy = bb->sorted[n][1] - y, dz = bb->sorted[n][2] - z;
+				if (dx * dx + dy * dy + dz * dz >= CUTOFF2)
+					continue;
+				
+				// The C=O of the residue just before shares a peptide with the NH, so is never counted.
+				const unsigned int a = bb->order[n];
+				if (a == d or a + 1 == d)
+					continue;
+				const float E = __dssp_energy(bb, d, a);
+				if (E >= STARBOARD_DSSP_HBOND_MAX or E >= energies[1] or a == acceptors[0] or a == acceptors[1])
+					continue;
+				if (E < energies[0])
+				{
+					acceptors[1] = acceptors[0];
+					energies[1]  = energies[0];
+					acceptors[0] = a;
+					energies[0]  = E;
+				}
+				else
+				{
+					acceptors[1] = a;
+					energies[1]  = E;
+				}
+			}
+		}
+	}
+}
+
+
+
+/* Find whether the C=O of residue a is hydrogen bonded to the NH of residue d.
+ */
+static inline bool __dssp_hbond(const dssp_backbone_t* bb, const unsigned int a, const unsigned int d)
+{
+	return d < bb->len and (bb->acceptors[d][0] == a or bb->acceptors[d][1] == a);
+}
+
+
+
+/* Find whether residues i and j form a bridge, and of which type. Both need a neighbour either side in their own
+ * run, and they must be at least three apart.
+ */
+static dssp_bridge_type_t _dssp_bridge(const dssp_backbone_t* bb, const unsigned int i, const unsigned int j)
+{
+	if (i < 1 or j < i + 3 or j >= bb->len - 1 or \
+	    bb->runs[i - 1] != bb->runs[i + 1] or bb->runs[j - 1] != bb->runs[j + 1])
+		return DSSP_BRIDGE_NONE;
+	if ((__dssp_hbond(bb, i - 1, j) and __dssp_hbond(bb, j, i + 1)) or \
+	    (__dssp_hbond(bb, j - 1, i) and __dssp_hbond(bb, i, j + 1)))
+		return DSSP_BRIDGE_PARALLEL;
+	if ((__dssp_hbond(bb, i, j) and __dssp_hbond(bb, j, i)) or \
+	    (__dssp_hbond(bb, i - 1, j + 1) and __dssp_hbond(bb, j - 1, i + 1)))
+		return DSSP_BRIDGE_ANTIPARALLEL;
+	return DSSP_BRIDGE_NONE;
+}
+
+
+
+/* Order bridges by their first residue, then their second.
+ */
+static int _dssp_compare_bridges(const void* a, const void* b)
+{
+	const dssp_bridge_t* x = (const dssp_bridge_t*)a;
+	const dssp_bridge_t* y = (const dssp_bridge_t*)b;
+	if (x->i != y->i)
+		return (x->i < y->i) ? -1 : 1;
+	return (x->j < y->j) ? -1 : ((x->j > y->j) ? 1 : 0);
+}
+
+
+
+/* Set the class of residue k, unless it already has one of higher priority.
+ */
+static inline void __dssp_set(char* ss, const unsigned int k, const char c)
+{
+	static const char PRIORITY[] = " STIGBEH";    // Lowest first, i.e. H, E, B, G, I, T, S as in dssp.h.
+	if (strchr(PRIORITY, c) > strchr(PRIORITY, ss[k]))
+		ss[k] = c;
+}
+
+
+
+/* Class every residue of the backbone from its hydrogen bonds and the angles of its alpha carbons.
+ * Returns 0 on success, or -1 if out of memory.
+ */
+static int _dssp_classify(arena_t* arena, const dssp_backbone_t* bb, char* ss)
+{
+	const unsigned int m = bb->len;
+	memset(ss, ' ', m);
+	
+	// A bend is where the alpha carbons two either side turn through more than 70 degrees.
+	const float COS_BEND = cosf(70.0 * M_PI / 180.0);
+	for (unsigned int k = 2; k + 2 < m; ++k)
+	{
+		if (bb->runs[k - 2] != bb->runs[k + 2])
+			continue;
+		vec4 u, v;
+		vec4_sub(u, bb->CA[k], bb->CA[k - 2]);
+		vec4_sub(v, bb->CA[k + 2], bb->CA[k]);
+		const float uv = u[0] * v[0] + u[1] * v[1] + u[2] * v[2];
+		const float uu = u[0] * u[0] + u[1] * u[1] + u[2] * u[2];
+		const float vv = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+		if (uv < COS_BEND * sqrtf(uu * vv))
+			__dssp_set(ss, k, 'S');
+	}
+	
+	// An n-turn at k is a bond from the C=O of k to the NH of k + n; two in a row make a helix.
+	static const unsigned int TURNS[3]   = {3, 4, 5};
+	static const char         HELICES[3] = {'G', 'H', 'I'};
+	uint8_t* turns = (uint8_t*)arena_alloc(arena, m * sizeof(uint8_t));
+	if (turns == NULL)
+		return -1;
+	for (unsigned int k = 0; k < m; ++k)
+	{
+		turns[k] = 0;
+		for (unsigned int t = 0; t < 3; ++t)
+			if (k + TURNS[t] < m and bb->runs[k] == bb->runs[k + TURNS[t]] and __dssp_hbond(bb, k, k + TURNS[t]))
+			{
+				turns[k] |= 1 << t;
+				for (unsigned int n = 1; n < TURNS[t]; ++n)
+					__dssp_set(ss, k + n, 'T');
+			}
+	}
+	for (unsigned int k = 1; k < m; ++k)
+		for (unsigned int t = 0; t < 3; ++t)
+			if ((turns[k - 1] >> t) & (turns[k] >> t) & 1)
+				for (unsigned int n = 0; n < TURNS[t]; ++n)
+					__dssp_set(ss, k + n, HELICES[t]);
+	
+	// Every bridge includes a bond from (or to) one of its residues, or a neighbour, so it is found from the bond.
+	dssp_bridge_t* bridges     = (dssp_bridge_t*)arena_alloc(arena, 8 * (size_t)m * sizeof(dssp_bridge_t));
+	unsigned int   bridges_len = 0;
+	if (bridges == NULL)
+		return -1;
+	for (unsigned int d = 0; d < m; ++d)
+		for (unsigned int h = 0; h < 2 and bb->acceptors[d][h] != UINT_MAX; ++h)
+		{
+			const unsigned int a = bb->acceptors[d][h];
+			const unsigned int candidates[4][2] = {{a + 1, d}, {a, d - 1}, {a, d}, {a + 1, d - 1}};
+			for (unsigned int c = 0; c < 4; ++c)
+			{
+				const unsigned int i = (candidates[c][0] < candidates[c][1]) ? candidates[c][0] : candidates[c][1];
+				const unsigned int j = (candidates[c][0] < candidates[c][1]) ? candidates[c][1] : candidates[c][0];
+				const dssp_bridge_type_t type = _dssp_bridge(bb, i, j);
+				if (type != DSSP_BRIDGE_NONE)
+					bridges[bridges_len++] = (dssp_bridge_t){i, j, type, 0};
+			}
+		}
+	qsort(bridges, bridges_len, sizeof(dssp_bridge_t), _dssp_compare_bridges);
+	
+	// A bridge carries on the ladder of a bridge of the same type one residue back on both strands.
+	dssp_ladder_t* ladders     = (dssp_ladder_t*)arena_alloc(arena, (bridges_len + 1) * sizeof(dssp_ladder_t));
+	unsigned int   ladders_len = 0;
+	if (ladders == NULL)
+		return -1;
+	unsigned int unique = 0;
+	for (unsigned int x = 0; x < bridges_len; ++x)
+	{
+		if (unique > 0 and bridges[x].i == bridges[unique - 1].i and bridges[x].j == bridges[unique - 1].j)
+			continue;
+		dssp_bridge_t* b = &bridges[unique++];
+		*b = bridges[x];
+		const unsigned int j_before = (b->type == DSSP_BRIDGE_PARALLEL) ? b->j - 1 : b->j + 1;
+		bool               found    = false;
+		unsigned int       y        = unique - 1;
+		while (not found and y > 0 and bridges[y - 1].i + 1 >= b->i)
+		{
+			--y;
+			found = bridges[y].i + 1 == b->i and bridges[y].j == j_before and bridges[y].type == b->type;
+		}
+		if (found)
+		{
+			dssp_ladder_t* L = &ladders[bridges[y].ladder];
+			b->ladder  = bridges[y].ladder;
+			L->i_last  = b->i;
+			L->j_last  = b->j;
+			L->bridges += 1;
+		}
+		else
+		{
+			b->ladder = ladders_len;
+			ladders[ladders_len++] = (dssp_ladder_t){b->type, b->i, b->i, b->j, b->j, 1, false};
+		}
+	}
+	
+	// Ladders of the same type are joined across a bulge of at most one residue on one strand and four on the
+	// other. Ladders start in order of their first residue, so only the next few can join.
+	for (unsigned int x = 0; x < ladders_len; ++x)
+		for (unsigned int y = x + 1; y < ladders_len and ladders[y].i_first <= ladders[x].i_last + 5; ++y)
+		{
+			dssp_ladder_t* L1 = &ladders[x];
+			dssp_ladder_t* L2 = &ladders[y];
+			if (L1->type != L2->type or L2->i_first <= L1->i_last)
+				continue;
+			const int gap_i = (int)L2->i_first - (int)L1->i_last - 1;
+			const int gap_j = (L1->type == DSSP_BRIDGE_PARALLEL) ? (int)L2->j_first - (int)L1->j_last - 1 : \
+			                                                       (int)L1->j_last - (int)L2->j_first - 1;
+			if (gap_j < 0 or not ((gap_i <= 1 and gap_j <= 4) or (gap_i <= 4 and gap_j <= 1)))
+				continue;
+			L1->linked = L2->linked = true;
+			const unsigned int j_low  = (L1->j_last < L2->j_first) ? L1->j_last : L2->j_first;
+			const unsigned int j_high = (L1->j_last < L2->j_first) ? L2->j_first : L1->j_last;
+			for (unsigned int k = L1->i_last; k <= L2->i_first; ++k)
+				__dssp_set(ss, k, 'E');
+			for (unsigned int k = j_low; k <= j_high; ++k)
+				__dssp_set(ss, k, 'E');
+		}
+	
+	// A ladder of two or more bridges, or one joined to another, is a pair of strands; a lone bridge is B.
+	for (unsigned int x = 0; x < unique; ++x)
+	{
+		const dssp_ladder_t* L = &ladders[bridges[x].ladder];
+		const char           c = (L->bridges > 1 or L->linked) ? 'E' : 'B';
+		__dssp_set(ss, bridges[x].i, c);
+		__dssp_set(ss, bridges[x].j, c);
+	}
+	return 0;
+}
+
+
+
+/* Assign the secondary structure of every residue of a chain, as a DSSP class per residue written to out, which
+ * has room for one per residue and a terminator. The hydrogen bond search runs across the pool, and its scratch
+ * space is taken from the arena and given back.
+ * Returns the number of residues with a whole backbone, or less than 0 on error.
+ */
+int dssp_assign(pool_t* pool, arena_t* arena, const chain_t* chain, char* out)
+{
+	const residues_t* res = &chain->residues;
+	memset(out, ' ', res->len);
+	out[res->len] = '\0';
+	
+	const arena_mark_t mark = arena_mark(arena);
+	dssp_backbone_t    bb;
+	bb.residues  = (unsigned int*)arena_alloc(arena, res->len * sizeof(unsigned int));
+	bb.N         = (vec4*)arena_alloc(arena, res->len * sizeof(vec4));
+	bb.CA        = (vec4*)arena_alloc(arena, res->len * sizeof(vec4));
+	bb.C         = (vec4*)arena_alloc(arena, res->len * sizeof(vec4));
+	bb.O         = (vec4*)arena_alloc(arena, res->len * sizeof(vec4));
+	bb.H         = (vec4*)arena_alloc(arena, res->len * sizeof(vec4));
+	bb.has_h     = (bool*)arena_alloc(arena, res->len * sizeof(bool));
+	bb.runs      = (unsigned int*)arena_alloc(arena, res->len * sizeof(unsigned int));
+	bb.acceptors = (unsigned int(*)[2])arena_alloc(arena, res->len * sizeof(unsigned int[2]));
+	bb.energies  = (float(*)[2])arena_alloc(arena, res->len * sizeof(float[2]));
+	if (bb.residues == NULL or bb.N == NULL or bb.CA == NULL or bb.C == NULL or bb.O == NULL or bb.H == NULL or \
+	    bb.has_h == NULL or bb.runs == NULL or bb.acceptors == NULL or bb.energies == NULL)
+	{
+		arena_release(arena, mark);
+		return -1;
+	}
+	
+	// Find the residues that have a whole backbone, then gather the coordinates of each of its atoms at once.
+	const uint32_t KEYS[4]  = {atom_name_key("N"), atom_name_key("CA"), atom_name_key("C"), atom_name_key("O")};
+	vec4* const    ATOMS[4] = {bb.N, bb.CA, bb.C, bb.O};
+	unsigned int*  atoms    = (unsigned int*)arena_alloc(arena, 4 * res->len * sizeof(unsigned int)); // By atom, then
+	if (atoms == NULL)                                                                                  // residue.
+	{
+		arena_release(arena, mark);
+		return -1;
+	}
+	bb.len = 0;
+	for (unsigned int r = 0; r < res->len; ++r)
+	{
+		unsigned int found = 0;
+		for (unsigned int k = 0; k < 4; ++k)
+		{
+			const int e = residue_find_atom(chain, r, KEYS[k]);
+			atoms[k * res->len + bb.len] = (e >= 0) ? (unsigned int)e : 0;
+			found += (e >= 0) ? 1 : 0;
+		}
+		if (found == 4)
+			bb.residues[bb.len++] = r;
+	}
+	for (unsigned int k = 0; k < 4; ++k)
+		chain_gather_vec4s(ATOMS[k], chain, &atoms[k * res->len], bb.len);
+	
+	// Break runs wherever the peptide bond is missing.
+	for (unsigned int m = 0; m < bb.len; ++m)
+	{
+		const unsigned int n      = atoms[m];    // The nitrogen.
+		const bool         bonded = m > 0 and __dssp_distance(bb.C[m - 1], bb.N[m]) <= STARBOARD_DSSP_PEPTIDE and \
+		                            chain->cols.chains[n] == chain->cols.chains[res->starts[bb.residues[m - 1]]];
+		bb.runs[m]  = (m == 0) ? 0 : bb.runs[m - 1] + (bonded ? 0 : 1);
+		bb.has_h[m] = bonded and strncmp(chain->cols.res_name_table[chain->cols.res_names[n]], "PRO", 4) != 0;
+		
+		// The hydrogen sits 1 Å from the nitrogen, along the C=O of the residue before.
+		if (bb.has_h[m])
+		{
+			vec4 CO;
+			vec4_sub(CO, bb.C[m - 1], bb.O[m - 1]);
+			vec4_scale(CO, CO, 1.0 / __dssp_distance(bb.C[m - 1], bb.O[m - 1]));
+			vec4_add(bb.H[m], bb.N[m], CO);
+		}
+		else
+			memcpy(bb.H[m], bb.N[m], sizeof(vec4));
+	}
+	if (bb.len == 0)
+	{
+		arena_release(arena, mark);
+		return 0;
+	}
+	
+	// Bin the alpha carbons into cells, hashed into at least twice as many buckets as there are residues.
+	for (unsigned int k = 0; k < 3; ++k)
+		bb.origin[k] = bb.CA[0][k];
+	for (unsigned int m = 1; m < bb.len; ++m)
+		for (unsigned int k = 0; k < 3; ++k)
+			bb.origin[k] = (bb.CA[m][k] < bb.origin[k]) ? bb.CA[m][k] : bb.origin[k];
+	unsigned int buckets = 1;
+	while (buckets < 2 * bb.len)
+		buckets *= 2;
+	bb.buckets_mask  = buckets - 1;
+	bb.bucket_starts = (unsigned int*)arena_alloc(arena, (buckets + 1) * sizeof(unsigned int));
+	bb.order         = (unsigned int*)arena_alloc(arena, bb.len * sizeof(unsigned int));
+	bb.sorted        = (vec4*)arena_alloc(arena, bb.len * sizeof(vec4));
+	unsigned int* bucket_of = (unsigned int*)arena_alloc(arena, bb.len * sizeof(unsigned int));
+	if (bb.bucket_starts == NULL or bb.order == NULL or bb.sorted == NULL or bucket_of == NULL)
+	{
+		arena_release(arena, mark);
+		return -1;
+	}
+	memset(bb.bucket_starts, 0, (buckets + 1) * sizeof(unsigned int));
+	for (unsigned int m = 0; m < bb.len; ++m)
+	{
+		unsigned int c[3];
+		__dssp_cell(&bb, bb.CA[m], c);
+		bucket_of[m] = __dssp_bucket(&bb, c[0], c[1], c[2]);
+		++bb.bucket_starts[bucket_of[m] + 1];
+	}
+	for (unsigned int b = 0; b < buckets; ++b)
+		bb.bucket_starts[b + 1] += bb.bucket_starts[b];
+	for (unsigned int m = 0; m < bb.len; ++m)
+	{
+		memcpy(bb.sorted[bb.bucket_starts[bucket_of[m]]], bb.CA[m], sizeof(vec4));
+		bb.order[bb.bucket_starts[bucket_of[m]]++] = m;
+	}
+	for (unsigned int b = buckets; b > 0; --b)    // Each start was moved on to the next bucket's while filling it.
+		bb.bucket_starts[b] = bb.bucket_starts[b - 1];
+	bb.bucket_starts[0] = 0;
+	
+	// Find the hydrogen bonds, a block of donors at a time, then class the residues.
+	pool_for(pool, (bb.len + STARBOARD_DSSP_BLOCK - 1) / STARBOARD_DSSP_BLOCK, _dssp_search, &bb);
+	char* ss = (char*)arena_alloc(arena, bb.len * sizeof(char));
+	if (ss == NULL or _dssp_classify(arena, &bb, ss) < 0)
+	{
+		arena_release(arena, mark);
+		return -1;
+	}
+	for (unsigned int m = 0; m < bb.len; ++m)
+		out[bb.residues[m]] = ss[m];
+	const int len = bb.len;
+	arena_release(arena, mark);
+	return len;
+}
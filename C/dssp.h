@@ -0,0 +1,39 @@
+#ifndef STARBOARD_DSSP
+#define STARBOARD_DSSP
+
+#include "pdb.h"
+#include "arena.h"
+#include "pool.h"
+
+#include <iso646.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+
+//
+// Secondary structure from the backbone atoms alone, after Kabsch & Sander's DSSP. Every residue with N, CA, C and
+// O atoms is a candidate; the hydrogen of its NH is placed along the C=O of the residue before it, and a hydrogen
+// bond is any donor-acceptor pair with an electrostatic energy below -0.5 kcal/mol. Pairs are only tried between
+// residues whose alpha carbons are close, which are found through a grid of cells, so the search grows with the
+// number of residues rather than its square. The search is split into blocks of donors across a thread pool.
+//
+// Residues are then classed, in order of priority, as H (alpha helix), E (strand in a ladder), B (isolated bridge),
+// G (3-10 helix), I (pi helix), T (hydrogen-bonded turn) or S (bend), or ' ' if none of these, which is also what
+// residues without a whole backbone get. As in mkdssp, a residue of a strand stays E even if it also has a lone
+// bridge with another strand.
+//
+
+#define STARBOARD_DSSP_CA_CUTOFF  9.0f      // Alpha carbons further apart (Å) cannot hydrogen bond.
+#define STARBOARD_DSSP_HBOND_MAX  -0.5f     // The highest energy (kcal/mol) that still counts as a bond.
+#define STARBOARD_DSSP_PEPTIDE    2.5f      // C to N distances (Å) above this break the chain.
+#define STARBOARD_DSSP_BLOCK      1024      // Donors searched by each task of the thread pool.
+
+
+
+extern int dssp_assign(pool_t*, arena_t*, const chain_t*, char*);
+
+#endif
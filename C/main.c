@@ -1,9 +1,13 @@
 #include "input.h"
 #include "commands.h"
 #include "pdb.h"
+#include "models.h"
+#include "select.h"
 #include "curve.h"
 #include "ribbon.h"
 #include "colorwheel.h"
+#include "pool.h"
+#include "dssp.h"
 #include "engine.h"
 #include "shader.h"
 #include "render.h"
@@ -38,8 +42,32 @@ GLFWwindow* create_window(const char*, const GLuint, const GLuint, const float);
 // User interaction via the terminal.
 //
 
+int do_assembly_command(params_t*);
+int do_color_command(params_t*);
+int do_curve_command(params_t*);
+int do_delete_command(params_t*);
+int do_extrude_command(params_t*);
+int do_hide_command(params_t*);
+int do_highlight_command(params_t*);
 int do_load_command2(params_t*);
+int do_model_command(params_t*);
+int do_move_command(params_t*);
+int do_quality_command(params_t*);
+int do_select_command(params_t*);
+int do_show_command(params_t*);
+int do_spectrum_command(params_t*);
 int do_status_command(params_t*);
+void build_monoview_geometry(arena_t*, const chain_t*, curve_engine_t, bool, curve_t*, ribbon2_t*);
+void rebuild_monoview(unsigned int);
+void assign_monoview_structure(monoview_t*);
+int update_monoview_geometry(unsigned int, unsigned int, unsigned int, bool, bool);
+
+// How finely curves are subdivided, set with the `quality` command.
+curve_quality_t CurveQuality;
+
+// Threads that build geometry, and a scratch arena for each of them.
+pool_t   ThreadPool;
+arena_t* ThreadArenas;
 
 
 // User interaction in 3D.
@@ -85,6 +113,13 @@ int main(int argc, char** argv)
 	params_t  NO_PARAMS = {.argc = 0, .argv = NULL}; 
 	params_t  args;
 	memcpy(&args, &NO_PARAMS, sizeof(params_t));
+	CurveQuality = curve_quality_level(STARBOARD_CURVE_QUALITY_DEFAULT);
+	if (pool_init(&ThreadPool, 0) < 0)
+		printf("[WARNING] %s: %u.\n", "Could not start every thread of the pool; threads working", \
+		       pool_threads(&ThreadPool));
+	ThreadArenas = (arena_t*)malloc(pool_threads(&ThreadPool) * sizeof(arena_t)); // malloc ThreadArenas
+	for (unsigned int i = 0; i < pool_threads(&ThreadPool); ++i)
+		arena_init(&ThreadArenas[i], 0);
 	
 	
 	// Rendering & event handling.
@@ -101,6 +136,32 @@ int main(int argc, char** argv)
 		return -2;
 	}
 	engine_use_shader(main_shader);
+	MonoviewShader = main_shader;
+	e = shader_program_create_geometry("GL/ribbon.vert", "GL/ribbon.geom", "GL/main.frag", \
+	                                   &MonoviewExtrusionShaders[0]);
+	if (e >= 0)
+		e = shader_program_create_geometry("GL/ribbon.vert", "GL/outline.geom", "GL/main.frag", \
+		                                   &MonoviewExtrusionShaders[1]);
+	if (e < 0)
+	{
+		printf("[FATAL] %s: %i.\n", "Call to shader_program_create_geometry() failed with code", e);
+		return -2;
+	}
+	
+	// Every shader looks the colours of residues up in texture unit 0, their attributes in unit 1, and colour maps
+	// in unit 2, which keeps the same maps throughout (see shader.h).
+	GLubyte colormap_texels[4 * STARBOARD_COLORMAP_TEXELS * (COLORMAP_LEN - 1)];
+	generate_colormaps(colormap_texels);
+	GLuint colormaps;
+	buffer_colormaps(colormap_texels, STARBOARD_COLORMAP_TEXELS, COLORMAP_LEN - 1, &colormaps);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_1D_ARRAY, colormaps);
+	glActiveTexture(GL_TEXTURE0);
+	
+	// Ribbons draw all of their segments at once, as strips with a restart index between them. The index is set
+	// again for each draw whose indices are narrower (see draw_object()).
+	glEnable(GL_PRIMITIVE_RESTART);
+	glPrimitiveRestartIndex(STARBOARD_RIBBON_RESTART);
 	
 	// Define the camera matrix, but it will be updated later.
 	vec3_mul_cross(CameraUp, CameraDirection, RIGHT);
@@ -108,6 +169,9 @@ int main(int argc, char** argv)
 	mat4x4  cameramat;
 	vec3    camera_towards;
 	GLfloat cameracmp[16];
+	vec3_add(camera_towards, CameraPosition, (float*)CameraDirection);
+	mat4x4_look_at(cameramat, CameraPosition, camera_towards, (float*)CameraUp);
+	mat4x4_to_GLfloat16(cameramat, cameracmp);
 	
 	// Create the perspective projection transformation.
 	mat4x4 perspectivemat; 
@@ -115,6 +179,18 @@ int main(int argc, char** argv)
 	GLfloat perspectivecmp[16];
 	mat4x4_to_GLfloat16(perspectivemat, perspectivecmp);
 	
+	// Every shader reads both from the same uniform buffer, whose view is uploaded again only when the camera moves.
+	GLuint camera_ubo;
+	buffer_camera(perspectivecmp, cameracmp, STARBOARD_SHADER_CAMERA_BINDING, &camera_ubo);
+	GLfloat camera_uploaded[16];
+	memcpy(camera_uploaded, cameracmp, sizeof(cameracmp));
+	
+	// Objects are culled against the frustum of both together, which is found again when the camera moves.
+	mat4x4  viewprojmat;
+	GLfloat viewprojcmp[16];
+	mat4x4_mul(viewprojmat, perspectivemat, cameramat);
+	mat4x4_to_GLfloat16(viewprojmat, viewprojcmp);
+	
 	// Create the framebuffer that we will render to.
 	engine_initialize();
 	framebuffer_t framebuffer;
@@ -125,8 +201,9 @@ int main(int argc, char** argv)
 		return -3;
 	}
 	
-	// Create the list of objects to render.
+	// Create the list of objects to render, and the buffers that their geometry shares.
 	initialize_objects();
+	monoview_initialize();
 	
 	
 	
@@ -145,14 +222,8 @@ int main(int argc, char** argv)
 		// Actual rendering code.
 		//
 		
-		// We need to send the perspective and camera matrices to the shader. 
-		GLint perspectiveloc = glGetUniformLocation(Shader, "projection");
-		glUniformMatrix4fv(perspectiveloc, 1, GL_FALSE, perspectivecmp);
-		GLint cameraloc = glGetUniformLocation(Shader, "view");
-		glUniformMatrix4fv(cameraloc, 1, GL_FALSE, cameracmp);
-		
 		// Draw all of the renderable objects in the object list.
-		draw_all_objects();
+		draw_all_objects(viewprojcmp);
 		
 		
 		// Command input.
@@ -164,10 +235,62 @@ int main(int argc, char** argv)
 		
 		switch (cmd)
 		{
+			// Parse the command to show the biological assembly of a structure, or only its chain.
+			case COMMAND_ASSEMBLY: do_assembly_command(&args);
+			break;
+			
+			// Parse the command to colour the selected residues of a structure.
+			case COMMAND_COLOR: do_color_command(&args);
+			break;
+			
+			// Parse the command to choose how the backbone of a structure is curved.
+			case COMMAND_CURVE: do_curve_command(&args);
+			break;
+			
+			// Parse the command to delete a structure and free what it holds.
+			case COMMAND_DELETE: do_delete_command(&args);
+			break;
+			
+			// Parse the command to choose whether a shader extrudes the ribbon of a structure, and how finely.
+			case COMMAND_EXTRUDE: do_extrude_command(&args);
+			break;
+			
+			// Parse the command to hide the selected residues of a structure.
+			case COMMAND_HIDE: do_hide_command(&args);
+			break;
+			
+			// Parse the command to highlight the selected residues of a structure.
+			case COMMAND_HIGHLIGHT: do_highlight_command(&args);
+			break;
+			
 			// Parse the command to load a monomer structure as a ribbon.
 			case COMMAND_LOAD: do_load_command2(&args);
 			break;
 			
+			// Parse the command to show another model of a loaded ensemble.
+			case COMMAND_MODEL: do_model_command(&args);
+			break;
+			
+			// Parse the command to move the selected atoms of a structure.
+			case COMMAND_MOVE: do_move_command(&args);
+			break;
+			
+			// Parse the command to set how finely ribbons are subdivided.
+			case COMMAND_QUALITY: do_quality_command(&args);
+			break;
+			
+			// Parse the command to select atoms of a loaded structure.
+			case COMMAND_SELECT: do_select_command(&args);
+			break;
+			
+			// Parse the command to show the selected residues of a structure again.
+			case COMMAND_SHOW: do_show_command(&args);
+			break;
+			
+			// Parse the command to colour the selected residues of a structure along a colour map.
+			case COMMAND_SPECTRUM: do_spectrum_command(&args);
+			break;
+			
 			// Parse the command to print status information about which models are currently loaded.
 			case COMMAND_STATUS: do_status_command(&args);
 			break;
@@ -188,6 +311,13 @@ int main(int argc, char** argv)
 		vec3_add(camera_towards, CameraPosition, (float*)CameraDirection);
 		mat4x4_look_at(cameramat, CameraPosition, camera_towards, (float*)CameraUp);
 		mat4x4_to_GLfloat16(cameramat, cameracmp);
+		if (memcmp(cameracmp, camera_uploaded, sizeof(cameracmp)) != 0)
+		{
+			rebuffer_camera_view(camera_ubo, cameracmp);
+			memcpy(camera_uploaded, cameracmp, sizeof(cameracmp));
+			mat4x4_mul(viewprojmat, perspectivemat, cameramat);
+			mat4x4_to_GLfloat16(viewprojmat, viewprojcmp);
+		}
 		
 		
 		// Clean up this iteration.
@@ -209,6 +339,10 @@ int main(int argc, char** argv)
 	
 	engine_destroy_framebuffer(&framebuffer);
 	glfwTerminate();
+	for (unsigned int i = 0; i < pool_threads(&ThreadPool); ++i)
+		arena_free(&ThreadArenas[i]);
+	free(ThreadArenas);
+	pool_free(&ThreadPool);
 	return 0;
 }
 
@@ -269,6 +403,253 @@ GLFWwindow* create_window(const char* title, const GLuint width, const GLuint he
 
 
 
+/* Everything the tasks building the segments of one monomer share. Each segment's curve and ribbon are built on
+ * their own, in the scratch arena of the thread that takes the task, then gathered into the monomer's arena.
+ */
+typedef struct geometry_build
+{
+	curve_engine_t engine;
+	bool         extrude;              // Make control points for the shaders, rather than the ribbon's vertices.
+	curve_t*     curve;                // Of the whole chain, with its segments.
+	ribbon2_t*   ribbon;
+	curve_t*     segment_curves;
+	ribbon2_t*   segment_ribbons;
+	unsigned int* elements;            // First ribbon and outline index of each segment, in pairs.
+	GLfloat*     boxes;                // Low then high corner of the vertices of each segment, in sixes.
+} geometry_build_t;
+
+
+
+/* Build the curve and ribbon of one segment, as a task of the thread pool.
+ */
+static void _build_segment(void* context, unsigned int s, unsigned int thread)
+{
+	geometry_build_t*      build = (geometry_build_t*)context;
+	arena_t*               arena = &ThreadArenas[thread];
+	const curve_segment_t* seg   = &build->curve->segments[s];
+	curve_t*               cur   = &build->segment_curves[s];
+	ribbon2_t*             rib   = &build->segment_ribbons[s];
+	memset(cur, 0, sizeof(curve_t));
+	memset(rib, 0, sizeof(ribbon2_t));
+	int e;
+	if (build->engine == CURVE_ENGINE_ARC)
+		e = interpolate_arc_curve(arena, &CurveQuality, build->curve->alpha_coords + seg->first, seg->len, \
+		                          &cur->points, &cur->arc_centres, &cur->arc_radii, &cur->z_normals, &cur->offsets);
+	else
+		e = interpolate_spline_curve(arena, &CurveQuality, build->engine, build->curve->alpha_coords + seg->first, \
+		                             seg->len, &cur->points, &cur->arc_centres, &cur->arc_radii, &cur->z_normals, \
+		                             &cur->offsets);
+	if (e < 0)
+		return;
+	cur->points_len = e;
+	if (build->extrude)
+		return;
+	e = curve_to_ribbon(arena, cur->points, cur->points_len, cur->z_normals, NULL, cur->offsets, seg->len, \
+	                    &rib->vertex_components, &rib->num_vertex_components, \
+	                    &rib->element_components, &rib->num_element_components);
+	if (e < 0)
+	{
+		cur->points_len = 0;
+		return;
+	}
+	rib->num_vertices = e;
+	ribbon_to_outline(arena, rib->num_vertices, &rib->outline_element_components, \
+	                  &rib->num_outline_element_components);
+	if (rib->outline_element_components == NULL)
+		cur->points_len = 0;
+	
+	// Find the box around the segment, so that the bounds of the whole ribbon can be found from the boxes.
+	GLfloat* box = build->boxes + 6 * s;
+	for (unsigned int k = 0; k < 3; ++k)
+	{
+		box[k]     = INFINITY;
+		box[3 + k] = -INFINITY;
+	}
+	vertex_box(rib->vertex_components, rib->num_vertices, box, box + 3);
+}
+
+
+
+/* Copy the curve and ribbon of one segment into those of the whole chain, where the segment says they go, and
+ * point its indices, other than the restarts that end its strips, at the segment's vertices there. This is a task
+ * of the thread pool.
+ */
+static void _gather_segment(void* context, unsigned int s, unsigned int thread)
+{
+	(void)thread;
+	geometry_build_t*      build = (geometry_build_t*)context;
+	const curve_segment_t* seg   = &build->curve->segments[s];
+	const curve_t*         from  = &build->segment_curves[s];
+	const ribbon2_t*       rfrom = &build->segment_ribbons[s];
+	curve_t*               cur   = build->curve;
+	ribbon2_t*             rib   = build->ribbon;
+	memcpy(cur->points      + seg->points, from->points,      seg->points_len * sizeof(vec4));
+	memcpy(cur->arc_centres + seg->points, from->arc_centres, seg->points_len * sizeof(vec4));
+	memcpy(cur->arc_radii   + seg->points, from->arc_radii,   seg->points_len * sizeof(float));
+	memcpy(cur->z_normals   + seg->points, from->z_normals,   seg->points_len * sizeof(vec4));
+	for (unsigned int j = 0; j <= seg->len; ++j)
+		cur->offsets[seg->offsets + j] = seg->points + from->offsets[j];
+	
+	// Only the curve's own points are needed when the shaders extrude the ribbon.
+	if (build->extrude)
+	{
+		curve_to_control_points(cur->points, seg->points_len, cur->z_normals, NULL, cur->offsets + seg->offsets, \
+		                        seg->len, seg->first, rib->control_points + seg->points);
+		ribbon_control_elements(seg->points, seg->points_len, rib->control_element_components + build->elements[2 * s]);
+		return;
+	}
+	memcpy(rib->vertex_components + seg->vertices * SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX, \
+	       rfrom->vertex_components, rfrom->num_vertex_components * sizeof(GLfloat));
+	ribbon_pack_vertices(rib->vertex_components + seg->vertices * SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX, \
+	                     cur->offsets + seg->offsets, 0, seg->len - 1, seg->first, &rib->bounds, \
+	                     rib->packed_vertices + seg->vertices);
+	GLuint* elements = rib->element_components + build->elements[2 * s];
+	for (unsigned int k = 0; k < rfrom->num_element_components; ++k)
+		elements[k] = (rfrom->element_components[k] == STARBOARD_RIBBON_RESTART) ? STARBOARD_RIBBON_RESTART : \
+		              rfrom->element_components[k] + seg->vertices;
+	GLuint* outline = rib->outline_element_components + build->elements[2 * s + 1];
+	for (unsigned int k = 0; k < rfrom->num_outline_element_components; ++k)
+		outline[k] = (rfrom->outline_element_components[k] == STARBOARD_RIBBON_RESTART) ? \
+		             STARBOARD_RIBBON_RESTART : rfrom->outline_element_components[k] + seg->vertices;
+}
+
+
+
+/* Build the curve and ribbon of a monomer from the columns of its chain, with the given curve engine. The backbone
+ * is split wherever the chain changes or breaks, and the segments are built across the thread pool, then gathered
+ * into one set of buffers. If the ribbon is to be extruded by the shaders, only the points of the curve are kept
+ * for them, and no vertices are built. Every array is taken from the arena.
+ */
+void build_monoview_geometry(arena_t* arena, const chain_t* chn, curve_engine_t engine, bool extrude, \
+                             curve_t* cur, ribbon2_t* rib)
+{
+	memset(cur, 0, sizeof(curve_t));
+	memset(rib, 0, sizeof(ribbon2_t));
+	uint64_t* alphas;
+	int e = select_atoms(chn, "name CA", &alphas); // malloc alphas
+	cur->alphas       = (unsigned int*)arena_alloc(arena, (e > 0 ? e : 0) * sizeof(unsigned int));
+	cur->alphas_len   = (e > 0) ? select_indices(alphas, chn->atoms_len, cur->alphas) : 0;
+	free(alphas);
+	cur->alpha_coords = (vec4*)arena_alloc(arena, cur->alphas_len * sizeof(vec4));
+	chain_gather_vec4s(cur->alpha_coords, chn, cur->alphas, cur->alphas_len);
+	cur->residues_len = curve_extract_residues(arena, chn, cur->alphas, cur->alphas_len, &cur->residues);
+	e = curve_split_segments(arena, chn, cur->alphas, cur->alpha_coords, cur->alphas_len, &cur->segments);
+	cur->segments_len = (e > 0) ? e : 0;
+	
+	vec4 default_color[1];
+	generate_pastel_colors(default_color, 1, 1.00);
+	repeat_color(arena, default_color[0], cur->residues_len, &rib->residue_colors);
+	static const vec4 OUTLINE_COLOR = {1.0, 1.0, 1.0, 1.0};
+	repeat_color(arena, OUTLINE_COLOR, cur->residues_len, &rib->outline_colors);
+	rib->residue_attributes = (residue_attribute_t*)arena_alloc(arena, cur->residues_len * \
+	                                                                   sizeof(residue_attribute_t));
+	if (rib->residue_attributes != NULL)
+		memset(rib->residue_attributes, 0, cur->residues_len * sizeof(residue_attribute_t));
+	
+	// Build every segment on its own.
+	geometry_build_t build;
+	build.engine          = engine;
+	build.extrude         = extrude;
+	build.curve           = cur;
+	build.ribbon          = rib;
+	build.segment_curves  = (curve_t*)  arena_alloc(arena, cur->segments_len * sizeof(curve_t));
+	build.segment_ribbons = (ribbon2_t*)arena_alloc(arena, cur->segments_len * sizeof(ribbon2_t));
+	build.elements        = (unsigned int*)arena_alloc(arena, 2 * cur->segments_len * sizeof(unsigned int));
+	build.boxes           = (GLfloat*)arena_alloc(arena, 6 * cur->segments_len * sizeof(GLfloat));
+	if (build.segment_curves == NULL or build.segment_ribbons == NULL or build.elements == NULL or \
+	    build.boxes == NULL)
+	{
+		cur->segments_len = 0;
+		return;
+	}
+	pool_for(&ThreadPool, cur->segments_len, _build_segment, &build);
+	
+	// Find where each segment goes in the whole, and make room for it all.
+	unsigned int offsets_len = 0, elements_len = 0, outline_len = 0;
+	GLfloat      low[3] = {INFINITY, INFINITY, INFINITY}, high[3] = {-INFINITY, -INFINITY, -INFINITY};
+	for (unsigned int s = 0; s < cur->segments_len; ++s)
+	{
+		curve_segment_t* seg = &cur->segments[s];
+		if (build.segment_curves[s].points_len == 0)
+		{
+			printf("[ERROR] %s: %u.\n", "Could not build the geometry of segment", s);
+			cur->segments_len = 0;
+			break;
+		}
+		seg->points       = cur->points_len;
+		seg->points_len   = build.segment_curves[s].points_len;
+		seg->vertices     = rib->num_vertices;
+		seg->vertices_len = extrude ? seg->points_len : build.segment_ribbons[s].num_vertices;
+		build.elements[2 * s]     = elements_len;
+		build.elements[2 * s + 1] = outline_len;
+		cur->points_len   += seg->points_len;
+		rib->num_vertices += seg->vertices_len;
+		offsets_len       += seg->len + 1;
+		elements_len      += extrude ? seg->points_len + 3 : build.segment_ribbons[s].num_element_components;
+		outline_len       += build.segment_ribbons[s].num_outline_element_components;
+		if (not extrude)
+			for (unsigned int k = 0; k < 3; ++k)
+			{
+				low[k]  = fminf(low[k],  build.boxes[6 * s + k]);
+				high[k] = fmaxf(high[k], build.boxes[6 * s + 3 + k]);
+			}
+	}
+	cur->points      = (vec4*)        arena_alloc(arena, cur->points_len * sizeof(vec4));
+	cur->arc_centres = (vec4*)        arena_alloc(arena, cur->points_len * sizeof(vec4));
+	cur->arc_radii   = (float*)       arena_alloc(arena, cur->points_len * sizeof(float));
+	cur->z_normals   = (vec4*)        arena_alloc(arena, cur->points_len * sizeof(vec4));
+	cur->offsets     = (unsigned int*)arena_alloc(arena, offsets_len * sizeof(unsigned int));
+	bool missing = (cur->points == NULL or cur->arc_centres == NULL or cur->arc_radii == NULL or \
+	                cur->z_normals == NULL or cur->offsets == NULL or rib->residue_attributes == NULL);
+	if (extrude)
+	{
+		rib->num_control_points             = rib->num_vertices;
+		rib->num_control_element_components = elements_len;
+		rib->control_points             = (ribbon_point_t*)arena_alloc(arena, rib->num_control_points * \
+		                                                                      sizeof(ribbon_point_t));
+		rib->control_element_components = (GLuint*)arena_alloc(arena, elements_len * sizeof(GLuint));
+		missing = missing or rib->control_points == NULL or rib->control_element_components == NULL;
+	}
+	else
+	{
+		rib->num_vertex_components          = rib->num_vertices * SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX;
+		rib->num_element_components         = elements_len;
+		rib->num_outline_element_components = outline_len;
+		rib->vertex_components          = (GLfloat*)arena_alloc(arena, rib->num_vertex_components * sizeof(GLfloat));
+		rib->packed_vertices            = (packed_vertex_t*)arena_alloc(arena, rib->num_vertices * \
+		                                                                       sizeof(packed_vertex_t));
+		rib->element_components         = (GLuint*) arena_alloc(arena, elements_len * sizeof(GLuint));
+		rib->outline_element_components = (GLuint*) arena_alloc(arena, outline_len * sizeof(GLuint));
+		vertex_bounds_from_box(low, high, STARBOARD_RIBBON_MARGIN, &rib->bounds);
+		missing = missing or rib->vertex_components == NULL or rib->packed_vertices == NULL or \
+		          rib->element_components == NULL or rib->outline_element_components == NULL;
+	}
+	
+	// Gather the segments, then give back the threads' scratch space.
+	if (cur->segments_len > 0 and missing)
+		cur->segments_len = 0;
+	pool_for(&ThreadPool, cur->segments_len, _gather_segment, &build);
+	for (unsigned int i = 0; i < pool_threads(&ThreadPool); ++i)
+		arena_reset(&ThreadArenas[i]);
+	if (cur->segments_len == 0)
+	{
+		cur->points_len                     = 0;
+		rib->num_vertices                   = 0;
+		rib->num_vertex_components          = 0;
+		rib->num_element_components         = 0;
+		rib->num_outline_element_components = 0;
+		rib->num_control_points             = 0;
+		rib->num_control_element_components = 0;
+	}
+	#ifdef DEBUG
+	printf("[DEBUG] %s: %u segments, %u points, %u vertices.\n", "Built geometry", \
+	       cur->segments_len, cur->points_len, rib->num_vertices);
+	printf("[DEBUG] %s: %zu bytes.\n", "Geometry arena in use", arena_used(arena));
+	#endif
+}
+
+
+
 /* TODO.
  */
 int do_load_command2(params_t* args)
@@ -289,10 +670,12 @@ int do_load_command2(params_t* args)
 	chain_t   chn_in;
 	curve_t   cur_in;
 	ribbon2_t rib_in;
+	arena_t   arena_in;
 	
-	chain_t*   chn = &chn_in;
-	curve_t*   cur = &cur_in;
-	ribbon2_t* rib = &rib_in;
+	chain_t*   chn   = &chn_in;
+	curve_t*   cur   = &cur_in;
+	ribbon2_t* rib   = &rib_in;
+	arena_t*   arena = &arena_in;
 	
 	int e;
 	
@@ -300,11 +683,22 @@ int do_load_command2(params_t* args)
 	//
 	//
 	
-	char filename[strlen(args->argv[1]) + 9]; // It's strlen + 9 because 'v' 'a' 'r' '/' '.' 'p' 'd' 'b' '\0'.
+	// Take the first of these files that exists, or report the plain .pdb as missing.
+	static const char* EXTENSIONS[] = {".pdb", ".cif", ".pdb.gz", ".cif.gz", ".pdb.zst", ".cif.zst"};
+	char filename[strlen(args->argv[1]) + 13]; // It's strlen + 13 because "var/" ".pdb.zst" '\0'.
+	size_t stem = strlen(args->argv[1]) + 4;
 	filename[0] = '\0';
 	strcat(filename, "var/");
 	strcat(filename, args->argv[1]);
-	strcat(filename, ".pdb");
+	unsigned int i = 0;
+	for (; i < sizeof(EXTENSIONS) / sizeof(EXTENSIONS[0]); ++i)
+	{
+		strcpy(filename + stem, EXTENSIONS[i]);
+		if (access(filename, F_OK) == 0)
+			break;
+	}
+	if (i == sizeof(EXTENSIONS) / sizeof(EXTENSIONS[0]))
+		strcpy(filename + stem, EXTENSIONS[0]);
 	e = parse_pdb(chn, filename); // malloc chn->atoms
 	if (e <= 0) // malloc chn->atoms
 	{
@@ -312,41 +706,22 @@ int do_load_command2(params_t* args)
 		return -1;
 	}
 	printf("[NOTICE] %s: %i.\n", "Total atom count", chn->atoms_len);
+	e = chain_build_columns(chn); // malloc chn->cols.memory
+	free(chn->atoms); // The columns hold everything that is needed from here on.
+	chn->atoms = NULL;
+	if (e < 0)
+	{
+		printf("[ERROR] %s: %i.\n", "Call to chain_build_columns() failed with code", e);
+		return -1;
+	}
 	
-	//
-	//
-	
-	cur->alphas = (atom_t*)malloc(chn->atoms_len * sizeof(atom_t)); // malloc cur->alphas
-	cur->alphas_len = filter_atoms(cur->alphas, chn->atoms, chn->atoms_len, 0, 0, "", "CA");
-	atoms_to_vec4s(&cur->alpha_coords, cur->alphas, cur->alphas_len); // malloc cur->alpha_coords
-	cur->residues_len = curve_extract_residues(cur->alphas, cur->alphas_len, &cur->residues); // malloc cur->residues
-	cur->points_len = interpolate_arc_curve(cur->alpha_coords, cur->alphas_len, \
-	                                        &cur->points, &cur->arc_centres, &cur->arc_radii, &cur->z_normals);
-	                                        // malloc cur->points, cur->arc_centres, cur->arc_radii, cur->z_normals
-	
-	
-	//
-	//
-	
-	rib->num_vertices = curve_to_ribbon(cur->points, cur->points_len, cur->z_normals, NULL, \
-	                                    &rib->vertex_components, &rib->num_vertex_components, \
-	                                    &rib->element_components, &rib->num_element_components);
-	                                    // malloc rib->vertex_components, rib->element_components
-	
-	vec4 default_color[1];
-	generate_pastel_colors(default_color, 1, 1.00);
-	repeat_color(default_color[0], cur->residues_len, &rib->residue_colors); // malloc rib->residue_colors
-	residue_colors_to_vertex_colors(rib->residue_colors, cur->residues_len, \
-	                                &rib->vertex_color_components, &rib->num_vertex_color_components);
-	                                // malloc rib->vertex_color_components
-	ribbon_to_outline(rib->num_vertices, &rib->outline_element_components, &rib->num_outline_element_components);
-	                  // malloc rib->outline_element_components
-	
-	static const vec4 OUTLINE_COLOR = {1.0, 1.0, 1.0, 1.0};
-	repeat_color(OUTLINE_COLOR, cur->residues_len, &rib->outline_colors);
-	residue_colors_to_vertex_colors(rib->outline_colors, cur->residues_len, \
-	                                &rib->outline_color_components, &rib->num_outline_color_components);
-	                                // malloc rib->outline_color_components
+	// Size the geometry's arena from the residue count, as each residue adds at most one alpha carbon.
+	if (arena_init(arena, (size_t)chn->residues.len * STARBOARD_ARENA_PER_RESIDUE) < 0)
+	{
+		chain_free_columns(chn);
+		return -1;
+	}
+	build_monoview_geometry(arena, chn, CURVE_ENGINE_ARC, false, cur, rib);
 	
 	
 	//
@@ -355,15 +730,793 @@ int do_load_command2(params_t* args)
 	monoview_t* monoview = (monoview_t*)malloc(sizeof(monoview_t));
 	monoview->name = malloc((strlen(args->argv[1]) + 1) * sizeof(char));
 	memcpy(monoview->name, args->argv[1], (strlen(args->argv[1]) + 1) * sizeof(char));
+	monoview->filename = strdup(filename);
+	monoview->models   = NULL; // Indexed by the first `model` command.
+	monoview->model    = 0;
+	monoview->copied   = false;
+	monoview->selection     = NULL;
+	monoview->selection_len = 0;
+	monoview->engine        = CURVE_ENGINE_ARC;
+	monoview->extrusion     = 0;
+	monoview->structure     = NULL;
+	int copies = parse_pdb_assembly(&monoview->assembly, filename); // malloc monoview->assembly
+	monoview->assembly_len  = (copies > 0) ? (unsigned int)copies : 0;
+	monoview->assembled     = (copies > 1);    // One copy is the chain as it is.
 	memcpy(&monoview->chain,  chn, sizeof(chain_t));
 	memcpy(&monoview->curve,  cur, sizeof(curve_t));
 	memcpy(&monoview->ribbon, rib, sizeof(ribbon2_t));
+	memcpy(&monoview->arena,  arena, sizeof(arena_t));
+	assign_monoview_structure(monoview);
 	drawable_t* drawable = (drawable_t*)malloc(sizeof(drawable_t));
 	
-	allocate_drawable_buffers(2, drawable); 
+	if (drawable == NULL or allocate_drawable_buffers(2, drawable) < 0)
+	{
+		free(drawable);
+		monoview_free(monoview);
+		return -7;
+	}
 	monoview_to_drawable(monoview, drawable);
-	add_object((void*)monoview, MONOVIEW, drawable);
+	int slot = add_object((void*)monoview, MONOVIEW, drawable);
+	if (slot < 0)
+	{
+		printf("[ERROR] %s\n", "There is no memory for another object.");
+		free_drawable_buffers(drawable);
+		free(drawable);
+		monoview_free(monoview);
+		return -8;
+	}
+	printf("[NOTICE] %s %llu.\n", "Loaded the file as object", (unsigned long long)object_id((unsigned int)slot));
+	if (monoview->assembled)
+		printf("[NOTICE] %s: %u copies of the chain. Use `assembly %llu off` to show one.\n", \
+		       "Showing the biological assembly", monoview->assembly_len, \
+		       (unsigned long long)object_id((unsigned int)slot));
+	
+	return 0;
+}
+
+
+
+/* Find a monomer object from its number in `status`, and its slot.
+ * Returns the object, or NULL (having said why) if there is none, e.g. because it has been deleted.
+ */
+static monoview_t* _find_monoview(const char* number, unsigned int* object)
+{
+	char*                    e;
+	const unsigned long long id = strtoull(number, &e, 10);
+	if (e == number or *e != '\0' or find_object((object_id_t)id, MONOVIEW, object) < 0)
+	{
+		printf("[ERROR] %s\n", "Please choose an object listed as MONOMER under `status`.");
+		return NULL;
+	}
+	return (monoview_t*)RenderObjs[*object];
+}
+
+
+
+/* Replace the monomer shown by an object with another model from the same file, i.e. `model i n` shows the
+ * n-th model (counting from 1) in object i. The file is indexed on first use, and models are decoded on demand.
+ */
+int do_model_command(params_t* args)
+{
+	if (args->argc != 3)
+	{
+		printf("[ERROR] %s\n", "Usage: model object# model#");
+		return -1;
+	}
+	char*         e2;
+	unsigned int  object;
+	unsigned long model    = strtoul(args->argv[2], &e2, 10);
+	monoview_t*   monoview = (*e2 == '\0') ? _find_monoview(args->argv[1], &object) : NULL;
+	if (monoview == NULL)
+		return -2;
+	
+	// Index the file the first time, at which point the model cache takes over ownership of the chain.
+	if (monoview->models == NULL)
+	{
+		model_index_t* models = (model_index_t*)malloc(sizeof(model_index_t)); // malloc monoview->models
+		int e = (models == NULL) ? -2 : model_index_open(models, monoview->filename);
+		if (e < 0)
+		{
+			printf("[ERROR] %s: %s. Error code: %i.\n", "Could not index models in", monoview->filename, e);
+			free(models);
+			return -3;
+		}
+		chain_free_columns(&monoview->chain);
+		monoview->models = models;
+		monoview->model  = 0;
+	}
+	if (model < 1 or model > monoview->models->models_len)
+	{
+		printf("[ERROR] %s: %u.\n", "Model number out of range; models in file", monoview->models->models_len);
+		return -4;
+	}
+	
+	// Decode the model (or take it from the cache), and rebuild the geometry and GPU buffers from it.
+	const chain_t* chn = model_index_get(monoview->models, model - 1);
+	if (chn == NULL)
+		return -5;
+	if (monoview->copied)
+		chain_free_columns(&monoview->chain);
+	monoview->chain  = *chn;
+	monoview->model  = model - 1;
+	monoview->copied = false;
+	free(monoview->selection); // A selection is compiled against one chain's names and atom order.
+	monoview->selection     = NULL;
+	monoview->selection_len = 0;
+	assign_monoview_structure(monoview);
+	rebuild_monoview(object);
+	printf("[NOTICE] %s %u (MODEL %u): %u atoms.\n", "Showing model", (unsigned int)model, \
+	       monoview->models->serials[model - 1], chn->atoms_len);
+	return 0;
+}
+
+
+
+/* Rebuild the geometry and GPU buffers of a monomer object from its chain, keeping where it is drawn, and how its
+ * residues look if it still has as many. Only a selection that it still has keeps its residues selected.
+ */
+void rebuild_monoview(unsigned int object)
+{
+	monoview_t*        monoview = (monoview_t*)RenderObjs[object];
+	ribbon2_t*         rib      = &monoview->ribbon;
+	const unsigned int residues = monoview->curve.residues_len;
+	vec4*                colors     = (vec4*)malloc(residues * sizeof(vec4));                // malloc colors
+	residue_attribute_t* attributes = (residue_attribute_t*)malloc(residues * sizeof(*attributes)); // malloc attributes
+	const bool keep = (colors != NULL and attributes != NULL and rib->residue_colors != NULL and \
+	                   rib->residue_attributes != NULL);
+	if (keep)
+	{
+		memcpy(colors,     rib->residue_colors,     residues * sizeof(vec4));
+		memcpy(attributes, rib->residue_attributes, residues * sizeof(residue_attribute_t));
+	}
+	monoview_free_geometry(monoview);
+	build_monoview_geometry(&monoview->arena, &monoview->chain, monoview->engine, monoview->extrusion > 0, \
+	                        &monoview->curve, &monoview->ribbon);
+	if (keep and monoview->curve.residues_len == residues and rib->residue_colors != NULL and \
+	    rib->residue_attributes != NULL)
+	{
+		memcpy(rib->residue_colors,     colors,     residues * sizeof(vec4));
+		memcpy(rib->residue_attributes, attributes, residues * sizeof(residue_attribute_t));
+		if (monoview->selection == NULL)
+			for (unsigned int i = 0; i < residues; ++i)
+				rib->residue_attributes[i].style &= ~STARBOARD_RIBBON_SELECTED;
+	}
+	free(colors);     // free colors
+	free(attributes); // free attributes
+	
+	// Give the old buffers back before setting up new ones, so that the drawable keeps its slot even when there are
+	// as many drawables as there can be.
+	drawable_t* drawable = RenderObjDrawables[object];
+	drawable_t  old      = *drawable;
+	free_drawable_buffers(drawable);
+	allocate_drawable_buffers(2, drawable);
+	memcpy(drawable->model_matrix,            old.model_matrix,            sizeof(drawable->model_matrix));
+	memcpy(drawable->model_matrix_components, old.model_matrix_components, sizeof(drawable->model_matrix_components));
+	monoview_to_drawable(monoview, drawable);
+	buffer_transform(drawable);
+}
+
+
+
+/* Assign the secondary structure of every residue of a monomer from its backbone, and say how much of it is helix
+ * and strand. A monomer whose structure cannot be assigned keeps none, rather than a stale one.
+ */
+void assign_monoview_structure(monoview_t* view)
+{
+	free(view->structure);
+	view->structure = (char*)malloc((view->chain.residues.len + 1) * sizeof(char)); // malloc view->structure
+	if (view->structure == NULL)
+		return;
+	int e = dssp_assign(&ThreadPool, &ThreadArenas[0], &view->chain, view->structure);
+	if (e < 0)
+	{
+		printf("[ERROR] %s: %i.\n", "Call to dssp_assign() failed with code", e);
+		free(view->structure);
+		view->structure = NULL;
+		return;
+	}
+	unsigned int helix = 0, strand = 0;
+	for (unsigned int i = 0; i < view->chain.residues.len; ++i)
+	{
+		helix  += (view->structure[i] == 'H' or view->structure[i] == 'G' or view->structure[i] == 'I');
+		strand += (view->structure[i] == 'E' or view->structure[i] == 'B');
+	}
+	printf("[NOTICE] %s: %u helix, %u strand, of %i residues with a backbone.\n", "Secondary structure", \
+	       helix, strand, e);
+}
+
+
+
+/* Find the first segment of a curve that does not end before alpha carbon i.
+ */
+static unsigned int _find_segment(const curve_t* cur, unsigned int i)
+{
+	unsigned int lo = 0, hi = cur->segments_len;
+	while (lo < hi)
+	{
+		unsigned int mid = (lo + hi) / 2;
+		if (cur->segments[mid].first + cur->segments[mid].len <= i)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+
+
+/* Rebuild the curve and ribbon around alpha carbons first to last of a monomer object in place, after their atoms
+ * have moved or the colours of their residues have changed, and upload only the vertices that changed. How many
+ * points each residue has, and where the backbone breaks, stay as they were until the geometry is next built in
+ * full, so the buffers keep their sizes and the work does not depend on the size of the structure.
+ * Colours are kept one per residue, so recolouring uploads only those. A move that takes vertices outside the
+ * bounds that they are packed within rebuilds the ribbon in full, from every atom as it is, so that the caller has
+ * nothing left to update.
+ * Returns the number of vertices uploaded, or of control points if the shaders extrude the ribbon; -1 if first to
+ * last is out of range; -2 if the curve could not be updated; -3 if the ribbon was rebuilt in full instead.
+ */
+int update_monoview_geometry(unsigned int object, unsigned int first, unsigned int last, bool moved, bool recolored)
+{
+	monoview_t* view = (monoview_t*)RenderObjs[object];
+	curve_t*    cur  = &view->curve;
+	ribbon2_t*  rib  = &view->ribbon;
+	if (first > last or last >= cur->alphas_len)
+		return -1;
+	if (moved)
+		chain_gather_vec4s(cur->alpha_coords + first, &view->chain, cur->alphas + first, last - first + 1);
+	
+	int uploaded = 0;
+	for (unsigned int s = _find_segment(cur, first); s < cur->segments_len and cur->segments[s].first <= last; ++s)
+	{
+		const curve_segment_t* seg     = &cur->segments[s];
+		const unsigned int*    offsets = cur->offsets + seg->offsets;
+		const unsigned int     a       = ((first > seg->first) ? first : seg->first) - seg->first;
+		const unsigned int     b       = ((last < seg->first + seg->len - 1) ? last : seg->first + seg->len - 1) - \
+		                                 seg->first;
+		unsigned int from = a, to = b;
+		if (moved)
+		{
+			int e;
+			if (view->engine == CURVE_ENGINE_ARC)
+				e = update_arc_curve(&view->arena, cur->alpha_coords + seg->first, seg->len, offsets, a, b, \
+				                     cur->points, cur->arc_centres, cur->arc_radii, cur->z_normals, &from, &to);
+			else
+				e = update_spline_curve(&view->arena, view->engine, cur->alpha_coords + seg->first, seg->len, \
+				                        offsets, a, b, cur->points, cur->arc_centres, cur->arc_radii, \
+				                        cur->z_normals, &from, &to);
+			if (e < 0)
+				return -2;
+			if (view->extrusion > 0)
+				to = ribbon_update_control_points(cur->points, cur->z_normals, offsets, seg->len, from, to, \
+				                                  rib->control_points + seg->points);
+			else
+			{
+				GLfloat* vertices = rib->vertex_components + seg->vertices * SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX;
+				to = ribbon_update_vertices(cur->points, cur->z_normals, offsets, seg->len, from, to, vertices);
+				if (ribbon_pack_vertices(vertices, offsets, from, to, seg->first, &rib->bounds, \
+				                         rib->packed_vertices + seg->vertices) > 0)
+				{
+					// The packed vertices can't reach outside the bounds, so find new ones.
+					rebuild_monoview(object);
+					return -3;
+				}
+			}
+		}
+		
+		// When the shaders extrude the ribbon, each point is one control point. Otherwise each residue has two
+		// vertices for each of its points, including the one it shares with the next.
+		unsigned int v0, v1;
+		if (view->extrusion > 0)
+		{
+			v0 = seg->points + offsets[from] - offsets[0];
+			v1 = seg->points + offsets[to + 1] - offsets[0];
+		}
+		else
+		{
+			v0 = seg->vertices + 2 * (offsets[from] - offsets[0] + from);
+			v1 = seg->vertices + 2 * (offsets[to + 1] - offsets[0] + to + 1) - 1;
+		}
+		monoview_patch_drawable(view, RenderObjDrawables[object], v0, v1, seg->first + a, seg->first + b, \
+		                        moved, recolored);
+		uploaded += moved ? v1 - v0 + 1 : 0;
+	}
+	return uploaded;
+}
+
+
+
+/* Find a monomer object from its number in `status`, and check that it has a selection.
+ * Returns the object, or NULL (having said why) if there is none.
+ */
+static monoview_t* _selected_monoview(const char* number, unsigned int* object)
+{
+	monoview_t* monoview = _find_monoview(number, object);
+	if (monoview == NULL)
+		return NULL;
+	if (monoview->selection == NULL or monoview->selection_len == 0)
+	{
+		printf("[ERROR] %s\n", "Please select some atoms of the object first, with `select`.");
+		return NULL;
+	}
+	return monoview;
+}
+
+
+
+/* Whether residue i of a monomer's curve has any selected atoms.
+ */
+static bool _residue_selected(const monoview_t* view, unsigned int i)
+{
+	const residues_t*  res = &view->chain.residues;
+	const unsigned int r   = view->curve.residues[i];
+	for (unsigned int j = res->starts[r]; j < res->starts[r + 1]; ++j)
+		if ((view->selection[j / 64] >> (j % 64)) & 1)
+			return true;
+	return false;
+}
+
+
+
+/* Set and clear flags in the styles of the residues of a monomer object that have any selected atoms, and clear
+ * others in the styles of the rest, then upload the attributes from the first residue that changed to the last,
+ * in one piece.
+ * Returns the number of residues with selected atoms.
+ */
+static unsigned int _restyle_residues(unsigned int object, GLuint set, GLuint clear, GLuint clear_others)
+{
+	monoview_t*          view       = (monoview_t*)RenderObjs[object];
+	residue_attribute_t* attributes = view->ribbon.residue_attributes;
+	unsigned int         first      = view->curve.alphas_len, last = 0, selected = 0;
+	for (unsigned int i = 0; i < view->curve.alphas_len; ++i)
+	{
+		const GLuint before = attributes[i].style;
+		if (view->selection != NULL and _residue_selected(view, i))
+		{
+			attributes[i].style = (before & ~clear) | set;
+			++selected;
+		}
+		else
+			attributes[i].style = before & ~clear_others;
+		if (attributes[i].style != before)
+		{
+			first = (i < first) ? i : first;
+			last  = i;
+		}
+	}
+	monoview_patch_attributes(view, RenderObjDrawables[object], first, last);
+	return selected;
+}
+
+
+
+/* Move the selected atoms of an object by a vector, i.e. `move i dx dy dz`, and rebuild the ribbon around the
+ * alpha carbons that moved.
+ */
+int do_move_command(params_t* args)
+{
+	if (args->argc != 5)
+	{
+		printf("[ERROR] %s\n", "Usage: move object# dx dy dz");
+		return -1;
+	}
+	unsigned int object;
+	monoview_t*  monoview = _selected_monoview(args->argv[1], &object);
+	if (monoview == NULL)
+		return -2;
+	float d[3];
+	for (unsigned int k = 0; k < 3; ++k)
+	{
+		char* e;
+		d[k] = strtof(args->argv[2 + k], &e);
+		if (*e != '\0')
+		{
+			printf("[ERROR] %s: %s.\n", "Not a number", args->argv[2 + k]);
+			return -1;
+		}
+	}
+	
+	// A model from the cache is moved in a copy of its own, so that it is as in the file when it is shown again.
+	if (monoview->models != NULL and not monoview->copied)
+	{
+		chain_t copy;
+		if (chain_copy_columns(&copy, &monoview->chain) < 0)
+		{
+			printf("[ERROR] %s\n", "Could not copy the model to move it.");
+			return -3;
+		}
+		monoview->chain  = copy;
+		monoview->copied = true;
+	}
+	
+	columns_t*      cols = &monoview->chain.cols;
+	const uint64_t* bits = monoview->selection;
+	for (unsigned int i = 0; i < monoview->chain.atoms_len; ++i)
+		if ((bits[i / 64] >> (i % 64)) & 1)
+		{
+			cols->x[i] += d[0];
+			cols->y[i] += d[1];
+			cols->z[i] += d[2];
+		}
+	
+	// Rebuild around each run of alpha carbons that moved, unless one of them rebuilds the whole ribbon.
+	const curve_t* cur      = &monoview->curve;
+	int            vertices = 0;
+	bool           rebuilt  = false;
+	for (unsigned int i = 0; i < cur->alphas_len and not rebuilt; ++i)
+	{
+		const unsigned int first = i;
+		while (i < cur->alphas_len and ((bits[cur->alphas[i] / 64] >> (cur->alphas[i] % 64)) & 1))
+			++i;
+		if (i > first)
+		{
+			const int e = update_monoview_geometry(object, first, i - 1, true, false);
+			rebuilt     = (e == -3);
+			vertices   += (e > 0) ? e : 0;
+		}
+	}
+	if (rebuilt)
+		printf("[NOTICE] %s: %u atoms; %s.\n", "Moved", monoview->selection_len, "the ribbon was rebuilt in full");
+	else
+		printf("[NOTICE] %s: %u atoms; %i vertices rebuilt.\n", "Moved", monoview->selection_len, vertices);
+	return 0;
+}
+
+
+
+/* Colour the residues that have any selected atoms in an object, i.e. `color i r g b` with components from 0 to 1,
+ * and rebuild the colours of the ribbon there.
+ */
+int do_color_command(params_t* args)
+{
+	if (args->argc != 5)
+	{
+		printf("[ERROR] %s\n", "Usage: color object# r g b");
+		return -1;
+	}
+	unsigned int object;
+	monoview_t*  monoview = _selected_monoview(args->argv[1], &object);
+	if (monoview == NULL)
+		return -2;
+	vec4 color = {0.0, 0.0, 0.0, 1.0};
+	for (unsigned int k = 0; k < 3; ++k)
+	{
+		char* e;
+		color[k] = strtof(args->argv[2 + k], &e);
+		if (*e != '\0' or color[k] < 0.0 or color[k] > 1.0)
+		{
+			printf("[ERROR] %s: %s.\n", "Not a colour component from 0 to 1", args->argv[2 + k]);
+			return -1;
+		}
+	}
+	
+	// A residue is coloured if any of its atoms are selected, and no longer takes its colour from a colour map.
+	const curve_t* cur     = &monoview->curve;
+	unsigned int   colored = 0;
+	for (unsigned int i = 0; i < cur->alphas_len; ++i)
+	{
+		const unsigned int first = i;
+		for (; i < cur->alphas_len and _residue_selected(monoview, i); ++i)
+		{
+			memcpy(monoview->ribbon.residue_colors[i], color, sizeof(vec4));
+			monoview->ribbon.residue_attributes[i].style &= ~STARBOARD_RIBBON_MAP_MASK;
+		}
+		if (i > first)
+		{
+			update_monoview_geometry(object, first, i - 1, false, true);
+			monoview_patch_attributes(monoview, RenderObjDrawables[object], first, i - 1);
+			colored += i - first;
+		}
+	}
+	printf("[NOTICE] %s: %u residues.\n", "Coloured", colored);
+	return 0;
+}
+
+
+
+/* Hide the residues that have any selected atoms in an object, i.e. `hide i`, ribbon and outline alike, until
+ * they are shown again.
+ */
+int do_hide_command(params_t* args)
+{
+	if (args->argc != 2)
+	{
+		printf("[ERROR] %s\n", "Usage: hide object#");
+		return -1;
+	}
+	unsigned int object;
+	if (_selected_monoview(args->argv[1], &object) == NULL)
+		return -2;
+	unsigned int hidden = _restyle_residues(object, STARBOARD_RIBBON_HIDDEN, 0, 0);
+	printf("[NOTICE] %s: %u residues.\n", "Hidden", hidden);
+	return 0;
+}
+
+
+
+/* Highlight the residues that have any selected atoms in an object, i.e. `highlight i`, by lightening them, and
+ * stop highlighting the rest. Unlike the selection, which is tinted, this stays until the next `highlight`.
+ */
+int do_highlight_command(params_t* args)
+{
+	if (args->argc != 2)
+	{
+		printf("[ERROR] %s\n", "Usage: highlight object#");
+		return -1;
+	}
+	unsigned int object;
+	if (_selected_monoview(args->argv[1], &object) == NULL)
+		return -2;
+	unsigned int highlighted = _restyle_residues(object, STARBOARD_RIBBON_HIGHLIGHTED, 0, \
+	                                             STARBOARD_RIBBON_HIGHLIGHTED);
+	printf("[NOTICE] %s: %u residues.\n", "Highlighted", highlighted);
+	return 0;
+}
+
+
+
+/* Show the residues that have any selected atoms in an object again, i.e. `show i`, after `hide`.
+ */
+int do_show_command(params_t* args)
+{
+	if (args->argc != 2)
+	{
+		printf("[ERROR] %s\n", "Usage: show object#");
+		return -1;
+	}
+	unsigned int object;
+	if (_selected_monoview(args->argv[1], &object) == NULL)
+		return -2;
+	unsigned int shown = _restyle_residues(object, 0, STARBOARD_RIBBON_HIDDEN, 0);
+	printf("[NOTICE] %s: %u residues.\n", "Shown", shown);
+	return 0;
+}
+
+
+
+/* Colour the residues that have any selected atoms in an object along a colour map, in the order of the chain,
+ * i.e. `spectrum i rainbow` from blue at the first of them to red at the last. Only their attributes are
+ * uploaded, in one piece; `color` gives them colours of their own again.
+ */
+int do_spectrum_command(params_t* args)
+{
+	unsigned int map = COLORMAP_NONE + 1;
+	if (args->argc == 3)
+		while (map < COLORMAP_LEN and strcasecmp(args->argv[2], COLORMAP_NAMES[map]) != 0)
+			++map;
+	if (args->argc != 3 or map == COLORMAP_LEN)
+	{
+		printf("[ERROR] %s\n", "Usage: spectrum object# rainbow|bwr|grey");
+		return -1;
+	}
+	unsigned int object;
+	monoview_t*  monoview = _selected_monoview(args->argv[1], &object);
+	if (monoview == NULL)
+		return -2;
+	
+	// Count the residues first, so that each can be given its place between the first and the last.
+	const curve_t*       cur        = &monoview->curve;
+	residue_attribute_t* attributes = monoview->ribbon.residue_attributes;
+	unsigned int         count      = 0, first = cur->alphas_len, last = 0;
+	for (unsigned int i = 0; i < cur->alphas_len; ++i)
+		if (_residue_selected(monoview, i))
+		{
+			first = (i < first) ? i : first;
+			last  = i;
+			++count;
+		}
+	unsigned int k = 0;
+	for (unsigned int i = first; i <= last and i < cur->alphas_len; ++i)
+		if (_residue_selected(monoview, i))
+		{
+			attributes[i].value = (count > 1) ? (GLfloat)k / (GLfloat)(count - 1) : 0.0;
+			attributes[i].style = (attributes[i].style & ~STARBOARD_RIBBON_MAP_MASK) | map;
+			++k;
+		}
+	monoview_patch_attributes(monoview, RenderObjDrawables[object], first, last);
+	printf("[NOTICE] %s: %u residues, %s.\n", "Coloured along a colour map", count, COLORMAP_NAMES[map]);
+	return 0;
+}
+
+
+
+/* Choose whether a monomer object is drawn as its biological assembly, i.e. `assembly i on` draws a copy of the
+ * chain for each operator of the BIOMT records of its file, all from the same buffers, and `assembly i off` draws
+ * the chain once, as it is in the file. Nothing is rebuilt either way.
+ */
+int do_assembly_command(params_t* args)
+{
+	const bool on = (args->argc == 3 and strcasecmp(args->argv[2], "on") == 0);
+	if (args->argc != 3 or (not on and strcasecmp(args->argv[2], "off") != 0))
+	{
+		printf("[ERROR] %s\n", "Usage: assembly object# on|off");
+		return -1;
+	}
+	unsigned int object;
+	monoview_t*  monoview = _find_monoview(args->argv[1], &object);
+	if (monoview == NULL)
+		return -2;
+	if (on and monoview->assembly_len == 0)
+	{
+		printf("[ERROR] %s\n", "The object's file has no BIOMT records for a biological assembly.");
+		return -3;
+	}
+	monoview->assembled = on;
+	if (buffer_operators(monoview->assembly, on ? monoview->assembly_len : 0, RenderObjDrawables[object]) < 0)
+	{
+		printf("[ERROR] %s\n", "There is no room on the GPU for the assembly, so the chain is drawn once.");
+		monoview->assembled = false;
+		return -4;
+	}
+	if (on)
+		printf("[NOTICE] %s %s: %u copies of the chain.\n", "Showing the biological assembly of object", \
+		       args->argv[1], monoview->assembly_len);
+	else
+		printf("[NOTICE] %s %s.\n", "Showing only the chain of object", args->argv[1]);
+	return 0;
+}
+
+
+
+/* Choose how the backbone of a monomer object is curved, i.e. `curve i arc` for arcs through each three alpha
+ * carbons, `curve i catmull-rom` for a spline through them, or `curve i b-spline` for a smoother one near them,
+ * and rebuild it.
+ */
+int do_curve_command(params_t* args)
+{
+	static const char* ENGINES[] = {"arc", "catmull-rom", "b-spline"};
+	unsigned int engine = 0;
+	if (args->argc == 3)
+		while (engine < sizeof(ENGINES) / sizeof(ENGINES[0]) and strcasecmp(args->argv[2], ENGINES[engine]) != 0)
+			++engine;
+	if (args->argc != 3 or engine == sizeof(ENGINES) / sizeof(ENGINES[0]))
+	{
+		printf("[ERROR] %s\n", "Usage: curve object# arc|catmull-rom|b-spline");
+		return -1;
+	}
+	unsigned int object;
+	monoview_t*  monoview = _find_monoview(args->argv[1], &object);
+	if (monoview == NULL)
+		return -2;
+	monoview->engine = (curve_engine_t)engine;
+	rebuild_monoview(object);
+	printf("[NOTICE] %s %s: %s.\n", "Curve of object", args->argv[1], ENGINES[engine]);
+	return 0;
+}
+
+
+
+/* Delete a monomer object, i.e. `delete i`, with everything it owns here and its ranges of the buffers on the GPU,
+ * which later objects reuse. Its number is not given to another object, so commands that name it fail.
+ */
+int do_delete_command(params_t* args)
+{
+	if (args->argc != 2)
+	{
+		printf("[ERROR] %s\n", "Usage: delete object#");
+		return -1;
+	}
+	unsigned int object;
+	monoview_t*  monoview = _find_monoview(args->argv[1], &object);
+	if (monoview == NULL)
+		return -2;
+	monoview_free(monoview);    // free monoview
+	del_object(object);         // free drawable
+	printf("[NOTICE] %s %s.\n", "Deleted object", args->argv[1]);
+	return 0;
+}
+
+
+
+/* Choose whether the shaders extrude the ribbon of a monomer object from the points of its curve, i.e.
+ * `extrude i n` cuts each piece of the curve into n more (up to 16) as it is drawn, and `extrude i 0` builds every
+ * vertex here again, as before. Only switching between the two rebuilds the ribbon; otherwise n takes effect from
+ * the next frame.
+ */
+int do_extrude_command(params_t* args)
+{
+	char*         e2 = NULL;
+	unsigned long pieces = (args->argc == 3) ? strtoul(args->argv[2], &e2, 10) : 0;
+	if (args->argc != 3 or *e2 != '\0' or pieces > STARBOARD_RIBBON_SUBDIVISIONS_MAX)
+	{
+		printf("[ERROR] %s %u.\n", "Usage: extrude object# pieces, where pieces is from 0 to", \
+		       STARBOARD_RIBBON_SUBDIVISIONS_MAX);
+		return -1;
+	}
+	unsigned int object;
+	monoview_t*  monoview = _find_monoview(args->argv[1], &object);
+	if (monoview == NULL)
+		return -2;
+	const unsigned int before = monoview->extrusion;
+	monoview->extrusion = (unsigned int)pieces;
+	if ((before > 0) != (pieces > 0))
+		rebuild_monoview(object);
+	else
+	{
+		RenderObjDrawables[object]->subdivisions = (GLint)pieces;
+		buffer_transform(RenderObjDrawables[object]);
+	}
+	if (pieces > 0)
+		printf("[NOTICE] %s %s: %lu pieces for each piece of the curve.\n", "Shaders extrude the ribbon of object", \
+		       args->argv[1], pieces);
+	else
+		printf("[NOTICE] %s %s.\n", "Built the ribbon's vertices of object", args->argv[1]);
+	return 0;
+}
+
+
+
+/* Set how finely the ribbons of every monomer are subdivided, i.e. `quality 0` for two pieces per residue, as
+ * before, up to `quality 8`, and rebuild them. Higher levels add pieces where the backbone bends most, or, for a
+ * spline, everywhere alike.
+ */
+int do_quality_command(params_t* args)
+{
+	char* e = NULL;
+	unsigned long level = (args->argc == 2) ? strtoul(args->argv[1], &e, 10) : 0;
+	if (args->argc != 2 or *e != '\0' or level > STARBOARD_CURVE_QUALITY_MAX)
+	{
+		printf("[ERROR] %s %u.\n", "Usage: quality level, where level is from 0 to", STARBOARD_CURVE_QUALITY_MAX);
+		return -1;
+	}
+	CurveQuality = curve_quality_level((unsigned int)level);
+	for (unsigned int i = 0; i < RenderObjsEnd; ++i)
+		if (RenderObjs[i] != NULL and RenderObjClasses[i] == MONOVIEW)
+			rebuild_monoview(i);
+	printf("[NOTICE] %s %u: %u to %u pieces per residue; %u for splines.\n", "Curve quality", (unsigned int)level, \
+	       CurveQuality.min, CurveQuality.max, CurveQuality.pieces);
+	return 0;
+}
+
+
+
+/* Select atoms of an object with the selection language, i.e. `select i name CA and resi 10-20`. The selection
+ * is kept with the object.
+ */
+int do_select_command(params_t* args)
+{
+	if (args->argc < 3)
+	{
+		printf("[ERROR] %s\n", "Usage: select object# selection");
+		return -1;
+	}
+	unsigned int object;
+	monoview_t*  monoview = _find_monoview(args->argv[1], &object);
+	if (monoview == NULL)
+		return -2;
+	
+	// Put the words of the selection back together.
+	size_t len = 0;
+	for (unsigned int i = 2; i < args->argc; ++i)
+		len += strlen(args->argv[i]) + 1;
+	char text[len];
+	text[0] = '\0';
+	for (unsigned int i = 2; i < args->argc; ++i)
+	{
+		strcat(text, args->argv[i]);
+		if (i + 1 < args->argc)
+			strcat(text, " ");
+	}
+	
+	uint64_t* selection;
+	int e = select_atoms(&monoview->chain, text, &selection); // malloc selection
+	if (e < 0)
+		return -3;
+	free(monoview->selection);
+	monoview->selection     = selection;
+	monoview->selection_len = e;
 	
+	// Summarise the selection by the residues it touches.
+	const residues_t* res      = &monoview->chain.residues;
+	unsigned int      residues = 0;
+	for (unsigned int i = 0; i < res->len; ++i)
+		for (unsigned int j = res->starts[i]; j < res->starts[i + 1]; ++j)
+			if ((selection[j / 64] >> (j % 64)) & 1)
+			{
+				++residues;
+				break;
+			}
+	_restyle_residues(object, STARBOARD_RIBBON_SELECTED, 0, STARBOARD_RIBBON_SELECTED);
+	printf("[NOTICE] %s: %i atoms in %u residues.\n", "Selected", e, residues);
 	return 0;
 }
 
@@ -399,7 +1552,7 @@ int do_structure_command(params_t* args)
 	char num[len];
 	memcpy(num, &args->argv[1][1], len);
 	char* e;
-	unsigned int model = (unsigned int)strtoul(num, &e, 10);
+	unsigned long long model = strtoull(num, &e, 10);
 	if (e == num and model == 0)
 	{
 		printf("[ERROR] %s: %s.\n", "Could not convert to integer", num);
@@ -410,7 +1563,8 @@ int do_structure_command(params_t* args)
 	// Check that the specified model is present and a monomer structure.
 	//
 	
-	if (model >= RenderObjsLen or RenderObjClasses[model] != MONOMER)
+	unsigned int slot;
+	if (find_object((object_id_t)model, MONOVIEW, &slot) < 0)
 	{
 		printf("[ERROR] %s\n", "Please choose a model listed as MONOMER under `status`.");
 		return -5;
@@ -420,7 +1574,7 @@ int do_structure_command(params_t* args)
 	// Check that the .kbstr file is present, or create it.
 	//
 	
-	char* uniprot = *(char**)RenderObjs[model];
+	char* uniprot = *(char**)RenderObjs[slot];
 	
 	char filename[strlen(uniprot) + 11]; // + 11 because 'v' 'a' 'r' '/' '.' 'k' 'b' 's' 't' 'r' '\0'.
 	filename[0] = '\0';
@@ -458,12 +1612,14 @@ int do_status_command(params_t* args)
 		return -1;
 	}
 	
-	printf("[STATUS] %s: %i.\n", "Number of models loaded", RenderObjsLen);
+	printf("[STATUS] %s: %u.\n", "Number of models loaded", RenderObjsLen);
 	char buffer[1024];
-	for (unsigned int i = 0; i < RenderObjsLen; ++i)
+	for (unsigned int i = 0; i < RenderObjsEnd; ++i)
 	{
+		if (RenderObjs[i] == NULL)
+			continue;
 		objclass2string(RenderObjClasses[i], buffer);
-		printf("........ %i %s %s\n", i, buffer, *(char**)RenderObjs[i]);
+		printf("........ %llu %s %s\n", (unsigned long long)object_id(i), buffer, *(char**)RenderObjs[i]);
 	}
 }
 
@@ -0,0 +1,181 @@
+#include "models.h"
+#include "cif.h"
+#include "zstream.h"
+
+
+
+/* Read the serial number of a MODEL record, in columns 11 to 14 (though some writers let it run on).
+ */
+static inline unsigned int __model_serial(const char* line, const size_t len)
+{
+	unsigned int serial = 0;
+	for (size_t i = 6; i < len; ++i)
+	{
+		const unsigned int d = (unsigned int)(unsigned char)line[i] - '0';
+		if (d < 10)
+			serial = 10 * serial + d;
+		else if (line[i] != ' ')
+			break;
+	}
+	return serial;
+}
+
+
+
+/* Record the start of every MODEL record in the mapped file.
+ * Returns the number of models found, or less than 0 on error.
+ */
+static int _index_models(model_index_t* index)
+{
+	unsigned int cap = 64;
+	index->offsets = (size_t*)malloc((cap + 1) * sizeof(size_t));             // malloc index->offsets
+	index->serials = (unsigned int*)malloc(cap * sizeof(unsigned int));       // malloc index->serials
+	if (index->offsets == NULL or index->serials == NULL)
+		return -2;
+	
+	const char* end = index->data + index->size;
+	for (const char* line = index->data; line < end; )
+	{
+		const char* eol = (const char*)memchr(line, '\n', end - line);
+		if (eol == NULL)
+			eol = end;
+		if (eol - line >= 5 and memcmp(line, "MODEL", 5) == 0 and (eol - line == 5 or line[5] == ' '))
+		{
+			if (index->models_len == cap)
+			{
+				cap *= 2;
+				size_t*       offsets = (size_t*)realloc(index->offsets, (cap + 1) * sizeof(size_t));
+				if (offsets != NULL)
+					index->offsets = offsets;
+				unsigned int* serials = (unsigned int*)realloc(index->serials, cap * sizeof(unsigned int));
+				if (serials != NULL)
+					index->serials = serials;
+				if (offsets == NULL or serials == NULL)
+					return -2;
+			}
+			index->offsets[index->models_len] = line - index->data;
+			index->serials[index->models_len] = __model_serial(line, eol - line);
+			++index->models_len;
+		}
+		line = eol + 1;
+	}
+	
+	// A file without MODEL records is one model.
+	if (index->models_len == 0)
+	{
+		index->offsets[0] = 0;
+		index->serials[0] = 1;
+		index->models_len = 1;
+	}
+	index->offsets[index->models_len] = index->size;
+	return index->models_len;
+}
+
+
+
+/* Map a structure file and index its models. Nothing is decoded until a model is asked for.
+ * Returns the number of models, or less than 0 on error (-1 could not open the file; -2 out of memory).
+ */
+int model_index_open(model_index_t* index, const char* filename)
+{
+	memset(index, 0, sizeof(model_index_t));
+	struct stat st;
+	index->data = map_file(filename, &st);
+	if (index->data == NULL)
+		return -1;
+	index->size     = (size_t)st.st_size;
+	index->seekable = (zstream_format(index->data, index->size) == ZFORMAT_NONE) \
+	                  and not is_cif(index->data, index->size);
+	
+	int e;
+	if (index->seekable)
+		e = _index_models(index);
+	else
+	{
+		index->offsets    = (size_t*)malloc(2 * sizeof(size_t));                 // malloc index->offsets
+		index->serials    = (unsigned int*)malloc(sizeof(unsigned int));         // malloc index->serials
+		index->models_len = 1;
+		e = (index->offsets == NULL or index->serials == NULL) ? -2 : 1;
+		if (e > 0)
+		{
+			index->offsets[0] = 0;
+			index->offsets[1] = index->size;
+			index->serials[0] = 1;
+		}
+	}
+	if (e < 0)
+		model_index_close(index);
+	return e;
+}
+
+
+
+/* Fetch a model by its position in the file, counting from 0, decoding it if it is not in the cache. The least
+ * recently used model is evicted to make room, so the chain returned stays valid until STARBOARD_MODELS_CACHE
+ * other models have been fetched. Its columns are built, and its atoms freed.
+ * Returns NULL if the model does not exist or could not be decoded.
+ */
+const chain_t* model_index_get(model_index_t* index, const unsigned int model)
+{
+	if (model >= index->models_len)
+		return NULL;
+	
+	// Look in the cache, and choose the slot used longest ago in case of a miss.
+	const unsigned long now    = ++index->clock;
+	model_slot_t*       victim = &index->cache[0];
+	for (unsigned int i = 0; i < STARBOARD_MODELS_CACHE; ++i)
+	{
+		model_slot_t* slot = &index->cache[i];
+		if (slot->used > 0 and slot->model == model)
+		{
+			slot->used = now;
+			return &slot->chain;
+		}
+		if (slot->used < victim->used)
+			victim = slot;
+	}
+	if (victim->used > 0)
+		chain_free_columns(&victim->chain);
+	victim->used = 0;
+	
+	// Decode just this model's range of the file.
+	chain_t*     chain = &victim->chain;
+	const size_t begin = index->offsets[model];
+	const size_t size  = index->offsets[model + 1] - begin;
+	int e = parse_pdb_mapped(chain, index->data + begin, size, 0); // malloc chain->atoms
+	if (e > 0)
+	{
+		e = chain_build_columns(chain); // malloc chain->cols.memory
+		free(chain->atoms);
+		chain->atoms = NULL;
+	}
+	else if (e == 0)
+	{
+		free(chain->atoms);
+		e = -1;
+	}
+	if (e < 0)
+	{
+		printf("[ERROR] %s %u: %i.\n", "Could not decode model", index->serials[model], e);
+		return NULL;
+	}
+	victim->model = model;
+	victim->used  = now;
+	return chain;
+}
+
+
+
+/* Free the cache and the index, and unmap the file.
+ */
+void model_index_close(model_index_t* index)
+{
+	for (unsigned int i = 0; i < STARBOARD_MODELS_CACHE; ++i)
+		if (index->cache[i].used > 0)
+			chain_free_columns(&index->cache[i].chain);
+	free(index->offsets);
+	free(index->serials);
+	if (index->data != NULL)
+		munmap((void*)index->data, index->size);
+	memset(index, 0, sizeof(model_index_t));
+}
@@ -0,0 +1,60 @@
+#ifndef STARBOARD_MODELS
+#define STARBOARD_MODELS
+
+#include <iso646.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pdb.h"
+
+
+//
+// An index of the models (MODEL ... ENDMDL) in an NMR ensemble or trajectory PDB file. One pass over the file
+// records where each model starts, and any model is then decoded on demand from its own range of the mapped
+// file. The most recently used decoded models are kept, so that stepping back and forth is cheap, while the
+// rest of the ensemble is never held in memory. Compressed and mmCIF files are not seekable in this way, and
+// are indexed as a single model.
+//
+
+#define STARBOARD_MODELS_CACHE 8    // Decoded models to keep.
+
+
+
+/* One decoded model, in the cache.
+ */
+typedef struct model_slot
+{
+	chain_t       chain;
+	unsigned int  model;
+	unsigned long used;    // When the model was last fetched, or 0 if the slot is empty.
+} model_slot_t;
+
+
+
+/* The index of the models in a mapped file.
+ */
+typedef struct model_index
+{
+	const char*   data;
+	size_t        size;
+	bool          seekable;
+	size_t*       offsets;     // Where each model's MODEL record starts, plus the end of the file.
+	unsigned int* serials;     // The serial number of each MODEL record.
+	unsigned int  models_len;
+	model_slot_t  cache[STARBOARD_MODELS_CACHE];
+	unsigned long clock;
+} model_index_t;
+
+
+
+extern int model_index_open(model_index_t*, const char*);
+
+extern const chain_t* model_index_get(model_index_t*, const unsigned int);
+
+extern void model_index_close(model_index_t*);
+
+#endif
@@ -1,5 +1,9 @@
+#include "models.h"
+#include "arena.h"
 #include "render.h"
 
+#include <stddef.h>
+
 
 
 /* This data type defines all the elements needed to construct a visual representation of a 
@@ -7,45 +11,250 @@
  */
 typedef struct monoview
 {
-	char*     name;
-	chain_t   chain;
-	curve_t   curve;
-	ribbon2_t ribbon;
+	char*          name;
+	char*          filename;
+	model_index_t* models;    // The models in the file, once indexed; its cache then owns the chain,
+	unsigned int   model;     // unless the chain has been copied to be moved.
+	bool           copied;    // Whether the chain is a copy of a model from the cache, which the object owns.
+	uint64_t*      selection;    // One bit per atom of the chain, from the `select` command.
+	unsigned int   selection_len;
+	curve_engine_t engine;       // How the backbone curve is drawn, from the `curve` command.
+	unsigned int   extrusion;    // Pieces a shader cuts each piece of the curve into, or 0 to build the ribbon
+	                             // here, from the `extrude` command.
+	char*          structure;    // DSSP class of each residue of the chain, or ' ' for none.
+	GLfloat*       assembly;     // The operators of the copies in the biological assembly, 16 floats each, from
+	unsigned int   assembly_len; // the BIOMT records of the file, or none.
+	bool           assembled;    // Whether every copy is drawn, from the `assembly` command, or just the chain.
+	chain_t        chain;
+	curve_t        curve;
+	ribbon2_t      ribbon;
+	arena_t        arena;        // Holds every array of the curve and ribbon.
 } monoview_t;
 
 
 
-/* TODO.
+// The shader programs that draw monomers, which main() creates: one for ribbons built here, and two that extrude
+// a ribbon and its outline from the points of its curve.
+GLuint MonoviewShader;
+GLuint MonoviewExtrusionShaders[2];
+
+// The shared buffers of the vertices of every monomer, packed or the points of curves, and a VAO over each.
+scene_buffer_t MonoviewVertices;
+scene_buffer_t MonoviewPoints;
+GLuint         MonoviewArrays[2];
+
+
+
+/* Free the curve and ribbon of a monomer, e.g. before building them again for another model. The arena is kept
+ * for the next build.
  */
-int monoview_to_drawable(monoview_t* view, drawable_t* draw)
+void monoview_free_geometry(monoview_t* view)
 {
-	if (draw->n != 2) return -1;
+	arena_reset(&view->arena);
+	memset(&view->curve,  0, sizeof(curve_t));
+	memset(&view->ribbon, 0, sizeof(ribbon2_t));
+}
+
+
+
+/* Free everything a monomer owns, including itself, e.g. when its object is removed.
+ */
+void monoview_free(monoview_t* view)
+{
+	arena_free(&view->arena);
+	if (view->models == NULL or view->copied)
+		chain_free_columns(&view->chain);
+	if (view->models != NULL)
+		model_index_close(view->models);    // The model cache owns its models.
+	free(view->models);
+	free(view->selection);
+	free(view->structure);
+	free(view->assembly);
+	free(view->filename);
+	free(view->name);
+	free(view);
+}
+
+
+
+/* Create the shared buffers of the vertices of monomers, and a VAO over each, which reads its indices from the
+ * shared element buffer. This is done once, after scene_initialize().
+ */
+void monoview_initialize(void)
+{
+	scene_buffer_create(&MonoviewVertices, sizeof(packed_vertex_t), 0);
+	scene_buffer_create(&MonoviewPoints,   sizeof(ribbon_point_t),  0);
+	glGenVertexArrays(2, MonoviewArrays);
 	
-	// Create a new VAO, then bind and upload the VBO, CBO, and EBO. 
-	glGenVertexArrays(1, &draw->vao[0]);
-	glBindVertexArray(draw->vao[0]);
-	buffer_elements(view->ribbon.element_components, view->ribbon.num_element_components, \
-	                &draw->ebo[0]);
-	draw->ebo_len[0] = view->ribbon.num_element_components;
-	buffer_vertices(view->ribbon.vertex_components, view->ribbon.num_vertex_components, \
-	                &draw->vbo[0]);
-	buffer_colors(view->ribbon.vertex_color_components, view->ribbon.num_vertex_color_components, \
-	              &draw->cbo[0]);
-	draw->element_class[0] = GL_TRIANGLES;
-	glBindVertexArray(0);
+	// Packed vertices: a quantized position, the residue, and the slot of the transform.
+	glBindVertexArray(MonoviewArrays[0]);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, SceneElements.buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, MonoviewVertices.buffer);
+	glVertexAttribPointer(0, 3, GL_SHORT, GL_FALSE, sizeof(packed_vertex_t), \
+	                      (GLvoid*)offsetof(packed_vertex_t, position));
+	glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(packed_vertex_t), \
+	                       (GLvoid*)offsetof(packed_vertex_t, residue));
+	glVertexAttribIPointer(2, 1, GL_UNSIGNED_SHORT, sizeof(packed_vertex_t), \
+	                       (GLvoid*)offsetof(packed_vertex_t, object));
+	for (unsigned int k = 0; k < 3; ++k)
+		glEnableVertexAttribArray(k);
 	
-	// Create a VAO for the outline too.
-	glGenVertexArrays(1, &draw->vao[1]);
-	glBindVertexArray(draw->vao[1]);
-	buffer_elements(view->ribbon.outline_element_components, view->ribbon.num_outline_element_components, \
-	                &draw->ebo[1]);
-	draw->ebo_len[1] = view->ribbon.num_outline_element_components;
-	draw->vbo[1] = draw->vbo[0];
-	glBindBuffer(GL_ARRAY_BUFFER, draw->vbo[1]);
-	buffer_colors(view->ribbon.outline_color_components, view->ribbon.num_outline_color_components, \
-	              &draw->cbo[1]);
-	draw->element_class[1] = GL_LINE_STRIP;
+	// The points of curves, for the shaders that extrude them.
+	glBindVertexArray(MonoviewArrays[1]);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, SceneElements.buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, MonoviewPoints.buffer);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ribbon_point_t), \
+	                      (GLvoid*)offsetof(ribbon_point_t, position));
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ribbon_point_t), \
+	                      (GLvoid*)offsetof(ribbon_point_t, normal));
+	glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(ribbon_point_t), \
+	                      (GLvoid*)offsetof(ribbon_point_t, pitch));
+	glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(ribbon_point_t), \
+	                       (GLvoid*)offsetof(ribbon_point_t, residue));
+	glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(ribbon_point_t), \
+	                       (GLvoid*)offsetof(ribbon_point_t, object));
+	for (unsigned int k = 0; k < 5; ++k)
+		glEnableVertexAttribArray(k);
 	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+
+/* Give vertices first to last of a monomer's ribbon, or its control points if the shaders extrude it, the slot of
+ * the transform of its drawable, before they are uploaded.
+ */
+static void _monoview_stamp(monoview_t* view, const drawable_t* draw, unsigned int first, unsigned int last)
+{
+	if (view->extrusion > 0)
+		for (unsigned int i = first; i <= last; ++i)
+			view->ribbon.control_points[i].object = draw->slot.first;
+	else
+		for (unsigned int i = first; i <= last; ++i)
+			view->ribbon.packed_vertices[i].object = (GLushort)draw->slot.first;
+}
+
+
+
+/* Build the tree of boxes of buffer i of a monomer's drawable, over the indices of its ribbon as they were built
+ * and the positions of the vertices they draw, or the points of its curve if the shaders extrude it; or, once it is
+ * built, find the boxes that draw vertices first to last again, after they have moved (see cull.h).
+ */
+static void _monoview_cull(const monoview_t* view, drawable_t* draw, unsigned int i, bool build, \
+                           unsigned int first, unsigned int last)
+{
+	const ribbon2_t* rib       = &view->ribbon;
+	const bool       extruded  = (view->extrusion > 0);
+	const GLuint*    indices   = extruded ? rib->control_element_components : \
+	                             (i == 0) ? rib->element_components : rib->outline_element_components;
+	const GLfloat*   positions = extruded ? rib->control_points[0].position : rib->vertex_components;
+	const size_t     stride    = extruded ? sizeof(ribbon_point_t) : \
+	                                        SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX * sizeof(GLfloat);
+	if (build)
+		cull_tree_build(&draw->cull[i], indices, draw->ebo_len[i], draw->element_class[i], positions, stride, \
+		                extruded ? &rib->control_points[0].residue : &rib->packed_vertices[0].residue, \
+		                extruded ? sizeof(ribbon_point_t) : sizeof(packed_vertex_t));
+	else
+		cull_tree_refit(&draw->cull[i], indices, positions, stride, first, last);
+}
+
+
+
+/* Upload the geometry of a monomer's ribbon to a drawable of two buffers, the ribbon and its outline, either as the
+ * vertices built here or as the points of its curve for shaders to extrude. Both buffers draw the same vertices,
+ * as strips, with indices as narrow as the number of vertices allows, and each looks up the colours of the
+ * residues, of the ribbon or of its outline, in a range of its own, and their attributes in one they share. Every
+ * range is of a buffer that all monomers share, and each buffer's indices get a tree of boxes, to be culled by.
+ * If the monomer's assembly is shown, its drawable gets the operators of the copies, which every draw draws.
+ * Returns 0, or -1 if there is no room.
+ */
+int monoview_to_drawable(monoview_t* view, drawable_t* draw)
+{
+	if (draw->n != 2) return -1;
+	const ribbon2_t*   rib      = &view->ribbon;
+	const bool         extruded = (view->extrusion > 0);
+	const unsigned int residues = view->curve.residues_len;
+	const unsigned int count    = extruded ? rib->num_control_points : rib->num_vertices;
+	const GLenum       type     = element_type(count);
+	if (count > 0)
+		_monoview_stamp(view, draw, 0, count - 1);
+	draw->vertex_buffer = extruded ? &MonoviewPoints : &MonoviewVertices;
+	int e = buffer_vertices(draw->vertex_buffer, extruded ? (void*)rib->control_points : \
+	                                                        (void*)rib->packed_vertices, count, &draw->vertices);
 	
-	return 0;
+	GLuint*      indices[2] = {rib->element_components, rib->outline_element_components};
+	unsigned int lengths[2] = {rib->num_element_components, rib->num_outline_element_components};
+	vec4*        colors[2]  = {rib->residue_colors, rib->outline_colors};
+	static const GLint CLASSES[2] = {GL_TRIANGLE_STRIP, GL_LINE_STRIP};
+	for (unsigned int i = 0; i < 2 and e >= 0; ++i)
+	{
+		if (extruded and i == 1)
+			draw->elements[i] = draw->elements[0];    // The outline is extruded from the same points.
+		else if (extruded)
+			e = buffer_elements(rib->control_element_components, rib->num_control_element_components, type, \
+			                    &draw->elements[i]);
+		else
+			e = buffer_elements(indices[i], lengths[i], type, &draw->elements[i]);
+		if (e >= 0)
+			e = buffer_colors((GLfloat*)colors[i], residues, &draw->colors[i]);
+		draw->vao[i]           = MonoviewArrays[extruded ? 1 : 0];
+		draw->ebo_len[i]       = extruded ? rib->num_control_element_components : lengths[i];
+		draw->element_class[i] = extruded ? GL_LINE_STRIP_ADJACENCY : CLASSES[i];
+		draw->element_type[i]  = type;
+		draw->shader[i]        = extruded ? MonoviewExtrusionShaders[i] : MonoviewShader;
+		draw->outline[i]       = (i == 1);
+		if (e >= 0 and count > 0)
+			_monoview_cull(view, draw, i, true, 0, 0);
+	}
+	if (e >= 0)
+		e = buffer_attributes((GLuint*)rib->residue_attributes, residues, &draw->attributes);
+	if (extruded)
+	{
+		draw->subdivisions = view->extrusion;
+		#ifdef DEBUG
+		printf("[DEBUG] %s: %u control points, %u residues.\n", "Buffered ribbon for extrusion", count, residues);
+		#endif
+	}
+	else
+		draw->bounds = rib->bounds;
+	buffer_transform(draw);
+	if (e < 0)
+		printf("[ERROR] %s.\n", "There is no room on the GPU for the ribbon");
+	else if (view->assembled and buffer_operators(view->assembly, view->assembly_len, draw) < 0)
+		printf("[ERROR] %s.\n", "There is no room on the GPU for the assembly, so the chain is drawn once");
+	return e;
+}
+
+
+
+/* Upload vertices first to last of a monomer's ribbon, or its control points if the shaders extrude it, and the
+ * colours of residues first_residue to last_residue, or either, over those in its drawable, after they have been
+ * rebuilt in place. The boxes around moved vertices are found again.
+ */
+void monoview_patch_drawable(monoview_t* view, drawable_t* draw, unsigned int first, unsigned int last, \
+                             unsigned int first_residue, unsigned int last_residue, bool vertices, bool colors)
+{
+	if (vertices)
+	{
+		_monoview_stamp(view, draw, first, last);
+		scene_buffer_upload(draw->vertex_buffer, draw->vertices.first + first, last - first + 1, \
+		                    (view->extrusion > 0) ? (void*)(view->ribbon.control_points + first) : \
+		                                            (void*)(view->ribbon.packed_vertices + first));
+		for (unsigned int i = 0; i < draw->n; ++i)
+			_monoview_cull(view, draw, i, false, first, last);
+	}
+	if (colors)
+		rebuffer_colors(draw->colors[0], (GLfloat*)view->ribbon.residue_colors, first_residue, \
+		                last_residue - first_residue + 1);
+}
+
+
+
+/* Upload the attributes of residues first to last of a monomer over those in its drawable, after their colour
+ * maps or styles have changed. Nothing else is uploaded.
+ */
+void monoview_patch_attributes(monoview_t* view, drawable_t* draw, unsigned int first, unsigned int last)
+{
+	if (first <= last)
+		rebuffer_attributes(draw->attributes, (GLuint*)view->ribbon.residue_attributes, first, last - first + 1);
 }
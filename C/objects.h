@@ -1,9 +1,11 @@
 #include "engine.h"
 #include "render.h"
 
+#include <stdint.h>
 
-// This defines a hard limit on the maximum renderable objects displayed at once in Starboard.
-#define STARBOARD_OBJS_MAX 1024
+
+// The slots that the list of objects has room for to begin with. It grows as it fills, without limit.
+#define STARBOARD_OBJS_MIN 64
 
 
 
@@ -25,13 +27,55 @@ void objclass2string(objclass_t c, char* s)
 
 
 //
-// TODO.
+// The objects to render are kept in slots, which are reused once their objects are deleted. An object is known by
+// its id, which `status` lists and commands take: its slot, and in the high 32 bits the generation of the slot,
+// i.e. how many objects have been deleted from it before, so that the id of a deleted object never names whatever
+// takes its slot next. Adding and deleting an object take constant time, and no other object's slot changes.
 //
 
-void*        RenderObjs[STARBOARD_OBJS_MAX];
-objclass_t   RenderObjClasses[STARBOARD_OBJS_MAX];
-drawable_t*  RenderObjDrawables[STARBOARD_OBJS_MAX];
-unsigned int RenderObjsLen;
+typedef uint64_t object_id_t;
+
+void**        RenderObjs;              // By slot, or NULL for a slot not in use.
+objclass_t*   RenderObjClasses;
+drawable_t**  RenderObjDrawables;
+uint32_t*     RenderObjGenerations;
+unsigned int  RenderObjsEnd;           // Slots up to the end of the last that has been used.
+unsigned int  RenderObjsCap;
+unsigned int* RenderObjsFree;          // Slots below the end that are not in use, the last freed last.
+unsigned int  RenderObjsFreeLen;
+unsigned int  RenderObjsLen;           // Objects, i.e. slots in use.
+
+// The draws of every buffer that is drawn alike, i.e. with the same shader, VAO, class and type of primitive, and
+// colours, which one call makes, however many objects they are of.
+#define STARBOARD_BATCHES_MAX 16
+typedef struct draw_batch
+{
+	GLuint   shader;
+	GLuint   vao;
+	GLint    element_class;
+	GLenum   element_type;
+	GLint    outline;
+	GLsizei* counts;
+	GLvoid** offsets;          // Of the first index of each draw, in bytes into SceneElements.
+	GLint*   base_vertices;    // Of each draw, which its indices count from.
+	GLint*   instance_firsts;  // Of each draw, where the operators of its copies are listed, or -1 for none.
+	GLsizei* instances;        // Of each draw, how many copies it draws.
+	unsigned int len;
+	unsigned int cap;
+} draw_batch_t;
+
+draw_batch_t RenderBatches[STARBOARD_BATCHES_MAX];
+unsigned int RenderBatchesLen;
+
+// The ranges of indices of a buffer that are in view, which draw_object() finds, kept from frame to frame.
+scene_range_t* RenderRanges;
+unsigned int   RenderRangesCap;
+
+// The operators of the copies in view, by their place in SceneOperators, which draws of several copies list, and
+// draw_batches() uploads (see scene.h).
+GLuint*        RenderInstances;
+unsigned int   RenderInstancesLen;
+unsigned int   RenderInstancesCap;
 
 
 
@@ -43,67 +87,280 @@ void initialize_objects()
 	if (not RenderObjsInitialised)
 	{
 		RenderObjsInitialised = true;
-		RenderObjsLen = 0;
+		RenderObjs           = NULL;
+		RenderObjClasses     = NULL;
+		RenderObjDrawables   = NULL;
+		RenderObjGenerations = NULL;
+		RenderObjsFree       = NULL;
+		RenderObjsEnd        = 0;
+		RenderObjsCap        = 0;
+		RenderObjsFreeLen    = 0;
+		RenderObjsLen        = 0;
+		RenderBatchesLen     = 0;
+		RenderRanges         = NULL;
+		RenderRangesCap      = 0;
+		RenderInstances      = NULL;
+		RenderInstancesLen   = 0;
+		RenderInstancesCap   = 0;
+		scene_initialize();
 	}
 }
 
 
 
 
-/* TODO.
+/* Make room for twice as many slots, or the first of them.
+ * Returns 0, or -1 if there is no memory, in which case the slots are as they were.
  */
-int add_object(void* object, objclass_t object_class, drawable_t* object_drawable)
+static int _grow_objects(void)
 {
-	// Test for segfaults on RenderObjs before they happen.
-	if (RenderObjsLen == STARBOARD_OBJS_MAX)
+	const unsigned int cap = (RenderObjsCap > 0) ? 2 * RenderObjsCap : STARBOARD_OBJS_MIN;
+	void**       objs        = (void**      )realloc(RenderObjs,           cap * sizeof(void*));
+	if (objs != NULL)
+		RenderObjs = objs;
+	objclass_t*  classes     = (objclass_t* )realloc(RenderObjClasses,     cap * sizeof(objclass_t));
+	if (classes != NULL)
+		RenderObjClasses = classes;
+	drawable_t** drawables   = (drawable_t**)realloc(RenderObjDrawables,   cap * sizeof(drawable_t*));
+	if (drawables != NULL)
+		RenderObjDrawables = drawables;
+	uint32_t*    generations = (uint32_t*   )realloc(RenderObjGenerations, cap * sizeof(uint32_t));
+	if (generations != NULL)
+		RenderObjGenerations = generations;
+	unsigned int* free_slots = (unsigned int*)realloc(RenderObjsFree,      cap * sizeof(unsigned int));
+	if (free_slots != NULL)
+		RenderObjsFree = free_slots;
+	if (objs == NULL or classes == NULL or drawables == NULL or generations == NULL or free_slots == NULL)
 		return -1;
-	
-	// Add the object to the RenderObjs array.
-	RenderObjs[RenderObjsLen] = object;
-	RenderObjClasses[RenderObjsLen] = object_class;
-	RenderObjDrawables[RenderObjsLen] = object_drawable;
+	RenderObjsCap = cap;
+	return 0;
+}
+
+
+
+/* Add an object and its drawable to the list of objects to render, in a slot that is not in use, which the list
+ * then owns.
+ * Returns the slot, or -1 if there is no memory.
+ */
+int add_object(void* object, objclass_t object_class, drawable_t* object_drawable)
+{
+	unsigned int slot;
+	if (RenderObjsFreeLen > 0)
+		slot = RenderObjsFree[--RenderObjsFreeLen];
+	else
+	{
+		if (RenderObjsEnd == RenderObjsCap and _grow_objects() < 0)
+			return -1;
+		slot = RenderObjsEnd++;
+		RenderObjGenerations[slot] = 0;
+	}
+	RenderObjs[slot]         = object;
+	RenderObjClasses[slot]   = object_class;
+	RenderObjDrawables[slot] = object_drawable;
 	++RenderObjsLen;
-	return RenderObjsLen - 1;
+	return slot;
 }
 
 
 
-/* TODO.
+/* Find the id of the object in a slot.
  */
-int del_object(unsigned int index)
+object_id_t object_id(unsigned int slot)
 {
-	// We can't delete an object if it isn't within the bounds of the list.
-	if (index >= RenderObjsLen)
+	return ((object_id_t)RenderObjGenerations[slot] << 32) | slot;
+}
+
+
+
+/* Find the slot of an object from its id, if it is still in the list and of the given class.
+ * Returns 0, or -1 if there is no such object.
+ */
+int find_object(object_id_t id, objclass_t object_class, unsigned int* slot_out)
+{
+	const unsigned int slot = (unsigned int)(id & 0xFFFFFFFF);
+	if (slot >= RenderObjsEnd or RenderObjs[slot] == NULL or (uint32_t)(id >> 32) != RenderObjGenerations[slot] \
+	    or RenderObjClasses[slot] != object_class)
 		return -1;
-	
-	// Delete the object and shift the array down one index.
-	for (unsigned int i = index + 1; i < RenderObjsLen; ++i)
+	*slot_out = slot;
+	return 0;
+}
+
+
+
+/* Remove the object in a slot from the list, and free its drawable, giving its ranges back to the buffers that
+ * objects share. The object itself is the caller's to free, e.g. with monoview_free(), beforehand. No other object
+ * moves, and the slot is kept for the next object added.
+ * Returns 0, or -1 if the slot is not in use.
+ */
+int del_object(unsigned int slot)
+{
+	if (slot >= RenderObjsEnd or RenderObjs[slot] == NULL)
+		return -1;
+	free_drawable_buffers(RenderObjDrawables[slot]);
+	free(RenderObjDrawables[slot]);
+	RenderObjs[slot]         = NULL;
+	RenderObjDrawables[slot] = NULL;
+	++RenderObjGenerations[slot];
+	RenderObjsFree[RenderObjsFreeLen++] = slot;    // There is room for every slot.
+	--RenderObjsLen;
+	return 0;
+}
+
+
+
+/* Add a draw to the batch of those drawn alike, e.g. a buffer of an object, of a number of copies whose operators
+ * are listed from instance_first in RenderInstances, or of one as it is if that is -1.
+ * Returns 0, or -1 if there are too many batches, or no memory for the draw.
+ */
+static int _queue_draw(GLuint shader, GLuint vao, GLint element_class, GLenum element_type, GLint outline, \
+                       GLsizei count, size_t offset, GLint base_vertex, GLint instance_first, GLsizei instances)
+{
+	draw_batch_t* batch = NULL;
+	for (unsigned int b = 0; b < RenderBatchesLen and batch == NULL; ++b)
 	{
-		RenderObjs[i - 1]         = RenderObjs[i];
-		RenderObjClasses[i - 1]   = RenderObjClasses[i];
-		RenderObjDrawables[i - 1] = RenderObjDrawables[i];
+		draw_batch_t* other = &RenderBatches[b];
+		if (other->shader == shader and other->vao == vao and other->element_class == element_class and \
+		    other->element_type == element_type and other->outline == outline)
+			batch = other;
 	}
-	--RenderObjsLen;
+	if (batch == NULL)
+	{
+		if (RenderBatchesLen == STARBOARD_BATCHES_MAX)
+			return -1;
+		batch = &RenderBatches[RenderBatchesLen++];
+		batch->shader        = shader;
+		batch->vao           = vao;
+		batch->element_class = element_class;
+		batch->element_type  = element_type;
+		batch->outline       = outline;
+		batch->len           = 0;
+	}
+	if (batch->len == batch->cap)
+	{
+		// The arrays are kept from frame to frame, so they grow only until they hold the whole scene.
+		const unsigned int cap           = (batch->cap > 0) ? 2 * batch->cap : 64;
+		GLsizei*           counts        = (GLsizei*)realloc(batch->counts,        cap * sizeof(GLsizei));
+		if (counts != NULL)
+			batch->counts = counts;
+		GLvoid**           offsets       = (GLvoid**)realloc(batch->offsets,       cap * sizeof(GLvoid*));
+		if (offsets != NULL)
+			batch->offsets = offsets;
+		GLint*             base_vertices = (GLint*  )realloc(batch->base_vertices, cap * sizeof(GLint));
+		if (base_vertices != NULL)
+			batch->base_vertices = base_vertices;
+		GLint*             firsts        = (GLint*  )realloc(batch->instance_firsts, cap * sizeof(GLint));
+		if (firsts != NULL)
+			batch->instance_firsts = firsts;
+		GLsizei*           copies        = (GLsizei*)realloc(batch->instances,     cap * sizeof(GLsizei));
+		if (copies != NULL)
+			batch->instances = copies;
+		if (counts == NULL or offsets == NULL or base_vertices == NULL or firsts == NULL or copies == NULL)
+			return -1;
+		batch->cap = cap;
+	}
+	batch->counts[batch->len]          = count;
+	batch->offsets[batch->len]         = (GLvoid*)offset;
+	batch->base_vertices[batch->len]   = base_vertex;
+	batch->instance_firsts[batch->len] = instance_first;
+	batch->instances[batch->len]       = instances;
+	++batch->len;
 	return 0;
 }
 
 
 
-/* TODO.
+/* Order batches so that outlines come after what they outline, as they did when each object was drawn on its own,
+ * then by class of primitive, then shader, then whatever else they differ by, so that state changes as little as
+ * it can between them.
+ */
+static int _compare_batches(const void* a, const void* b)
+{
+	const draw_batch_t* A = (const draw_batch_t*)a;
+	const draw_batch_t* B = (const draw_batch_t*)b;
+	if (A->outline       != B->outline)       return (A->outline       < B->outline)       ? -1 : 1;
+	if (A->element_class != B->element_class) return (A->element_class < B->element_class) ? -1 : 1;
+	if (A->shader        != B->shader)        return (A->shader        < B->shader)        ? -1 : 1;
+	if (A->vao           != B->vao)           return (A->vao           < B->vao)           ? -1 : 1;
+	if (A->element_type  != B->element_type)  return (A->element_type  < B->element_type)  ? -1 : 1;
+	return 0;
+}
+
+
+
+/* Draw every batch that draw_object() has added to, with a call for each, and one more for each draw of several
+ * copies, and empty them.
+ * Returns the number of calls made.
  */
-int draw_object(unsigned int index)
+unsigned int draw_batches(void)
 {
-	if (index >= RenderObjsLen)
+	if (RenderInstancesLen > 0)
+		scene_upload_instances(RenderInstances, RenderInstancesLen);
+	RenderInstancesLen = 0;
+	qsort(RenderBatches, RenderBatchesLen, sizeof(draw_batch_t), _compare_batches);
+	unsigned int calls = 0;
+	for (unsigned int b = 0; b < RenderBatchesLen; ++b)
+	{
+		draw_batch_t* batch = &RenderBatches[b];
+		if (batch->len == 0)
+			continue;
+		if (calls == 0 or batch->shader != Shader)
+			engine_use_shader(batch->shader);
+		glUniform1i(shader_uniforms(Shader)[SHADER_UNIFORM_OUTLINE], batch->outline);
+		
+		// The restart index is the largest value of the type of the indices, so it changes with their width. It is
+		// compared with indices before the base vertex is added to them.
+		static GLenum restart_type = GL_UNSIGNED_INT;
+		if (batch->element_type != restart_type)
+		{
+			restart_type = batch->element_type;
+			glPrimitiveRestartIndex(element_restart(restart_type));
+		}
+		glBindVertexArray(batch->vao);
+		
+		// A draw of copies is a call of its own, whose shaders find the operator of each copy from where they are
+		// listed, and it draws nothing in the call that makes the rest of the batch.
+		const GLint  first  = shader_uniforms(Shader)[SHADER_UNIFORM_INSTANCE_FIRST];
+		unsigned int singles = batch->len;
+		for (unsigned int k = 0; k < batch->len; ++k)
+			if (batch->instance_firsts[k] >= 0)
+			{
+				glUniform1i(first, batch->instance_firsts[k]);
+				glDrawElementsInstancedBaseVertex(batch->element_class, batch->counts[k], batch->element_type, \
+				                                  batch->offsets[k], batch->instances[k], batch->base_vertices[k]);
+				batch->counts[k] = 0;
+				--singles;
+				++calls;
+			}
+		glUniform1i(first, -1);
+		if (singles > 0)
+		{
+			glMultiDrawElementsBaseVertex(batch->element_class, batch->counts, batch->element_type, \
+			                              (const GLvoid* const*)batch->offsets, batch->len, batch->base_vertices);
+			++calls;
+		}
+		batch->len = 0;
+	}
+	glBindVertexArray(0);
+	return calls;
+}
+
+
+
+/* Add the buffers of an object to the batches that draw_batches() draws, by which every object whose buffers are
+ * drawn alike is drawn by the same calls. Its vertices find its transform, and the colours and attributes of their
+ * residues, by its slot (see buffer_transform()), so nothing is set for each object. Only the ranges of its
+ * buffers whose boxes are in the view frustum of the camera's view-projection matrix are added (see cull.h), and
+ * if it has copies, only the copies that any of those are in view in.
+ */
+int draw_object(unsigned int index, const GLfloat view_projection[16])
+{
+	if (index >= RenderObjsEnd or RenderObjs[index] == NULL)
 		return -1;
 	
 	drawable_t* obj_draw  = RenderObjDrawables[index];
 	objclass_t  obj_class = RenderObjClasses[index]; 
 	
-	// Once per drawable, we need to load the model matrix into the shader.
-	GLint model_variable = glGetUniformLocation(Shader, "model");
-	glUniformMatrix4fv(model_variable, 1, GL_FALSE, obj_draw->model_matrix_components);
-	
-	// Set certain OpenGL flags that depend on object type.
+	// Set certain OpenGL flags that depend on object type, which are the same for every object of the type.
 	switch (obj_class)
 	{
 		case MONOVIEW:
@@ -112,21 +369,80 @@ int draw_object(unsigned int index)
 		break;
 	}
 	
-	// Iterate over the drawable's buffers.
+	// Iterate over the drawable's buffers, and the ranges of each that are in view, or all of it if it has no boxes.
+	// Each copy is culled with the frustum in its own space, and listed if any of the buffer is in view in it, and
+	// the ranges in view in any copy are drawn in every copy listed.
+	const bool         copied = (obj_draw->instances.count > 0);
+	const unsigned int copies = copied ? obj_draw->instances.count : 1;
 	for (unsigned int i = 0; i < obj_draw->n; ++i)
 	{
-		glBindVertexArray(obj_draw->vao[i]);
-		glDrawElements(obj_draw->element_class[i], obj_draw->ebo_len[i], GL_UNSIGNED_INT, (GLvoid*)0);
-		glBindVertexArray(0);
+		if (obj_draw->ebo_len[i] == 0)
+			continue;
+		const cull_tree_t* tree   = &obj_draw->cull[i];
+		const unsigned int leaves = (tree->len > 0) ? (tree->len + 1) / 2 : 1;
+		if (copies * leaves > RenderRangesCap)
+		{
+			scene_range_t* ranges = (scene_range_t*)realloc(RenderRanges, copies * leaves * sizeof(scene_range_t));
+			if (ranges == NULL)
+				return -2;
+			RenderRanges    = ranges;
+			RenderRangesCap = copies * leaves;
+		}
+		if (copied and RenderInstancesLen + copies > RenderInstancesCap)
+		{
+			const unsigned int cap    = 2 * (RenderInstancesLen + copies);
+			GLuint*            listed = (GLuint*)realloc(RenderInstances, cap * sizeof(GLuint));
+			if (listed == NULL)
+				return -2;
+			RenderInstances    = listed;
+			RenderInstancesCap = cap;
+		}
+		const GLint  first      = copied ? (GLint)RenderInstancesLen : -1;
+		unsigned int in_view    = 0;
+		unsigned int ranges_len = 0;
+		for (unsigned int c = 0; c < copies; ++c)
+		{
+			unsigned int found = 1;
+			RenderRanges[ranges_len].first = 0;
+			RenderRanges[ranges_len].count = obj_draw->ebo_len[i];
+			if (tree->len > 0)
+			{
+				cull_frustum_t frustum;
+				cull_frustum(view_projection, obj_draw->model_matrix_components, \
+				             copied ? obj_draw->operators + 16 * c : NULL, &frustum);
+				found = cull_tree_visible(tree, &frustum, RenderRanges + ranges_len);
+			}
+			if (found == 0)
+				continue;
+			ranges_len += found;
+			if (copied)
+				RenderInstances[RenderInstancesLen++] = obj_draw->instances.first + c;
+			++in_view;
+		}
+		if (copied)
+			ranges_len = cull_ranges_join(RenderRanges, ranges_len);
+		const size_t width = (obj_draw->element_type[i] == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+		for (unsigned int r = 0; r < ranges_len; ++r)
+			if (_queue_draw(obj_draw->shader[i], obj_draw->vao[i], obj_draw->element_class[i], \
+			                obj_draw->element_type[i], obj_draw->outline[i], RenderRanges[r].count, \
+			                obj_draw->elements[i].first * SceneElements.unit + RenderRanges[r].first * width, \
+			                (GLint)obj_draw->vertices.first, first, (GLsizei)in_view) < 0)
+				return -3;
 	}
+	return 0;
 }
 
 
 
-/* TODO.
+/* Draw every object in the list that is in view of a camera, by its view-projection matrix, in as few calls as they
+ * can be batched into.
+ * Returns the number of calls made.
  */
-void draw_all_objects(void)
+unsigned int draw_all_objects(const GLfloat view_projection[16])
 {
-	for (unsigned int i = 0; i < RenderObjsLen; ++i)
-		draw_object(i);
+	scene_bind_textures();
+	for (unsigned int i = 0; i < RenderObjsEnd; ++i)
+		if (RenderObjs[i] != NULL)
+			draw_object(i, view_projection);
+	return draw_batches();
 }
@@ -1,4 +1,7 @@
 #include "pdb.h"
+#include "sbc.h"
+#include "cif.h"
+#include "zstream.h"
 
 
 
@@ -108,7 +111,7 @@ static inline int _parse_atom_record_line(atom_t* out, const char* line)
 	}
 
 	// Attempt to populate the given atom structure.
-	if (__get_field(&out->id, line, 0, 6))
+	if (__get_field(&out->id, line, 6, 5))
 		return -2;
 	if (__get_field(&out->res_id, line, 22, 4))
 		return -3;
@@ -116,6 +119,12 @@ static inline int _parse_atom_record_line(atom_t* out, const char* line)
 		return -4;
 	if (__get_field((char*)out->type, line, 12, 4))
 		return -5;
+	if (__get_field((char*)out->chain, line, 21, 1))
+		return -5;
+	char icode[2];
+	if (__get_field((char*)icode, line, 26, 1))
+		return -5;
+	out->icode = icode[0];
 	if (__get_field(&out->x, line, 30, 8))
 		return -6;
 	if (__get_field(&out->y, line, 38, 8))
@@ -127,10 +136,23 @@ static inline int _parse_atom_record_line(atom_t* out, const char* line)
 
 
 
-/* Parse a PDB file into an array of atom structures. 
+/* Mark a chain as having no columns or residues yet, as every reader does before it fills in the atoms, so that
+ * chain_build_columns() builds them.
  */
-int parse_pdb(chain_t* chain, const char* filename)
+static inline void _chain_clear_columns(chain_t* chain)
+{
+	memset(&chain->cols, 0, sizeof(columns_t));
+	memset(&chain->residues, 0, sizeof(residues_t));
+}
+
+
+
+/* Parse a PDB file into an array of atom structures, one line at a time through stdio.
+ * REMARK. This is the original reader; parse_pdb() supersedes it, and it is kept as a reference for benchmarking.
+ */
+int parse_pdb_stdio(chain_t* chain, const char* filename)
 {
+	_chain_clear_columns(chain);
 	FILE* fp = fopen(filename, "r");
 	if (fp == NULL)
 		return -1;
@@ -154,7 +176,9 @@ int parse_pdb(chain_t* chain, const char* filename)
 	{
 		// Attempt to parse line as an atom record, skipping on error. 
 		e = _parse_atom_record_line(&out, line);
-		if (e == 1)
+		if (e == 1 and strncmp(line, "ENDMDL", 6) == 0)    // Only read the first model.
+			break;
+		else if (e == 1)
 			continue;
 		else if (e < 0)
 		{
@@ -185,46 +209,595 @@ int parse_pdb(chain_t* chain, const char* filename)
 }
 
 
+/* Decode an unsigned integer from a fixed-width column in place. Blanks are skipped.
+ * Returns: 0 success; -1 a character other than a digit or blank; -2 out of range.
+ */
+static inline int __scan_ui(unsigned int* out, const char* p, const unsigned int len)
+{
+	unsigned long v = 0;
+	for (unsigned int i = 0; i < len; ++i)
+	{
+		const unsigned int d = (unsigned int)(unsigned char)p[i] - '0';
+		if (d < 10)
+			v = 10 * v + d;
+		else if (p[i] != ' ')    // Also rejects a minus sign, as __get_field_ui() does.
+			return -1;
+	}
+	if (v > INT_MAX)
+		return -2;
+	*out = (unsigned int)v;
+	return 0;
+}
+
+
 
-/*
+/* Decode a PDB coordinate column, which is Fortran F8.3, in place as a fixed-point number.
+ * The digits are accumulated as an integer and divided by a power of ten once, which rounds exactly as strtof()
+ * does for the 24 bits of precision that an 8 character column can hold.
+ * Returns: 0 success; -1 malformed column.
  */
-static inline bool __startswith(const char* a, const char* b)
+static inline int __scan_fixed83(float* out, const char* p)
 {
-	unsigned int len = strlen(b);
-	return strncmp(a, b, len);
+	static const float POW10[8] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7};
+	
+	unsigned int i = 0;
+	while (i < 8 and p[i] == ' ')    // Leading blanks are padding.
+		++i;
+	bool negative = false;
+	if (i < 8 and p[i] == '-')
+	{
+		negative = true;
+		++i;
+	}
+	
+	// Accumulate digits on both sides of the point, counting the digits after it.
+	unsigned int v        = 0;
+	unsigned int decimals = 0;
+	bool         point    = false;
+	bool         digits   = false;
+	for (; i < 8 and p[i] != ' '; ++i)
+	{
+		const unsigned int d = (unsigned int)(unsigned char)p[i] - '0';
+		if (d < 10)
+		{
+			v = 10 * v + d;
+			decimals += point;
+			digits = true;
+		}
+		else if (p[i] == '.' and not point)
+			point = true;
+		else
+			return -1;
+	}
+	if (not digits)
+		return -1;
+	
+	const float f = (float)v / POW10[decimals];
+	*out = negative ? -f : f;
+	return 0;
 }
 
 
 
-/*
+/* Populate an atom structure from a PDB ATOM record, reading the fixed columns directly from the line.
+ * Returns: +1 not ATOM record; 0 success; less than 0 error (same codes as _parse_atom_record_line()).
  */
-static inline bool _atom_match(const atom_t a, const unsigned int id, const unsigned int res_id, \
-                               const char* res_type, const char* type)
+static inline int _scan_atom_record(atom_t* out, const char* line, const size_t len)
 {
-	// Return false if any conditions fail; return true if they all pass.
-	if (id > 0 and a.id != id)    // Make sure the atom ID matches.
-		return false;
-	if (res_id > 0 and a.res_id != res_id)    // Residue ID.
-		return false;
-	if (strlen(res_type) > 0 and __startswith(a.res_type, res_type))    // Residue type.
-		return false;
-	if (strlen(type) > 0 and __startswith(a.type, type))    // Atom type.
-		return false;
-	return true;
+	// The record name is "ATOM" padded with blanks to six columns.
+	if (len < 4 or memcmp(line, "ATOM", 4) != 0)
+		return 1;
+	if ((len > 4 and line[4] != ' ') or (len > 5 and line[5] != ' '))
+		return 1;
+	if (len < 54)    // Too short to hold the coordinates.
+		return -1;
+	
+	if (__scan_ui(&out->id, line + 6, 5))
+		return -2;
+	if (__scan_ui(&out->res_id, line + 22, 4))
+		return -3;
+	
+	// Names are left-justified after trimming, so copy the non-blank run and terminate it.
+	unsigned int j = 0;
+	for (unsigned int i = 17; i < 20; ++i)
+		if (line[i] != ' ')
+			out->res_type[j++] = line[i];
+	out->res_type[j] = '\0';
+	j = 0;
+	for (unsigned int i = 12; i < 16; ++i)
+		if (line[i] != ' ')
+			out->type[j++] = line[i];
+	out->type[j] = '\0';
+	out->chain[0] = (line[21] != ' ') ? line[21] : '\0';
+	out->chain[1] = '\0';
+	out->icode    = (line[26] != ' ') ? line[26] : '\0';
+	
+	if (__scan_fixed83(&out->x, line + 30))
+		return -6;
+	if (__scan_fixed83(&out->y, line + 38))
+		return -7;
+	if (__scan_fixed83(&out->z, line + 46))
+		return -8;
+	return 0;
 }
 
 
 
-/*
+/* Scan every line in [begin, end) and append the ATOM records to the chain's atom array, growing it as needed.
+ * Only the first model is read, so an ENDMDL record stops the scan and sets ended.
+ * Returns the number of atoms in the chain, or less than 0 on error.
+ */
+static int _scan_pdb_lines(chain_t* chain, unsigned int* atoms_cap, unsigned int* ignored, bool* ended, \
+                           const char* begin, const char* end)
+{
+	for (const char* line = begin; line < end; )
+	{
+		const char* eol = (const char*)memchr(line, '\n', end - line);
+		if (eol == NULL)    // The last line might not be terminated.
+			eol = end;
+		
+		// Make sure there is room for one more atom, then decode straight into it.
+		if (chain->atoms_len == *atoms_cap)
+		{
+			*atoms_cap *= 2;
+			atom_t* atoms = (atom_t*)realloc(chain->atoms, *atoms_cap * sizeof(atom_t));
+			if (atoms == NULL)
+				return -2;
+			chain->atoms = atoms;
+		}
+		int e = _scan_atom_record(&chain->atoms[chain->atoms_len], line, eol - line);
+		if (e == 0)
+			++chain->atoms_len;
+		else if (e == 1)
+		{
+			if (eol - line >= 6 and memcmp(line, "ENDMDL", 6) == 0)
+			{
+				*ended = true;
+				break;
+			}
+			++*ignored;
+		}
+		else
+			printf("[WARNING] %s: %i.\n", "Function _scan_atom_record failed with code", e);
+		
+		line = eol + 1;
+	}
+	return chain->atoms_len;
+}
+
+
+
+/* Describe one line-aligned piece of a mapped PDB file, and the block of atoms parsed from it.
+ */
+typedef struct pdb_chunk
+{
+	const char*  begin;
+	const char*  end;
+	chain_t      block;
+	unsigned int atoms_cap;
+	unsigned int ignored;
+	bool         ended;
+	int          e;
+} pdb_chunk_t;
+
+
+
+/* Thread entry point: parse one chunk into its own atom block.
+ */
+static void* _scan_pdb_chunk(void* arg)
+{
+	pdb_chunk_t* chunk = (pdb_chunk_t*)arg;
+	chunk->atoms_cap       = (chunk->end - chunk->begin) / 81 + 1024;
+	chunk->block.atoms     = (atom_t*)malloc(chunk->atoms_cap * sizeof(atom_t));    // malloc block.atoms
+	chunk->block.atoms_len = 0;
+	chunk->ignored         = 0;
+	chunk->ended           = false;
+	if (chunk->block.atoms == NULL)
+		chunk->e = -2;
+	else
+		chunk->e = _scan_pdb_lines(&chunk->block, &chunk->atoms_cap, &chunk->ignored, &chunk->ended, \
+		                           chunk->begin, chunk->end);
+	return NULL;
+}
+
+
+
+/* Parse a mapped PDB file with n threads. The data is split into n chunks at line boundaries, each thread
+ * parses one chunk into its own block, and the blocks are then stitched together in file order with a single
+ * copy, so the result is identical to parsing the file serially.
+ */
+static int _scan_pdb_parallel(chain_t* chain, const char* data, const size_t size, unsigned int n)
+{
+	pdb_chunk_t chunks[n];
+	pthread_t   threads[n];
+	
+	// Split at the first newline after each even division of the file.
+	const char* begin = data;
+	const char* end   = data + size;
+	for (unsigned int i = 0; i < n; ++i)
+	{
+		const char* split = (i == n - 1) ? end : data + size / n * (i + 1);
+		if (split < begin)
+			split = begin;
+		if (split < end)
+		{
+			const char* eol = (const char*)memchr(split, '\n', end - split);
+			split = (eol == NULL) ? end : eol + 1;
+		}
+		chunks[i].begin = begin;
+		chunks[i].end   = split;
+		begin           = split;
+	}
+	
+	// The calling thread takes the first chunk itself.
+	unsigned int started = 1;
+	for (unsigned int i = 1; i < n; ++i, ++started)
+		if (pthread_create(&threads[i], NULL, _scan_pdb_chunk, &chunks[i]))
+			break;
+	for (unsigned int i = started; i < n; ++i)    // If a thread could not be created, do its work here instead.
+		_scan_pdb_chunk(&chunks[i]);
+	_scan_pdb_chunk(&chunks[0]);
+	for (unsigned int i = 1; i < started; ++i)
+		pthread_join(threads[i], NULL);
+	
+	// Stitch the blocks together in file order, up to the end of the first model.
+	int          e       = 0;
+	unsigned int total   = 0;
+	unsigned int ignored = 0;
+	unsigned int used    = n;
+	for (unsigned int i = 0; i < used; ++i)
+	{
+		if (chunks[i].e < 0)
+			e = chunks[i].e;
+		total   += chunks[i].block.atoms_len;
+		ignored += chunks[i].ignored;
+		if (chunks[i].ended)
+			used = i + 1;
+	}
+	chain->atoms     = (e < 0) ? NULL : (atom_t*)malloc((total > 0 ? total : 1) * sizeof(atom_t));
+	chain->atoms_len = 0;                                                          // malloc chain->atoms
+	for (unsigned int i = 0; i < n; ++i)
+	{
+		if (chain->atoms != NULL and i < used)
+			memcpy(chain->atoms + chain->atoms_len, chunks[i].block.atoms, \
+			       chunks[i].block.atoms_len * sizeof(atom_t));
+		if (i < used)
+			chain->atoms_len += chunks[i].block.atoms_len;
+		free(chunks[i].block.atoms);
+	}
+	if (chain->atoms == NULL)
+		return (e < 0) ? e : -2;
+	printf("[DEBUG] %s: %u.\n", "Ignored non-ATOM records", ignored);
+	return chain->atoms_len;
+}
+
+
+
+/* Parse mapped PDB data into an array of atom structures, using the specified number of threads (0 to choose
+ * automatically).
+ */
+static int _parse_pdb_records(chain_t* chain, const char* data, const size_t size, unsigned int threads)
+{
+	// Small files are not worth the cost of starting threads. 
+	if (threads == 0)
+	{
+		long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (cores > 0) ? (unsigned int)cores : 1;
+		if (size < STARBOARD_PDB_PARALLEL_MIN_BYTES)
+			threads = 1;
+	}
+	if (threads > STARBOARD_PDB_THREADS_MAX)
+		threads = STARBOARD_PDB_THREADS_MAX;
+	if (threads > 1)
+		return _scan_pdb_parallel(chain, data, size, threads);
+	
+	// ATOM records are 81 bytes with their newline, so this usually avoids ever having to grow the array.
+	unsigned int atoms_cap = size / 81 + 1024;
+	unsigned int ignored   = 0;
+	chain->atoms     = (atom_t*)malloc(atoms_cap * sizeof(atom_t));    // malloc chain->atoms
+	chain->atoms_len = 0;
+	if (chain->atoms == NULL)
+		return -2;
+	bool ended = false;
+	int  e     = _scan_pdb_lines(chain, &atoms_cap, &ignored, &ended, data, data + size);
+	printf("[DEBUG] %s: %u.\n", "Ignored non-ATOM records", ignored);
+	return e;
+}
+
+
+
+/* Parse compressed PDB or mmCIF data into an array of atom structures. The data is decompressed on a producer
+ * thread into a ring of buffers, which this thread parses as they fill. A line split across two buffers is
+ * completed by copying its start into the headroom in front of the second, so every line is parsed in place.
+ * Returns the number of atoms, or less than 0 on error (-3 the data could not be decompressed).
+ */
+static int _parse_stream(chain_t* chain, const char* data, const size_t size, const zformat_t format)
+{
+	zstream_t z;
+	int e = zstream_open(&z, data, size, format);
+	if (e < 0)
+		return (e == -2) ? -2 : -3;
+	
+	cif_reader_t r;
+	bool         cif       = false;
+	bool         first     = true;
+	bool         ended     = false;
+	unsigned int atoms_cap = 0;
+	unsigned int ignored   = 0;
+	char         carry[STARBOARD_ZSTREAM_HEADROOM];
+	size_t       carry_len = 0;
+	char*        buffer;
+	size_t       len;
+	int          more;
+	do
+	{
+		more = zstream_next(&z, &buffer, &len);
+		if (more < 0)
+			break;
+		char*       begin = buffer - carry_len;
+		const char* end   = buffer + len;
+		memcpy(begin, carry, carry_len);
+		
+		// The format is only known once the first buffer is decompressed. Text structure files usually compress
+		// about four times, so size the atom array for that.
+		if (first)
+		{
+			const size_t guess = size / 20 + 1024;
+			atoms_cap = (guess < (1u << 26)) ? (unsigned int)guess : (1u << 26);
+			cif       = is_cif(begin, end - begin);
+			first     = false;
+			if (cif)
+				e = cif_reader_init(&r, chain, atoms_cap);
+			else
+			{
+				chain->atoms     = (atom_t*)malloc(atoms_cap * sizeof(atom_t));    // malloc chain->atoms
+				chain->atoms_len = 0;
+				e = (chain->atoms == NULL) ? -2 : 0;
+			}
+			if (e < 0)
+			{
+				zstream_release(&z);
+				break;
+			}
+		}
+		
+		// Parse the complete lines, and keep any partial line at the end for the next buffer.
+		const char* done;
+		if (cif)
+			done = begin + cif_feed(&r, chain, begin, end, more == 0);
+		else
+		{
+			done = end;
+			if (more > 0)
+			{
+				while (done > begin and done[-1] != '\n')
+					--done;
+			}
+			e = _scan_pdb_lines(chain, &atoms_cap, &ignored, &ended, begin, done);
+		}
+		carry_len = end - done;
+		if (carry_len > STARBOARD_ZSTREAM_HEADROOM)
+		{
+			printf("[WARNING] %s: %zu.\n", "Skipping line longer than", (size_t)STARBOARD_ZSTREAM_HEADROOM);
+			carry_len = 0;
+		}
+		memcpy(carry, done, carry_len);
+		zstream_release(&z);
+	}
+	while (more > 0 and e >= 0 and not ended and not (cif and r.state == CIF_DONE));
+	
+	// Stopping early (at the end of the first model, say) abandons the rest of the stream.
+	int f = zstream_close(&z);
+	if (cif and r.e == -9)
+		e = -2;
+	if (e >= 0 and f < 0)
+	{
+		printf("[ERROR] %s: %i.\n", "Decompression failed with code", f);
+		e = -3;
+	}
+	if (e < 0)
+	{
+		if (not first)
+			free(chain->atoms);
+		chain->atoms     = NULL;
+		chain->atoms_len = 0;
+		return e;
+	}
+	printf("[DEBUG] %s: %u.\n", cif ? "Ignored non-ATOM rows" : "Ignored non-ATOM records", cif ? r.ignored : ignored);
+	return chain->atoms_len;
+}
+
+
+
+/* Parse mapped data of any supported format: PDB or mmCIF, either of them possibly compressed, using the
+ * specified number of threads (0 to choose automatically). Only the first model is read.
+ */
+int parse_pdb_mapped(chain_t* chain, const char* data, const size_t size, unsigned int threads)
+{
+	_chain_clear_columns(chain);
+	const zformat_t format = zstream_format(data, size);
+	if (format != ZFORMAT_NONE)
+		return _parse_stream(chain, data, size, format);
+	if (is_cif(data, size))
+		return parse_cif_mapped(chain, data, size);
+	return _parse_pdb_records(chain, data, size, threads);
+}
+
+
+
+/* Map a whole file into memory for reading.
+ * Returns the mapping, or NULL if the file could not be opened or is empty.
+ */
+const char* map_file(const char* filename, struct stat* st)
+{
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, st) < 0 or st->st_size == 0)
+	{
+		close(fd);
+		return NULL;
+	}
+	const char* data = (const char*)mmap(NULL, (size_t)st->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);    // The mapping keeps its own reference to the file.
+	if (data == MAP_FAILED)
+		return NULL;
+	madvise((void*)data, (size_t)st->st_size, MADV_SEQUENTIAL);
+	return data;
+}
+
+
+
+/* Parse a PDB file into an array of atom structures, using the specified number of threads (0 to choose
+ * automatically). The file is mapped into memory and the fixed columns of each record are decoded in place.
+ * mmCIF files are recognised and handed to the mmCIF reader instead, and gzip or zstd files are decompressed
+ * as they are parsed. This never touches the binary structure cache.
+ */
+int parse_pdb_threads(chain_t* chain, const char* filename, unsigned int threads)
+{
+	_chain_clear_columns(chain);
+	struct stat st;
+	const char* data = map_file(filename, &st);
+	if (data == NULL)
+		return -1;
+	int e = parse_pdb_mapped(chain, data, (size_t)st.st_size, threads);
+	munmap((void*)data, (size_t)st.st_size);
+	return e;
+}
+
+
+
+/* Parse a PDB or mmCIF file into the columns and residues of a chain, in parallel when a PDB file is large, and
+ * decompressing it on the fly when it is gzip or zstd. The columns are cached in a binary sidecar,
+ * <filename>.sbc, which later calls map and copy back while it is valid, rather than parsing and interning the
+ * text again. A chain parsed from the text also keeps its atoms; one loaded from the cache has none. If the
+ * columns cannot be built, the chain has only its atoms, and chain_build_columns() says why.
+ */
+int parse_pdb(chain_t* chain, const char* filename)
+{
+	_chain_clear_columns(chain);
+	struct stat st;
+	const char* data = map_file(filename, &st);
+	if (data == NULL)
+		return -1;
+	const size_t size = (size_t)st.st_size;
+	
+	// Try the cache first.
+	char sbc_filename[strlen(filename) + 5]; // It's strlen + 5 because '.' 's' 'b' 'c' '\0'.
+	strcpy(sbc_filename, filename);
+	strcat(sbc_filename, ".sbc");
+	int e = sbc_read(chain, sbc_filename, &st, data);
+	if (e >= 0)
+	{
+		printf("[DEBUG] %s: %s.\n", "Loaded structure cache", sbc_filename);
+		munmap((void*)data, size);
+		return e;
+	}
+	else if (e != -1)
+		printf("[NOTICE] %s: %s (code %i).\n", "Ignoring stale or unreadable structure cache", sbc_filename, e);
+	
+	// Otherwise parse the text, build its columns, and write the cache of them for next time.
+	e = parse_pdb_mapped(chain, data, size, 0);
+	const bool     built = (e > 0 and chain_build_columns(chain) == 0);
+	const uint64_t hash  = built ? sbc_hash(data, size) : 0;
+	munmap((void*)data, size);
+	if (built)
+	{
+		int f = sbc_write(chain, sbc_filename, &st, hash);
+		if (f < 0)
+			printf("[NOTICE] %s: %s (code %i).\n", "Could not write structure cache", sbc_filename, f);
+	}
+	return e;
+}
+
+
+
+/* Read the operators that build the first biological assembly of a PDB file from the atoms in it, from the BIOMT
+ * records of REMARK 350, each as a matrix of 16 floats by columns, its rotation and then its translation, as GL
+ * takes it. The records come before the atoms, so reading stops at the first ATOM, HETATM or MODEL record. A
+ * compressed or mmCIF file is not read, and has none.
+ * Returns the number of operators, which are in *operators_out, to be freed, or 0 if there are none, or -1 if the
+ * file could not be read, or -2 if there is no memory.
  */
-int filter_atoms(atom_t* out, const atom_t* in, const unsigned int len, const unsigned int id, \
-                 const unsigned int res_id, const char* res_type, const char* type)
+int parse_pdb_assembly(float** operators_out, const char* filename)
 {
-	int i = 0;
-	for (int j = 0; j < len; j++)
-		if (_atom_match(in[j], id, res_id, res_type, type))
-			out[i++] = in[j];
-	return i;
+	*operators_out = NULL;
+	struct stat st;
+	const char* data = map_file(filename, &st);
+	if (data == NULL)
+		return -1;
+	const size_t size = (size_t)st.st_size;
+	if (zstream_format(data, size) != ZFORMAT_NONE or is_cif(data, size))
+	{
+		munmap((void*)data, size);
+		return 0;
+	}
+	
+	float*       operators = NULL;
+	unsigned int len       = 0;
+	unsigned int cap       = 0;
+	unsigned int molecules = 0;
+	int          e         = 0;
+	for (const char* line = data; line < data + size; )
+	{
+		const char* eol = (const char*)memchr(line, '\n', data + size - line);
+		if (eol == NULL)    // The last line might not be terminated.
+			eol = data + size;
+		const size_t n = eol - line;
+		if (n >= 6 and (memcmp(line, "ATOM  ", 6) == 0 or memcmp(line, "HETATM", 6) == 0 or \
+		                memcmp(line, "MODEL ", 6) == 0))
+			break;
+		
+		// Only the first biomolecule is read, and each of its operators is three records, of a row each.
+		char record[81];
+		memcpy(record, line, (n < 80) ? n : 80);
+		record[(n < 80) ? n : 80] = '\0';
+		line = eol + 1;
+		if (strncmp(record, "REMARK 350 BIOMOLECULE:", 23) == 0 and ++molecules > 1)
+			break;
+		if (strncmp(record, "REMARK 350   BIOMT", 18) != 0 or record[18] < '1' or record[18] > '3')
+			continue;
+		const unsigned int row = record[18] - '1';
+		unsigned int       serial;
+		float              r[4];
+		if (sscanf(record + 19, "%u %f %f %f %f", &serial, &r[0], &r[1], &r[2], &r[3]) != 5)
+		{
+			e = -1;
+			break;
+		}
+		if (row == 0)
+		{
+			if (len == cap)
+			{
+				cap = (cap > 0) ? 2 * cap : 16;
+				float* more = (float*)realloc(operators, cap * 16 * sizeof(float));
+				if (more == NULL)
+				{
+					e = -2;
+					break;
+				}
+				operators = more;
+			}
+			float* m = operators + 16 * len++;
+			memset(m, 0, 16 * sizeof(float));
+			m[15] = 1.0;
+		}
+		else if (len == 0)
+			continue;    // A row without the first of its operator.
+		float* m = operators + 16 * (len - 1);
+		for (unsigned int c = 0; c < 4; ++c)
+			m[4 * c + row] = r[c];
+	}
+	munmap((void*)data, size);
+	if (e < 0 or len == 0)
+	{
+		free(operators);
+		if (e == -1)
+			printf("[WARNING] %s: %s.\n", "Ignoring unreadable BIOMT records in", filename);
+		return (e == -2) ? -2 : 0;
+	}
+	*operators_out = operators;
+	return len;
 }
 
 
@@ -251,3 +824,398 @@ int atoms_to_vec4s(vec4** out, const atom_t* in, const unsigned int len)
 	}
 	return 0;
 }
+
+
+
+/* Pack an atom name of up to four characters into a key, so that names compare as integers.
+ */
+uint32_t atom_name_key(const char* name)
+{
+	char packed[4] = {0, 0, 0, 0};
+	for (unsigned int i = 0; i < 4 and name[i] != '\0'; ++i)
+		packed[i] = name[i];
+	uint32_t key;
+	memcpy(&key, packed, sizeof(key));
+	return key;
+}
+
+
+
+/* Work out the element of an atom from its name, since the element column is not read. Only ATOM records are
+ * kept, so the elements of amino and nucleic acids are all that can occur; a leading digit, as in "1HB", is
+ * the hydrogen's index and is skipped.
+ * Returns the atomic number, or 0 if unknown.
+ */
+uint8_t element_code(const char* name)
+{
+	while (*name >= '0' and *name <= '9')
+		++name;
+	switch (name[0])
+	{
+		case 'H': return 1;
+		case 'C': return 6;
+		case 'N': return 7;
+		case 'O': return 8;
+		case 'P': return 15;
+		case 'S': return (name[1] == 'E') ? 34 : 16;    // Selenomethionine's SE.
+		default:  return 0;
+	}
+}
+
+
+
+/* Pack a name held in an array of at least four characters, as atom_name_key() does but without a loop. The
+ * bytes after the terminator are not necessarily zero, so they are masked off.
+ */
+static inline uint32_t __name_key4(const char* name)
+{
+	const unsigned char m0 = (name[0] != '\0') ? 0xff : 0;
+	const unsigned char m1 = (name[1] != '\0') ? m0 : 0;
+	const unsigned char m2 = (name[2] != '\0') ? m1 : 0;
+	const unsigned char m3 = (name[3] != '\0') ? m2 : 0;
+	const unsigned char masks[4] = {m0, m1, m2, m3};
+	uint32_t key, mask;
+	memcpy(&key, name, sizeof(key));
+	memcpy(&mask, masks, sizeof(mask));
+	return key & mask;
+}
+
+
+
+/* Find the index of a name in an interning table, adding it if it is new. Names are compared by their packed
+ * keys, and consecutive atoms nearly always share their residue and chain names, so the previous match is tried
+ * before searching.
+ * Returns the index, or -1 if the table is full.
+ */
+static inline int _intern_name(char* table, unsigned int* len, const unsigned int cap, const size_t size, \
+                               const char* name, uint32_t* last_key, int* last)
+{
+	const uint32_t key = __name_key4(name);
+	if (*last >= 0 and key == *last_key)
+		return *last;
+	*last_key = key;
+	for (unsigned int i = 0; i < *len; ++i)
+		if (__name_key4(table + i * size) == key)
+			return *last = i;
+	if (*len == cap)
+		return -1;
+	memcpy(table + *len * size, name, strnlen(name, size - 1));    // The table is zeroed, so it stays terminated.
+	return *last = (*len)++;
+}
+
+
+
+/* Test whether atom i of a chain with columns starts a new residue.
+ */
+static inline bool __residue_begins(const columns_t* c, const size_t i)
+{
+	return i == 0 or c->chains[i] != c->chains[i - 1] or c->res_ids[i] != c->res_ids[i - 1] or \
+	       c->icodes[i] != c->icodes[i - 1] or c->res_names[i] != c->res_names[i - 1];
+}
+
+
+
+/* Hash the key of a residue: its interned chain, its number and its insertion code.
+ */
+static inline unsigned int __residue_hash(const unsigned int chain, const unsigned int res_id, const char icode)
+{
+	const uint64_t key = ((uint64_t)chain << 40) | ((uint64_t)(unsigned char)icode << 32) | res_id;
+	return (unsigned int)((key * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+
+
+/* Lay out the residues of a chain, all in one allocation: room for the given numbers of residues, runs of a chain,
+ * and slots of the hash, which must be a power of two, as well as the residue of each atom.
+ * Returns: 0 success; -2 out of memory.
+ */
+int chain_allocate_residues(chain_t* chain, const unsigned int residues, const unsigned int runs, \
+                            const unsigned int slots)
+{
+	residues_t*   r      = &chain->residues;
+	const size_t  total  = ((size_t)residues + 1 + runs + 1 + chain->atoms_len + slots) * sizeof(unsigned int);
+	unsigned int* memory = (unsigned int*)malloc(total);    // malloc r->memory
+	if (memory == NULL)
+		return -2;
+	r->memory       = memory;
+	r->starts       = memory;
+	r->chain_starts = r->starts + residues + 1;
+	r->of_atom      = r->chain_starts + runs + 1;
+	r->slots        = r->of_atom + chain->atoms_len;
+	r->slots_mask   = slots - 1;
+	r->len          = residues;
+	r->chains_len   = runs;
+	return 0;
+}
+
+
+
+/* Build the residue hierarchy and hash of a chain from its columns, in one allocation sized by a first pass.
+ * Returns: 0 success; -2 out of memory.
+ */
+static int _build_residues(chain_t* chain)
+{
+	const columns_t*   c = &chain->cols;
+	residues_t*        r = &chain->residues;
+	const unsigned int n = chain->atoms_len;
+	
+	// Count the residues and the runs of each chain.
+	unsigned int residues = 0, runs = 0;
+	for (unsigned int i = 0; i < n; ++i)
+		if (__residue_begins(c, i))
+		{
+			++residues;
+			if (i == 0 or c->chains[i] != c->chains[i - 1])
+				++runs;
+		}
+	unsigned int slots = 1;
+	while (slots < STARBOARD_PDB_RESIDUE_SLOTS * residues)
+		slots *= 2;
+	
+	if (chain_allocate_residues(chain, residues, runs, slots) < 0)
+		return -2;
+	r->len        = 0;
+	r->chains_len = 0;
+	memset(r->slots, 0, slots * sizeof(unsigned int));
+	
+	for (unsigned int i = 0; i < n; ++i)
+	{
+		if (__residue_begins(c, i))
+		{
+			if (i == 0 or c->chains[i] != c->chains[i - 1])
+				r->chain_starts[r->chains_len++] = r->len;
+			r->starts[r->len++] = i;
+			
+			// Hash the new residue. Residues with the same key lie along its probe sequence in file order.
+			unsigned int slot = __residue_hash(c->chains[i], c->res_ids[i], c->icodes[i]) & r->slots_mask;
+			while (r->slots[slot] != 0)
+				slot = (slot + 1) & r->slots_mask;
+			r->slots[slot] = r->len;
+		}
+		r->of_atom[i] = r->len - 1;
+	}
+	r->starts[r->len]              = n;
+	r->chain_starts[r->chains_len] = r->len;
+	return 0;
+}
+
+
+
+/* Lay out the columns of a chain for its atoms_len atoms, zeroed, with room for the given number of names in each
+ * of its tables, which start empty. All of the columns share one aligned allocation.
+ * Returns: 0 success; -2 out of memory.
+ */
+int chain_allocate_columns(chain_t* chain, const size_t names)
+{
+	columns_t*   c      = &chain->cols;
+	const size_t n      = chain->atoms_len;
+	const size_t padded = (n + STARBOARD_PDB_COLUMN_WIDTH - 1) / STARBOARD_PDB_COLUMN_WIDTH \
+	                                                            * STARBOARD_PDB_COLUMN_WIDTH;
+	
+	// Lay the columns out one after another, each on a cache line.
+	const size_t sizes[12] = {padded * sizeof(float), padded * sizeof(float), padded * sizeof(float), \
+	                          n * sizeof(unsigned int), n * sizeof(unsigned int), n * sizeof(uint32_t), \
+	                          n * sizeof(uint16_t), n * sizeof(uint16_t), n * sizeof(uint8_t), n * sizeof(char), \
+	                          names * sizeof(c->res_name_table[0]), names * sizeof(c->chain_table[0])};
+	size_t offsets[12];
+	size_t total = 0;
+	for (unsigned int i = 0; i < 12; ++i)
+	{
+		offsets[i] = total;
+		total     += (sizes[i] + STARBOARD_PDB_COLUMN_ALIGNMENT - 1) / STARBOARD_PDB_COLUMN_ALIGNMENT \
+		                                                            * STARBOARD_PDB_COLUMN_ALIGNMENT;
+	}
+	char* memory = (char*)aligned_alloc(STARBOARD_PDB_COLUMN_ALIGNMENT, total);    // malloc c->memory
+	if (memory == NULL)
+		return -2;
+	memset(memory, 0, total);
+	c->memory             = memory;
+	c->x                  = (float*)(memory + offsets[0]);
+	c->y                  = (float*)(memory + offsets[1]);
+	c->z                  = (float*)(memory + offsets[2]);
+	c->ids                = (unsigned int*)(memory + offsets[3]);
+	c->res_ids            = (unsigned int*)(memory + offsets[4]);
+	c->atom_names         = (uint32_t*)(memory + offsets[5]);
+	c->res_names          = (uint16_t*)(memory + offsets[6]);
+	c->chains             = (uint16_t*)(memory + offsets[7]);
+	c->elements           = (uint8_t*)(memory + offsets[8]);
+	c->icodes             = memory + offsets[9];
+	c->res_name_table     = (char(*)[4])(memory + offsets[10]);
+	c->chain_table        = (char(*)[5])(memory + offsets[11]);
+	c->res_name_table_len = 0;
+	c->chain_table_len    = 0;
+	return 0;
+}
+
+
+
+/* Derive the columns of a chain from its atoms, and index its residues, unless it already has them, as a chain
+ * loaded from its cache does.
+ * Returns: 0 success; -2 out of memory; -3 more than 65536 distinct residue or chain names.
+ */
+int chain_build_columns(chain_t* chain)
+{
+	if (chain->cols.memory != NULL)
+		return 0;
+	columns_t*   c     = &chain->cols;
+	const size_t n     = chain->atoms_len;
+	const size_t names = (n < UINT16_MAX + 1) ? (n > 0 ? n : 1) : UINT16_MAX + 1;
+	if (chain_allocate_columns(chain, names) < 0)
+		return -2;
+	
+	int      last_res_name     = -1;
+	int      last_chain        = -1;
+	uint32_t last_res_name_key = 0;
+	uint32_t last_chain_key    = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		const atom_t* a = &chain->atoms[i];
+		c->x[i]          = a->x;
+		c->y[i]          = a->y;
+		c->z[i]          = a->z;
+		c->ids[i]        = a->id;
+		c->res_ids[i]    = a->res_id;
+		c->atom_names[i] = __name_key4(a->type);
+		c->elements[i]   = element_code(a->type);
+		c->icodes[i]     = a->icode;
+		int r = _intern_name((char*)c->res_name_table, &c->res_name_table_len, names, sizeof(c->res_name_table[0]), \
+		                     a->res_type, &last_res_name_key, &last_res_name);
+		int k = _intern_name((char*)c->chain_table, &c->chain_table_len, names, sizeof(c->chain_table[0]), \
+		                     a->chain, &last_chain_key, &last_chain);
+		if (r < 0 or k < 0)
+		{
+			chain_free_columns(chain);
+			return -3;
+		}
+		c->res_names[i] = (uint16_t)r;
+		c->chains[i]    = (uint16_t)k;
+	}
+	if (_build_residues(chain) < 0)
+	{
+		chain_free_columns(chain);
+		return -2;
+	}
+	return 0;
+}
+
+
+
+/* Copy the columns and residues of a chain, but not its atoms, into copy, which then owns them, e.g. to change a
+ * chain that something else owns.
+ * Returns: 0 success; -2 out of memory.
+ */
+int chain_copy_columns(chain_t* copy, const chain_t* chain)
+{
+	const columns_t*   c     = &chain->cols;
+	const residues_t*  r     = &chain->residues;
+	const unsigned int n     = chain->atoms_len;
+	const size_t       names = (c->res_name_table_len > c->chain_table_len) ? c->res_name_table_len : \
+	                                                                           c->chain_table_len;
+	copy->atoms     = NULL;
+	copy->atoms_len = n;
+	if (chain_allocate_columns(copy, names > 0 ? names : 1) < 0)
+		return -2;
+	if (chain_allocate_residues(copy, r->len, r->chains_len, r->slots_mask + 1) < 0)
+	{
+		chain_free_columns(copy);
+		return -2;
+	}
+	columns_t* d = &copy->cols;
+	memcpy(d->x,              c->x,              n * sizeof(float));
+	memcpy(d->y,              c->y,              n * sizeof(float));
+	memcpy(d->z,              c->z,              n * sizeof(float));
+	memcpy(d->ids,            c->ids,            n * sizeof(unsigned int));
+	memcpy(d->res_ids,        c->res_ids,        n * sizeof(unsigned int));
+	memcpy(d->atom_names,     c->atom_names,     n * sizeof(uint32_t));
+	memcpy(d->res_names,      c->res_names,      n * sizeof(uint16_t));
+	memcpy(d->chains,         c->chains,         n * sizeof(uint16_t));
+	memcpy(d->elements,       c->elements,       n * sizeof(uint8_t));
+	memcpy(d->icodes,         c->icodes,         n * sizeof(char));
+	memcpy(d->res_name_table, c->res_name_table, c->res_name_table_len * sizeof(c->res_name_table[0]));
+	memcpy(d->chain_table,    c->chain_table,    c->chain_table_len * sizeof(c->chain_table[0]));
+	d->res_name_table_len = c->res_name_table_len;
+	d->chain_table_len    = c->chain_table_len;
+	memcpy(copy->residues.memory, r->memory, ((size_t)r->len + 1 + r->chains_len + 1 + n + r->slots_mask + 1) * \
+	                                         sizeof(unsigned int));
+	return 0;
+}
+
+
+
+/* Free the columns and residues of a chain, leaving its atoms alone.
+ */
+void chain_free_columns(chain_t* chain)
+{
+	free(chain->cols.memory);
+	memset(&chain->cols, 0, sizeof(columns_t));
+	free(chain->residues.memory);
+	memset(&chain->residues, 0, sizeof(residues_t));
+}
+
+
+
+/* Gather the coordinates of the atoms at the given indices into an array of len vec4s.
+ */
+void chain_gather_vec4s(vec4* coords, const chain_t* chain, const unsigned int* indices, const unsigned int len)
+{
+	for (unsigned int i = 0; i < len; ++i)
+	{
+		coords[i][0] = chain->cols.x[indices[i]];
+		coords[i][1] = chain->cols.y[indices[i]];
+		coords[i][2] = chain->cols.z[indices[i]];
+		coords[i][3] = 0.0;
+	}
+}
+
+
+
+/* Find the interned id of a chain identifier.
+ * Returns the id, or -1 if no atom has that chain identifier.
+ */
+int chain_find_chain(const chain_t* chain, const char* name)
+{
+	for (unsigned int i = 0; i < chain->cols.chain_table_len; ++i)
+		if (strncmp(chain->cols.chain_table[i], name, sizeof(chain->cols.chain_table[0])) == 0)
+			return i;
+	return -1;
+}
+
+
+
+/* Find the first residue after residue `after`, or -1 for the first of all, with an interned chain id, number
+ * and insertion code ('\0' for none). A key recurs where a chain identifier does, or residue numbers wrap, so
+ * every residue with it is found by passing each one found back in.
+ * Returns the index of the residue, or -1 if there is no other such residue.
+ */
+int chain_find_residue(const chain_t* chain, const unsigned int chn, const unsigned int res_id, const char icode, \
+                       const int after)
+{
+	const columns_t*  c = &chain->cols;
+	const residues_t* r = &chain->residues;
+	if (r->slots == NULL)
+		return -1;
+	for (unsigned int slot = __residue_hash(chn, res_id, icode) & r->slots_mask; r->slots[slot] != 0; \
+	     slot = (slot + 1) & r->slots_mask)
+	{
+		const unsigned int j = r->starts[r->slots[slot] - 1];
+		if ((int)r->slots[slot] - 1 > after and c->chains[j] == chn and c->res_ids[j] == res_id and \
+		    c->icodes[j] == icode)
+			return r->slots[slot] - 1;
+	}
+	return -1;
+}
+
+
+
+/* Find an atom of a residue by the key of its name, as given by atom_name_key().
+ * Returns the index of the atom in the chain, or -1 if the residue has no such atom.
+ */
+int residue_find_atom(const chain_t* chain, const unsigned int residue, const uint32_t key)
+{
+	if (residue >= chain->residues.len)
+		return -1;
+	for (unsigned int i = chain->residues.starts[residue]; i < chain->residues.starts[residue + 1]; ++i)
+		if (chain->cols.atom_names[i] == key)
+			return i;
+	return -1;
+}
@@ -4,42 +4,129 @@
 #include <iso646.h>
 #include <errno.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "linmath/linmath.h"
 
 
+// Files smaller than this are parsed by a single thread; the upper limit bounds the per-call thread arrays.
+#define STARBOARD_PDB_PARALLEL_MIN_BYTES (4 * 1024 * 1024)
+#define STARBOARD_PDB_THREADS_MAX        64
+
+// Every column starts on a cache line, and the coordinate columns are padded with zeros to a whole number of
+// vectors of this many floats, so that vector kernels over them need no scalar tail.
+#define STARBOARD_PDB_COLUMN_ALIGNMENT 64
+#define STARBOARD_PDB_COLUMN_WIDTH     16
+
+// The residue hash has at least this many slots per residue, which keeps probe sequences short.
+#define STARBOARD_PDB_RESIDUE_SLOTS 2
+
+
 
 /* Describe an atom within a protein, which has a residue, an atom type, and a position. 
+ * The chain identifier has room for the four characters that an mmCIF auth_asym_id can have. The insertion code
+ * tells apart residues that share a number, and is '\0' if there is none.
  */
 typedef struct atom
 {
 	unsigned int id;
 	unsigned int res_id;
-	char         res_type[4], type[5];
+	char         res_type[4], type[5], chain[5], icode;
 	float        x, y, z;
 } atom_t;
 
 
 
-/* Describe a collection of atoms, which form a chain.
+/* The atoms of a chain stored as one array per field, so that a scan over one field touches only that field.
+ * Residue and chain names are interned, and index into the name tables; atom names are packed into a key by
+ * atom_name_key().
+ */
+typedef struct columns
+{
+	float*        x;
+	float*        y;
+	float*        z;
+	unsigned int* ids;
+	unsigned int* res_ids;
+	uint32_t*     atom_names;
+	uint16_t*     res_names;
+	uint16_t*     chains;
+	uint8_t*      elements;              // Atomic number, or 0 if unknown.
+	char*         icodes;                // Insertion code, or '\0' if none.
+	char        (*res_name_table)[4];
+	unsigned int  res_name_table_len;
+	char        (*chain_table)[5];
+	unsigned int  chain_table_len;
+	void*         memory;                // The single allocation that all of the above live in.
+} columns_t;
+
+
+
+/* The hierarchy of a chain: chain -> residues -> atoms. The atoms of a residue, and the residues of a chain, are
+ * contiguous in file order, so each level is an array of where its runs start. A residue begins wherever the
+ * chain, residue number, insertion code or residue name changes. A chain identifier that recurs later in the file
+ * starts a new run. The hash finds the residues for a (chain, residue number, insertion code) key without a scan,
+ * in file order if the key occurs more than once.
+ */
+typedef struct residues
+{
+	unsigned int* starts;          // First atom of each residue, then atoms_len.
+	unsigned int  len;
+	unsigned int* chain_starts;    // First residue of each run of one chain, then len.
+	unsigned int  chains_len;
+	unsigned int* of_atom;         // Residue of each atom.
+	unsigned int* slots;           // Residue + 1 in each slot of the hash, or 0 if the slot is empty.
+	unsigned int  slots_mask;
+	void*         memory;          // The single allocation that all of the above live in.
+} residues_t;
+
+
+
+/* Describe a collection of atoms, which form a chain. The parsers fill in the atoms; the columns and residues are
+ * only valid after chain_build_columns(), after which the atoms may be freed. A chain loaded from its cache has
+ * its columns and residues already, and no atoms.
  */
 typedef struct chain
 {
 	atom_t*      atoms;
 	unsigned int atoms_len;
+	columns_t    cols;
+	residues_t   residues;
 } chain_t;
 
 
 
-extern int parse_pdb(chain_t*, const char*);
+extern const char* map_file(const char*, struct stat*);
 
-extern int filter_atoms(atom_t*, const atom_t*, const unsigned int, const unsigned int, const unsigned int, \
-                        const char*, const char*);
+extern int parse_pdb(chain_t*, const char*);
+extern int parse_pdb_mapped(chain_t*, const char*, const size_t, unsigned int);
+extern int parse_pdb_threads(chain_t*, const char*, unsigned int);
+extern int parse_pdb_stdio(chain_t*, const char*);
+extern int parse_pdb_assembly(float**, const char*);
 
 extern int atoms_to_vec4s(vec4**, const atom_t*, const unsigned int);
 
+extern uint32_t atom_name_key(const char*);
+extern uint8_t  element_code(const char*);
+
+extern int  chain_allocate_columns(chain_t*, const size_t);
+extern int  chain_allocate_residues(chain_t*, const unsigned int, const unsigned int, const unsigned int);
+extern int  chain_build_columns(chain_t*);
+extern int  chain_copy_columns(chain_t*, const chain_t*);
+extern void chain_free_columns(chain_t*);
+extern void chain_gather_vec4s(vec4*, const chain_t*, const unsigned int*, const unsigned int);
+
+extern int chain_find_chain(const chain_t*, const char*);
+extern int chain_find_residue(const chain_t*, const unsigned int, const unsigned int, const char, const int);
+extern int residue_find_atom(const chain_t*, const unsigned int, const uint32_t);
+
 #endif
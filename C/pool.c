@@ -0,0 +1,178 @@
+#include "pool.h"
+
+
+
+/* Run tasks of the current loop until none are left.
+ */
+static inline void __pool_work(pool_t* pool, const unsigned int thread)
+{
+	for (unsigned int i = atomic_fetch_add(&pool->next, 1); i < pool->tasks_len; \
+	     i = atomic_fetch_add(&pool->next, 1))
+		pool->task(pool->context, i, thread);
+}
+
+
+
+/* The argument to each worker thread.
+ */
+typedef struct pool_worker
+{
+	pool_t*      pool;
+	unsigned int thread;
+} pool_worker_t;
+
+
+
+/* Wait for loops to be handed out, and work on each, until the pool is stopped.
+ */
+static void* _pool_worker(void* arg)
+{
+	pool_worker_t worker = *(pool_worker_t*)arg;
+	free(arg);
+	pool_t*      pool = worker.pool;
+	unsigned int seen = 0;
+	while (true)
+	{
+		pthread_mutex_lock(&pool->lock);
+		while (not pool->stop and pool->generation == seen)
+			pthread_cond_wait(&pool->start, &pool->lock);
+		if (pool->stop)
+		{
+			pthread_mutex_unlock(&pool->lock);
+			return NULL;
+		}
+		seen = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+		
+		__pool_work(pool, worker.thread);
+		
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->busy == 0)
+			pthread_cond_signal(&pool->done);
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+
+
+/* Stop and join every worker that has been started, leaving the pool to run loops on the caller's thread alone.
+ */
+static void _pool_stop(pool_t* pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+	for (unsigned int i = 0; i < pool->workers_len; ++i)
+		pthread_join(pool->workers[i], NULL);
+	pool->workers_len = 0;
+}
+
+
+
+/* Start a pool with the given number of threads, counting the caller's, or one per core if 0.
+ * Returns: 0 success; -1 threads could not be started (the pool still works, with fewer or no workers);
+ * -2 out of memory (the pool still works, with no workers).
+ */
+int pool_init(pool_t* pool, unsigned int threads)
+{
+	if (threads == 0)
+	{
+		long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		threads    = (cores > 1) ? (unsigned int)cores : 1;
+	}
+	if (threads > STARBOARD_POOL_THREADS_MAX)
+		threads = STARBOARD_POOL_THREADS_MAX;
+	pool->workers_len = 0;
+	pool->generation  = 0;
+	pool->busy        = 0;
+	pool->stop        = false;
+	pool->tasks_len   = 0;
+	atomic_init(&pool->next, 0);
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	pool->workers = (pthread_t*)malloc((threads > 1 ? threads - 1 : 1) * sizeof(pthread_t)); // malloc workers
+	if (pool->workers == NULL)
+		return -2;
+	
+	for (unsigned int i = 0; i + 1 < threads; ++i)
+	{
+		pool_worker_t* worker = (pool_worker_t*)malloc(sizeof(pool_worker_t)); // Freed by the worker.
+		if (worker == NULL)
+		{
+			_pool_stop(pool);
+			return -2;
+		}
+		worker->pool   = pool;
+		worker->thread = i + 1;
+		if (pthread_create(&pool->workers[i], NULL, _pool_worker, worker))
+		{
+			printf("[WARNING] %s: %u.\n", "Could not start all threads of the pool; threads running", i + 1);
+			free(worker);
+			return -1;
+		}
+		++pool->workers_len;
+	}
+	return 0;
+}
+
+
+
+/* Run task(context, i, thread) for every i from 0 to n - 1, across the pool, and wait for them all. Tasks may run
+ * in any order, and at the same time as each other, so they must not write to anything that another task uses.
+ * REMARK. Loops must not be started from inside a task, nor from more than one thread at once.
+ */
+void pool_for(pool_t* pool, unsigned int n, pool_task_t task, void* context)
+{
+	if (n == 0)
+		return;
+	
+	// A single task, or a pool without workers, is not worth waking anyone for.
+	if (n == 1 or pool->workers_len == 0)
+	{
+		for (unsigned int i = 0; i < n; ++i)
+			task(context, i, 0);
+		return;
+	}
+	
+	pthread_mutex_lock(&pool->lock);
+	pool->task      = task;
+	pool->context   = context;
+	pool->tasks_len = n;
+	atomic_store(&pool->next, 0);
+	pool->busy      = pool->workers_len;
+	++pool->generation;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+	
+	__pool_work(pool, 0);
+	
+	pthread_mutex_lock(&pool->lock);
+	while (pool->busy > 0)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+
+
+/* Count the threads that run tasks, including the caller's.
+ */
+unsigned int pool_threads(const pool_t* pool)
+{
+	return pool->workers_len + 1;
+}
+
+
+
+/* Stop and join every worker.
+ */
+void pool_free(pool_t* pool)
+{
+	_pool_stop(pool);
+	free(pool->workers);
+	pool->workers     = NULL;
+	pthread_cond_destroy(&pool->start);
+	pthread_cond_destroy(&pool->done);
+	pthread_mutex_destroy(&pool->lock);
+}
@@ -0,0 +1,60 @@
+#ifndef STARBOARD_POOL
+#define STARBOARD_POOL
+
+#include <iso646.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+
+//
+// A fixed set of worker threads, started once, that run loops of independent tasks. The thread that calls
+// pool_for() works through the loop alongside the workers and returns once every task is done, so a loop looks
+// the same to its caller as a serial one. Tasks are handed out one at a time as threads come free, so a few long
+// tasks among many short ones do not hold up the rest.
+//
+// Each task is told which thread runs it, from 0 (the calling thread) to pool_threads() - 1, so that it can keep
+// per-thread scratch space, such as an arena, without locking.
+//
+
+#define STARBOARD_POOL_THREADS_MAX 64
+
+
+
+/* A task: the loop's context, the index of the task, and the thread running it.
+ */
+typedef void (*pool_task_t)(void*, unsigned int, unsigned int);
+
+
+
+/* A pool of threads, and the loop they are working on.
+ */
+typedef struct pool
+{
+	pthread_t*      workers;
+	unsigned int    workers_len;    // Threads besides the caller's.
+	pthread_mutex_t lock;
+	pthread_cond_t  start;          // Signalled when a loop is handed out, or the pool is stopping.
+	pthread_cond_t  done;           // Signalled when the last worker finishes a loop.
+	unsigned int    generation;     // Counts loops, so workers can tell a new one from a spurious wake-up.
+	unsigned int    busy;           // Workers yet to finish the current loop.
+	bool            stop;
+
+	pool_task_t     task;
+	void*           context;
+	unsigned int    tasks_len;
+	atomic_uint     next;           // The next task to hand out.
+} pool_t;
+
+
+
+extern int  pool_init(pool_t*, unsigned int);
+extern void pool_for(pool_t*, unsigned int, pool_task_t, void*);
+extern void pool_free(pool_t*);
+
+extern unsigned int pool_threads(const pool_t*);
+
+#endif
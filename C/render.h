@@ -1,10 +1,15 @@
 #ifndef STARBOARD_RENDER
 #define STARBOARD_RENDER
 
+#include <iso646.h>
+#include <stdbool.h>
 #include <GL/glew.h>
 #include <GL/gl.h>
 
 #include "linmath/linmath.h"
+#include "vertex.h"
+#include "scene.h"
+#include "cull.h"
 
 
 
@@ -12,14 +17,24 @@
  */
 typedef struct drawable
 {
-	GLuint*      shader;
-	GLuint*      vao;
-	GLuint*      ebo;
-	GLuint*      vbo;
-	GLuint*      cbo;
-	GLuint*      ebo_len;
-	GLint*       element_class;
-	unsigned int n;
+	GLuint*        shader;
+	GLuint*        vao;              // Over the shared buffer of the drawable's kind of vertices, and its indices.
+	scene_range_t* elements;         // Of SceneElements, which buffers can share.
+	scene_range_t* colors;           // Of SceneColors, one for each residue, which shaders look up, or none.
+	GLint*         outline;          // Whether each buffer outlines another, and so keeps its own colours.
+	GLuint*        ebo_len;
+	GLint*         element_class;
+	GLenum*        element_type;     // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, for the width of the indices.
+	unsigned int   n;
+	scene_buffer_t* vertex_buffer;   // The shared buffer that the vertices are in, which every buffer draws from.
+	scene_range_t  vertices;
+	scene_range_t  attributes;       // Of SceneAttributes, which every buffer's shader looks up, or none.
+	scene_range_t  slot;             // Of SceneTransforms, by which the vertices find the transform.
+	GLint          subdivisions;     // Pieces that a shader which extrudes curves cuts each piece of them into.
+	vertex_bounds_t bounds;          // That the packed vertices are within.
+	cull_tree_t*   cull;             // The boxes of each buffer's indices, by which only those in view are drawn.
+	scene_range_t  instances;        // Of SceneOperators, one for each copy that is drawn, or none for one as it is.
+	GLfloat*       operators;        // Those operators, 16 floats each, to cull each copy by.
 	
 	vec4    model_matrix[4];
 	GLfloat model_matrix_components[16];
@@ -27,18 +42,37 @@ typedef struct drawable
 
 
 
-/* TODO.
+/* Set up a drawable of n buffers, with a slot for its transform, and nothing in it yet.
+ * Returns 0, or -1 if there are already STARBOARD_SCENE_SLOTS_MAX drawables, in which case there is nothing to
+ * free.
  */
-void allocate_drawable_buffers(unsigned int n, drawable_t* draw)
+int allocate_drawable_buffers(unsigned int n, drawable_t* draw)
 {
-	draw->shader        = (GLuint*)malloc(n * sizeof(GLuint));
-	draw->vao           = (GLuint*)malloc(n * sizeof(GLuint));
-	draw->ebo           = (GLuint*)malloc(n * sizeof(GLuint));
-	draw->vbo           = (GLuint*)malloc(n * sizeof(GLuint));
-	draw->cbo           = (GLuint*)malloc(n * sizeof(GLuint));
-	draw->ebo_len       = (GLuint*)malloc(n * sizeof(GLuint)); 
-	draw->element_class = (GLint* )malloc(n * sizeof(GLint ));
+	if (scene_buffer_alloc(&SceneTransforms, 1, &draw->slot) < 0)
+	{
+		printf("[ERROR] %s %u.\n", "Too many drawables; the most is", STARBOARD_SCENE_SLOTS_MAX);
+		return -1;
+	}
+	draw->shader        = (GLuint*       )malloc(n * sizeof(GLuint));
+	draw->vao           = (GLuint*       )malloc(n * sizeof(GLuint));
+	draw->elements      = (scene_range_t*)calloc(n, sizeof(scene_range_t));
+	draw->colors        = (scene_range_t*)calloc(n, sizeof(scene_range_t));
+	draw->outline       = (GLint*        )calloc(n, sizeof(GLint ));
+	draw->ebo_len       = (GLuint*       )calloc(n, sizeof(GLuint)); 
+	draw->element_class = (GLint*        )malloc(n * sizeof(GLint ));
+	draw->element_type  = (GLenum*       )malloc(n * sizeof(GLenum));
+	for (unsigned int i = 0; i < n; ++i)
+		draw->element_type[i] = GL_UNSIGNED_INT;
+	draw->cull          = (cull_tree_t*  )calloc(n, sizeof(cull_tree_t));
 	draw->n             = n;
+	draw->vertex_buffer = NULL;
+	memset(&draw->vertices,   0, sizeof(scene_range_t));
+	memset(&draw->attributes, 0, sizeof(scene_range_t));
+	memset(&draw->instances,  0, sizeof(scene_range_t));
+	draw->operators     = NULL;
+	draw->subdivisions  = 1;
+	static const vertex_bounds_t UNIT_BOUNDS = {.origin = {0.0, 0.0, 0.0}, .scale = {1.0, 1.0, 1.0}};
+	draw->bounds        = UNIT_BOUNDS;
 	
 	static const GLfloat IDENTITY[16] = { \
 		1.0, 0.0, 0.0, 0.0, \
@@ -52,81 +86,252 @@ void allocate_drawable_buffers(unsigned int n, drawable_t* draw)
 			draw->model_matrix[i][j] = IDENTITY[4 * i + j];
 	//memcpy(draw->model_matrix,            IDENTITY, 16 * sizeof(GLfloat));
 	memcpy(draw->model_matrix_components, IDENTITY, 16 * sizeof(GLfloat));
+	return 0;
 }
 
 
 
-/* TODO.
+/* Give a drawable's ranges back to the shared buffers, and free the arrays that allocate_drawable_buffers() made.
  */
-void buffer_elements(GLuint* indices, unsigned int num_indices, \
-                     GLuint* ebo_out)
+void free_drawable_buffers(drawable_t* draw)
 {
-	printf("[DEBUG] %s: (%i, %i, %i), (%i, %i, %i), (%i, %i, %i), (%i, %i, %i), (%i, %i, %i), ...\n", \
-	       "Buffering indices", indices[0],  indices[1],  indices[2], indices[3], indices[4], indices[5], \
-	                            indices[6],  indices[7],  indices[8], indices[9], indices[10], indices[11], \
-	                            indices[12], indices[13], indices[14]);
-	printf("[DEBUG] %s: %i.\n", "Triangles to render", num_indices / 3);
-	printf("[DEBUG] %s: %i squares (%i segments).\n", "Shapes to render", num_indices / 6, num_indices / 12);
-	
-	// Generate the element buffer object (indices).
-	glGenBuffers(1, ebo_out);
-	GLuint ebo = *ebo_out;
+	if (draw->vertex_buffer != NULL)
+		scene_buffer_release(draw->vertex_buffer, draw->vertices);
+	scene_buffer_release(&SceneAttributes, draw->attributes);
+	scene_buffer_release(&SceneTransforms, draw->slot);
+	scene_buffer_release(&SceneOperators,  draw->instances);
+	for (unsigned int i = 0; i < draw->n; ++i)    // Indices can be shared between the buffers.
+	{
+		bool shared = false;
+		for (unsigned int j = 0; j < i; ++j)
+			shared = shared or (draw->elements[j].count > 0 and draw->elements[j].first == draw->elements[i].first);
+		if (not shared)
+			scene_buffer_release(&SceneElements, draw->elements[i]);
+		scene_buffer_release(&SceneColors, draw->colors[i]);
+		cull_tree_free(&draw->cull[i]);
+	}
+	free(draw->shader);
+	free(draw->vao);
+	free(draw->elements);
+	free(draw->colors);
+	free(draw->outline);
+	free(draw->ebo_len);
+	free(draw->element_class);
+	free(draw->element_type);
+	free(draw->cull);
+	free(draw->operators);
+}
+
+
+
+/* Upload the transform of a drawable, which its vertices look up by its slot (see GL/main.vert), rather than it
+ * being set for every draw: its model matrix, by columns, then the origin and the scale of its packed vertices,
+ * then where the colours of its buffers and outlines, and its attributes, start, and its subdivisions.
+ */
+void buffer_transform(const drawable_t* draw)
+{
+	GLfloat texels[4 * STARBOARD_SCENE_TRANSFORM_TEXELS] = {0.0};
+	memcpy(texels, draw->model_matrix_components, 16 * sizeof(GLfloat));
+	memcpy(texels + 16, draw->bounds.origin, 3 * sizeof(GLfloat));
+	memcpy(texels + 20, draw->bounds.scale,  3 * sizeof(GLfloat));
+	for (unsigned int i = draw->n; i > 0; --i)
+		texels[24 + (draw->outline[i - 1] ? 1 : 0)] = (GLfloat)draw->colors[i - 1].first;
+	texels[26] = (GLfloat)draw->attributes.first;
+	texels[27] = (GLfloat)draw->subdivisions;
+	scene_buffer_upload(&SceneTransforms, draw->slot.first, 1, texels);
+}
+
+
+
+/* Give a drawable the operators of n copies of it, each a matrix of 16 floats by columns that moves its vertices
+ * before its model matrix does, which are all drawn by each draw of it, or none, with n = 0, to draw it once as it
+ * is. Any operators it had are given back to their shared buffer.
+ * Returns 0, or -1 if there is no room, in which case it is drawn once.
+ */
+int buffer_operators(const GLfloat* operators, unsigned int n, drawable_t* draw)
+{
+	scene_buffer_release(&SceneOperators, draw->instances);
+	memset(&draw->instances, 0, sizeof(scene_range_t));
+	free(draw->operators);
+	draw->operators = NULL;
+	if (n == 0)
+		return 0;
+	draw->operators = (GLfloat*)malloc(16 * n * sizeof(GLfloat)); // malloc draw->operators
+	if (draw->operators == NULL or scene_buffer_alloc(&SceneOperators, n, &draw->instances) < 0)
+	{
+		free(draw->operators);
+		draw->operators = NULL;
+		memset(&draw->instances, 0, sizeof(scene_range_t));
+		return -1;
+	}
+	memcpy(draw->operators, operators, 16 * n * sizeof(GLfloat));
+	scene_buffer_upload(&SceneOperators, draw->instances.first, n, operators);
+	return 0;
+}
+
+
+
+/* Find the narrowest type of index that can reach num_vertices vertices, leaving the largest value of the type for
+ * the primitive-restart index.
+ */
+GLenum element_type(unsigned int num_vertices)
+{
+	return (num_vertices < 0xFFFF) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+
+
+/* Find the primitive-restart index of a type of index, which is its largest value.
+ */
+GLuint element_restart(GLenum type)
+{
+	return (type == GL_UNSIGNED_SHORT) ? 0xFFFF : 0xFFFFFFFF;
+}
+
+
+
+/* Upload indices to a range of the shared element buffer, as indices of the given type (see element_type()), which
+ * count from the first vertex of their drawable. Narrowing an index to 16 bits keeps its low bits, so a 32-bit
+ * restart index becomes the 16-bit one.
+ * Returns 0, or -1 if there is no room.
+ */
+int buffer_elements(const GLuint* indices, unsigned int num_indices, GLenum type, scene_range_t* range_out)
+{
+	printf("[DEBUG] %s: %u (%s).\n", "Indices to render", num_indices, \
+	       (type == GL_UNSIGNED_SHORT) ? "16-bit" : "32-bit");
 	
-	// Bind the element buffer and upload the data.
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_indices * sizeof(GLuint), indices, GL_STATIC_DRAW);
+	// The range is in units of 32 bits, so two narrow indices go in each.
+	const unsigned int units = (type == GL_UNSIGNED_SHORT) ? (num_indices + 1) / 2 : num_indices;
+	if (scene_buffer_alloc(&SceneElements, units, range_out) < 0)
+		return -1;
+	if (type == GL_UNSIGNED_SHORT)
+	{
+		GLushort* narrow = (GLushort*)calloc(2 * units, sizeof(GLushort)); // malloc narrow
+		if (narrow == NULL)
+			return -1;
+		for (unsigned int k = 0; k < num_indices; ++k)
+			narrow[k] = (GLushort)indices[k];
+		scene_buffer_upload(&SceneElements, range_out->first, units, narrow);
+		free(narrow); // free narrow
+	}
+	else
+		scene_buffer_upload(&SceneElements, range_out->first, units, indices);
+	return 0;
 }
 
 
 
-/* Convert our data to vertex objects on the GPU.
+/* Upload vertices of any kind to a range of the shared buffer of their kind, e.g. packed vertices.
+ * Returns 0, or -1 if there is no room.
  */
-void buffer_vertices(GLfloat* vertices, unsigned int num_vertex_components, \
-                     GLuint* vbo_out)
+int buffer_vertices(scene_buffer_t* buf, const void* vertices, unsigned int num_vertices, scene_range_t* range_out)
 {
-	printf("[DEBUG] %s: (%.1f, %.1f, %.1f), (%.1f, %.1f, %.1f), (%.1f, %.1f, %.1f), ...\n", \
-	       "Buffering vertices", vertices[0], vertices[1], vertices[2], \
-	                             vertices[3], vertices[4], vertices[5], \
-	                             vertices[6], vertices[7], vertices[8]);
-	printf("........%s. (%.1f, %.1f, %.1f), (%.1f, %.1f, %.1f), (%.1f, %.1f, %.1f), ...\n", \
-	       "..................", vertices[9],  vertices[10], vertices[11], \
-	                             vertices[12], vertices[13], vertices[14], \
-	                             vertices[15], vertices[16], vertices[17]);
-	printf("........%s. (%.1f, %.1f, %.1f), (%.1f, %.1f, %.1f), (%.1f, %.1f, %.1f), ...\n", \
-	       "..................", vertices[18], vertices[19], vertices[20], \
-	                             vertices[21], vertices[22], vertices[23], \
-	                             vertices[24], vertices[25], vertices[26]);
-	printf("[DEBUG] %s: %i vertex components (%i vertices).\n", \
-	       "Vertices to render", num_vertex_components, num_vertex_components / 3);
-	printf("[DEBUG] %s: %i.\n", "Triangles to render", 4 * num_vertex_components / 18);
+	printf("[DEBUG] %s: %i vertices (%zu bytes).\n", \
+	       "Vertices to render", num_vertices, num_vertices * buf->unit);
 	fflush(stdout);
-	// Generate the vertex buffer object.
-	glGenBuffers(1, vbo_out);
-	GLuint vbo = *vbo_out;
-	
-	// Bind the vertex buffer and upload the data.
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, num_vertex_components * sizeof(GLfloat), vertices, GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(0);
+	if (scene_buffer_alloc(buf, num_vertices, range_out) < 0)
+		return -1;
+	scene_buffer_upload(buf, range_out->first, num_vertices, vertices);
+	return 0;
 }
 
 
 
-/* TODO.
+/* Overwrite count RGBA colours in a range of the shared colour buffer that buffer_colors() found, from the first
+ * onwards, with the same colours of an array, e.g. after some residues have been recoloured. A component is a byte
+ * on the GPU.
  */
-void buffer_colors(GLfloat* colors, unsigned int num_color_components, \
-                   GLuint* cbo_out)
+void rebuffer_colors(scene_range_t range, const GLfloat* colors, unsigned int first, unsigned int count)
 {
-	// Generate a buffer to hold the colour of each vertex.
-	glGenBuffers(1, cbo_out);
-	GLuint cbo = *cbo_out;
-	
-	// Bind the colour buffer and upload the vertex colours.
-	glBindBuffer(GL_ARRAY_BUFFER, cbo);
-	glBufferData(GL_ARRAY_BUFFER, num_color_components * sizeof(GLfloat), colors, GL_STATIC_DRAW);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(1);
+	GLubyte* bytes = (GLubyte*)malloc(4 * count * sizeof(GLubyte)); // malloc bytes
+	if (bytes == NULL)
+		return;
+	for (unsigned int i = 0; i < 4 * count; ++i)
+		bytes[i] = (GLubyte)(255.0f * fminf(fmaxf(colors[4 * first + i], 0.0f), 1.0f) + 0.5f);
+	scene_buffer_upload(&SceneColors, range.first + first, count, bytes);
+	free(bytes); // free bytes
+}
+
+
+
+/* Upload RGBA colours to a range of the shared colour buffer, which shaders read as a texture (a samplerBuffer),
+ * e.g. one colour for each residue, which they look up by the residue of each vertex rather than each vertex
+ * having its own. The components are stored as bytes, which the shaders read back from 0 to 1.
+ * Returns 0, or -1 if there is no room.
+ */
+int buffer_colors(const GLfloat* colors, unsigned int num_colors, scene_range_t* range_out)
+{
+	if (scene_buffer_alloc(&SceneColors, num_colors, range_out) < 0)
+		return -1;
+	rebuffer_colors(*range_out, colors, 0, num_colors);
+	return 0;
+}
+
+
+
+/* Overwrite the attributes of count residues in a range of the shared attribute buffer that buffer_attributes()
+ * found, from the first onwards, with the same attributes of an array.
+ */
+void rebuffer_attributes(scene_range_t range, const GLuint* attributes, unsigned int first, unsigned int count)
+{
+	scene_buffer_upload(&SceneAttributes, range.first + first, count, attributes + 2 * first);
+}
+
+
+
+/* Upload the attributes of each residue, two words each, to a range of the shared attribute buffer, which shaders
+ * read as a texture (a usamplerBuffer), and look up by residue as they do colours.
+ * Returns 0, or -1 if there is no room.
+ */
+int buffer_attributes(const GLuint* attributes, unsigned int num_residues, scene_range_t* range_out)
+{
+	if (scene_buffer_alloc(&SceneAttributes, num_residues, range_out) < 0)
+		return -1;
+	scene_buffer_upload(&SceneAttributes, range_out->first, num_residues, attributes);
+	return 0;
+}
+
+
+
+/* Upload colour maps of width RGBA texels each as the layers of a one-dimensional texture array, which shaders
+ * sample between texels.
+ */
+void buffer_colormaps(const GLubyte* texels, unsigned int width, unsigned int num_maps, GLuint* texture_out)
+{
+	glGenTextures(1, texture_out);
+	glBindTexture(GL_TEXTURE_1D_ARRAY, *texture_out);
+	glTexImage2D(GL_TEXTURE_1D_ARRAY, 0, GL_RGBA8, width, num_maps, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+	glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_1D_ARRAY, 0);
+}
+
+
+
+/* Upload the projection and view matrices of the camera to a uniform buffer, in the std140 layout of the Camera
+ * block of the shaders, and bind it to the binding point that every program's block was given at link.
+ */
+void buffer_camera(const GLfloat projection[16], const GLfloat view[16], GLuint binding, GLuint* ubo_out)
+{
+	glGenBuffers(1, ubo_out);
+	glBindBuffer(GL_UNIFORM_BUFFER, *ubo_out);
+	glBufferData(GL_UNIFORM_BUFFER, 32 * sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0,                   16 * sizeof(GLfloat), projection);
+	glBufferSubData(GL_UNIFORM_BUFFER, 16 * sizeof(GLfloat), 16 * sizeof(GLfloat), view);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, *ubo_out);
+}
+
+
+
+/* Overwrite the view matrix in a buffer that buffer_camera() made, e.g. after the camera has moved.
+ */
+void rebuffer_camera_view(GLuint ubo, const GLfloat view[16])
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 16 * sizeof(GLfloat), 16 * sizeof(GLfloat), view);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 
@@ -134,14 +339,14 @@ void buffer_colors(GLfloat* colors, unsigned int num_color_components, \
 /* TODO.
  */
 void buffer_color_repeated(GLfloat* color, unsigned int n, \
-                           GLuint* cbo_out)
+                           scene_range_t* range_out)
 {
 	GLfloat colors_repeated[4 * n];
 	unsigned int K = 0;
 	for (unsigned int i = 0; i < n; ++i)
 		for (unsigned int j = 0; j < 4; ++j)
 			colors_repeated[K++] = color[j];
-	buffer_colors(colors_repeated, 4 * n, cbo_out);
+	buffer_colors(colors_repeated, n, range_out);
 }
 
 
@@ -1,165 +1,310 @@
 #include "ribbon.h"
 
-static const unsigned int COUNT_PER_RESIDUE = 3; // Fixed by curve generation.
 
 
+/* Put the point plus & minus the arc normal, to give the ribbon thickness, into a pair of vertices. Of the two,
+ * the one nearer the previous vertex (if any) goes second, so that the ribbon does not twist.
+ */
+static inline void __ribbon_vertex_pair(vec4 p, vec4 Z, const float pitch, const GLfloat* previous, GLfloat* out)
+{
+	vec4 E_Z, A, B;
+	//printf("[DEBUG] pitch = %.2f.\n", pitch);
+	//printf("[DEBUG] Z = %.1f, %.1f, %.1f.\n", Z[0], Z[1], Z[2]);
+	vec4_scale(E_Z, Z, pitch);
+	vec4_add(A, p, E_Z);
+	vec4_sub(B, p, E_Z);
+	if (previous != NULL)
+	{
+		vec4 previous_to_A, previous_to_B;
+		for (unsigned int k = 0; k < 3; ++k)
+		{
+			previous_to_A[k] = A[k] - previous[k];
+			previous_to_B[k] = B[k] - previous[k];
+		}
+		if (vec3_len(previous_to_B) > vec3_len(previous_to_A))
+		{
+			vec4 tmp;
+			memcpy(tmp, A,   sizeof(vec4));
+			memcpy(A,   B,   sizeof(vec4));
+			memcpy(B,   tmp, sizeof(vec4));
+		}
+	}
+	// Put point A into the vertex list, then point B. 
+	for (unsigned int k = 0; k < 3; ++k)
+		out[k] = A[k];
+	for (unsigned int k = 0; k < 3; ++k)
+		out[3 + k] = B[k];
+}
 
-/* Convert an interpolated curve to an OpenGL representation of a ribbon.
+
+
+/* Convert an interpolated curve to an OpenGL representation of a ribbon, as one triangle strip
+ * (GL_TRIANGLE_STRIP) ended by a restart index, so that the strips of several ribbons can share one buffer. Residue
+ * i of the ribbon follows the points offsets[i] to offsets[i + 1] of the curve, so residues can have different
+ * numbers of points.
  */
-int curve_to_ribbon(vec4* p, unsigned int count, vec4* Z, float* T, \
+int curve_to_ribbon(arena_t* arena, vec4* p, unsigned int count, vec4* Z, float* T, \
+                    const unsigned int* offsets, unsigned int num_residues, \
                     GLfloat** vertices_out, unsigned int* num_components_out, \
                     GLuint** polygons_out, unsigned int* num_indices_out)
 {
-	// We could equally well work with GLfloat* -> vec4, but we prefer GLfloat* -> vec3 as it more efficiently
-	// transfers data to the GPU (i.e. cuts data transfer by a quarter).
-	#define SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX 3
-	
-	printf("[DEBUG] %s: (%.1f, %.1f, %.1f), (%.1f, %.1f, %.1f), ...\n", \
-	       "Curve positions", p[0][0], p[0][1], p[0][2], p[1][0], p[1][1], p[1][2]);
+	//printf("[DEBUG] %s: (%.1f, %.1f, %.1f), (%.1f, %.1f, %.1f), ...\n",
+	//       "Curve positions", p[0][0], p[0][1], p[0][2], p[1][0], p[1][1], p[1][2]);
 	
 	// We transform points A, B, C, and . with half-way points - into points x..., y..., z... as follows.
 	// x x xyy yzz z
 	// A - B - C - .
 	// x x xyy yzz z
-	// First, calculate the total number of vertices and vertex components (vec3) needed.
-	unsigned int num_residues = (count - 1) / (COUNT_PER_RESIDUE - 1);
-	unsigned int num_vertices = 2 * count + 2 * (num_residues - 1); 
+	// First, calculate the total number of vertices and vertex components (vec3) needed. Every residue has two
+	// vertices per point, and the point it shares with the next residue is included in both.
+	unsigned int num_vertices = 2 * (count - 1 + num_residues); 
 	*num_components_out = num_vertices * SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX;
 	unsigned int num_components = *num_components_out;
-	// Calculate the number of indices needed. Each residue has 2 * COUNT_PER_RESIDUE vertices and therefore
-	// has 2 * COUNT_PER_RESIDUE - 2 triangles, which need three indices each, so 3 * (2 * COUNT_PER_RESIDUE - 2).
-	*num_indices_out = num_residues * (3 * (2 * COUNT_PER_RESIDUE - 2));
+	// Calculate the number of indices needed. The strip takes every vertex once, in order, and then the restart.
+	*num_indices_out = num_vertices + 1;
 	unsigned int num_indices = *num_indices_out;
-	// Create space in memory to hold the new vertices and polygon indices. 
-	*vertices_out = (GLfloat*)malloc(num_components * sizeof(GLfloat));
-	*polygons_out = (GLuint*)malloc(num_indices * sizeof(GLuint));
+	// Create space in the arena to hold the new vertices and polygon indices. 
+	*vertices_out = (GLfloat*)arena_alloc(arena, num_components * sizeof(GLfloat));
+	*polygons_out = (GLuint*)arena_alloc(arena, num_indices * sizeof(GLuint));
 	GLfloat* vert = *vertices_out;
 	GLuint*  poly = *polygons_out;
 	
-	// The thickness array might be null, indicating uniform thickness.
+	// The thickness array might be null, indicating uniform thickness, in which case it is zeroed scratch space.
+	const arena_mark_t mark = arena_mark(arena);
 	float* U;
 	if (T == NULL)
-		U = (float*)calloc(num_vertices, sizeof(float)); // malloc U
+	{
+		U = (float*)arena_alloc(arena, num_vertices * sizeof(float));
+		if (U != NULL)
+			memset(U, 0, num_vertices * sizeof(float));
+	}
 	else
 		U = T;
+	if (vert == NULL or poly == NULL or U == NULL)
+		return -1;
 	
 	// Iterate over every point in the input curve, grouped by residue. 
-	vec4 E_Z, A, B;
 	unsigned int K = 0; // Working value of current vertex component in vert[].
-	float pitch;
-	for (unsigned int i = 0; i < count - 1; i += COUNT_PER_RESIDUE - 1) // It's count - 1 to skip the very last
-	                                                                    // residue start (it's just the end),
-	                                                                    // and COUNT_PER_RESIDUE - 1 so that
-	                                                                    // the shared end-of/start-of point
-	                                                                    // is included twice correctly.
-		for (unsigned int j = 0; j < COUNT_PER_RESIDUE; ++j)
+	for (unsigned int r = 0; r < num_residues; ++r)
+		for (unsigned int i = offsets[r], j = 0; j <= offsets[r + 1] - offsets[r]; ++j) // The <= includes the
+		                                                                                 // shared end-of/start-of
+		                                                                                 // point twice correctly.
 		{
 			//printf("[DEBUG] (i = %i) + (j = %i) = %i.\n", i, j, i + j);
 			//printf("[DEBUG] p[i + j] = %.1f, %.1f, %.1f.\n", p[i + j][0], p[i + j][1], p[i + j][2]);
 			//printf("[DEBUG] Z[i + j] = %.1f, %.1f, %.1f.\n", Z[i + j][0], Z[i + j][1], Z[i + j][2]);
-			
-			// Into A and B, put the point plus & minus the arc normal, to give the ribbon thickness.
-			pitch = 0.75 + U[i + j];
-			//printf("[DEBUG] pitch = %.2f.\n", pitch);
-			//printf("[DEBUG] Z = %.1f, %.1f, %.1f.\n", Z[i + j][0], Z[i + j][1], Z[i + j][2]);
-			vec4_scale(E_Z, Z[i + j], pitch);
-			vec4_add(A, p[i + j], E_Z);
-			vec4_sub(B, p[i + j], E_Z);
-			if (K > 0)
-			{
-				vec4 previous;
-				previous[0] = vert[K - SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX];
-				previous[1] = vert[K - SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX + 1];
-				previous[2] = vert[K - SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX + 2];
-				previous[3] = 0.0;
-				vec4 previous_to_A, previous_to_B;
-				vec4_sub(previous_to_A, A, previous);
-				vec4_sub(previous_to_B, B, previous);
-				if (vec3_len(previous_to_B) > vec3_len(previous_to_A))
-				{
-					vec4 tmp;
-					memcpy(tmp, A,   sizeof(vec4));
-					memcpy(A,   B,   sizeof(vec4));
-					memcpy(B,   tmp, sizeof(vec4));
-				}
-			}
-			// Put point A into the vertex list, then point B. 
-			for (unsigned int k = 0; k < 3; ++k)
-				vert[K++] = A[k];
-			// HACK. We use preprocessor directives to avoid branching in this foreach i, j loop. 
-			#if SHIPYARD_VERTEX_COMPONENTS_PER_VERTEX == 4
-				vert[K++] = 1.0;
-			#endif
-			for (unsigned int k = 0; k < 3; ++k)
-				vert[K++] = B[k];
-			#if SHIPYARD_VERTEX_COMPONENTS_PER_VERTEX == 4
-				vert[K++] = 1.0;
-			#endif
+			__ribbon_vertex_pair(p[i + j], Z[i + j], 0.75 + U[i + j], \
+			                     (K > 0) ? &vert[K - SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX] : NULL, &vert[K]);
+			K += 2 * SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX;
 		}
-	printf("[DEBUG] Wrote %i vertex components, i.e. %i vertices.\n", \
-	       K, K / SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX);
+	//printf("[DEBUG] Wrote %i vertex components, i.e. %i vertices.\n",
+	//       K, K / SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX);
 	
-	// If we calloc'd a thickness array, free it.
-	if (T == NULL)
-		free(U);
+	// If we made a thickness array, give it back.
+	arena_release(arena, mark);
 	
-	// Basically, the offset at each residue is half of the length of the edge pattern * i.
-	// We could potentially calculate this, but it's *much* easier and more efficient to just hard-code it.
-	#define STARBOARD_RIBBON_EDGE_PATTERN_LENGTH 12
-	static const GLuint EDGE_PATTERN[STARBOARD_RIBBON_EDGE_PATTERN_LENGTH] = \
-	                    {0, 1, 2, 1, 3, 2, 2, 3, 4, 3, 5, 4};
-	K = 0;
-	unsigned int offset;
-	for (unsigned int i = 0; i < num_residues; ++i)
+	// Each pair of vertices makes a quad with the pair after it, so the strip runs through the vertices in order. A
+	// residue's last pair and the next one's first are at the same point, so the two triangles between them have no
+	// area, and are not drawn.
+	for (K = 0; K < num_vertices; ++K)
+		poly[K] = K;
+	poly[K++] = STARBOARD_RIBBON_RESTART;
+	//printf("[DEBUG] Wrote %i (out of %i) indices for %i residues.\n", K, num_indices, num_residues);
+	return num_vertices;
+}
+
+
+
+/* Rewrite the vertices of residues first to last of a ribbon of uniform thickness that curve_to_ribbon() made,
+ * after their points have moved. Which way round each pair of vertices goes depends on the pair before it, so the
+ * residues after last are rewritten too, until one of them keeps its old orientation.
+ * Returns the last residue rewritten.
+ */
+unsigned int ribbon_update_vertices(vec4* p, vec4* Z, const unsigned int* offsets, unsigned int num_residues, \
+                                    unsigned int first, unsigned int last, GLfloat* vertices)
+{
+	static const float PITCH = 0.75;
+	unsigned int r = first;
+	for (; r < num_residues; ++r)
 	{
-		offset = STARBOARD_RIBBON_EDGE_PATTERN_LENGTH * i / 2;
-		for (unsigned int k = 0; k < STARBOARD_RIBBON_EDGE_PATTERN_LENGTH; k++)
-			poly[K++] = offset + EDGE_PATTERN[k];
+		GLfloat*     vert = vertices + 2 * SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX * (offsets[r] - offsets[0] + r);
+		unsigned int K    = 0;
+		for (unsigned int i = offsets[r]; i <= offsets[r + 1]; ++i)
+		{
+			GLfloat* previous = (vert + K > vertices) ? vert + K - SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX : NULL;
+			if (r > last and K == 0)
+			{
+				// Past the moved residues, stop once a residue starts the way round it did before.
+				GLfloat pair[2 * SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX];
+				__ribbon_vertex_pair(p[i], Z[i], PITCH, previous, pair);
+				if (memcmp(pair, vert, sizeof(pair)) == 0)
+					return r - 1;
+			}
+			__ribbon_vertex_pair(p[i], Z[i], PITCH, previous, &vert[K]);
+			K += 2 * SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX;
+		}
 	}
-	printf("[DEBUG] Wrote %i (out of %i) indices, i.e. %i polygons, i.e. %i squares, i.e. %i residues.\n", \
-	       K, num_indices, K / 3, K / 6, K / (6 * (COUNT_PER_RESIDUE - 1)));
-	return num_vertices;
+	return r - 1;
 }
 
 
 
-/* TODO.
+/* Put a point, its normal and the ribbon's half-width there into a control point, turning the normal round if
+ * the pair of vertices that __ribbon_vertex_pair() would make of it would be swapped, i.e. if the point minus the
+ * normal would be further from the previous point minus its normal than the point plus the normal is.
  */
-void ribbon_to_outline(unsigned int num_vertices, \
+static inline void __ribbon_point(vec4 p, vec4 Z, const float pitch, const ribbon_point_t* previous, \
+                                  ribbon_point_t* out)
+{
+	vec4  E_Z, A, B;
+	float sign = 1.0;
+	vec4_scale(E_Z, Z, pitch);
+	vec4_add(A, p, E_Z);
+	vec4_sub(B, p, E_Z);
+	if (previous != NULL)
+	{
+		vec4 previous_to_A, previous_to_B;
+		for (unsigned int k = 0; k < 3; ++k)
+		{
+			const float last = previous->position[k] - previous->pitch * previous->normal[k];
+			previous_to_A[k] = A[k] - last;
+			previous_to_B[k] = B[k] - last;
+		}
+		if (vec3_len(previous_to_B) > vec3_len(previous_to_A))
+			sign = -1.0;
+	}
+	for (unsigned int k = 0; k < 3; ++k)
+	{
+		out->position[k] = p[k];
+		out->normal[k]   = sign * Z[k];
+	}
+	out->pitch = pitch;
+}
+
+
+
+/* Convert an interpolated curve to the control points that a shader extrudes into a ribbon, one for each point
+ * rather than two vertices, with the residue of each point counted from first_residue. Residue i follows the
+ * points offsets[i] to offsets[i + 1], as with curve_to_ribbon(), and the point it shares with the next residue
+ * belongs to the next. The thickness array might be null, for a ribbon of uniform thickness.
+ * Returns the number of control points, i.e. count.
+ */
+int curve_to_control_points(vec4* p, unsigned int count, vec4* Z, float* T, \
+                            const unsigned int* offsets, unsigned int num_residues, unsigned int first_residue, \
+                            ribbon_point_t* out)
+{
+	if (count != offsets[num_residues] - offsets[0] + 1)
+		return -1;
+	for (unsigned int r = 0; r < num_residues; ++r)
+	{
+		const unsigned int end = (r + 1 < num_residues) ? offsets[r + 1] : offsets[r + 1] + 1;
+		for (unsigned int i = offsets[r]; i < end; ++i)
+		{
+			const unsigned int j = i - offsets[0];
+			__ribbon_point(p[i], Z[i], 0.75 + ((T != NULL) ? T[i] : 0.0), (j > 0) ? &out[j - 1] : NULL, &out[j]);
+			out[j].residue = first_residue + r;
+			out[j].object  = 0;
+		}
+	}
+	return count;
+}
+
+
+
+/* Rewrite the control points of residues first to last of a ribbon of uniform thickness that
+ * curve_to_control_points() made, after their points have moved. As with ribbon_update_vertices(), the residues
+ * after last are rewritten too, until one of them keeps its old orientation.
+ * Returns the last residue rewritten.
+ */
+unsigned int ribbon_update_control_points(vec4* p, vec4* Z, const unsigned int* offsets, unsigned int num_residues, \
+                                          unsigned int first, unsigned int last, ribbon_point_t* points)
+{
+	static const float PITCH = 0.75;
+	unsigned int r = first;
+	for (; r < num_residues; ++r)
+	{
+		const unsigned int end = (r + 1 < num_residues) ? offsets[r + 1] : offsets[r + 1] + 1;
+		for (unsigned int i = offsets[r]; i < end; ++i)
+		{
+			ribbon_point_t*       point    = &points[i - offsets[0]];
+			const ribbon_point_t* previous = (point > points) ? point - 1 : NULL;
+			if (r > last and i == offsets[r])
+			{
+				// Past the moved residues, stop once a residue starts the way round it did before.
+				ribbon_point_t again = *point;
+				__ribbon_point(p[i], Z[i], PITCH, previous, &again);
+				if (memcmp(&again, point, sizeof(ribbon_point_t)) == 0)
+					return r - 1;
+			}
+			__ribbon_point(p[i], Z[i], PITCH, previous, point);
+		}
+	}
+	return r - 1;
+}
+
+
+
+/* Write the indices that draw a segment of count control points, from the first, as a line strip with adjacency
+ * (GL_LINE_STRIP_ADJACENCY), so that the shader sees the points either side of each piece. The ends are repeated
+ * to stand in for the neighbours they do not have, and a restart index ends the strip, so that the segments of a
+ * ribbon can share one draw.
+ * Returns the number of indices written, which is count + 3.
+ */
+unsigned int ribbon_control_elements(unsigned int first, unsigned int count, GLuint* out)
+{
+	unsigned int K = 0;
+	out[K++] = first;
+	for (unsigned int i = 0; i < count; ++i)
+		out[K++] = first + i;
+	out[K++] = first + count - 1;
+	out[K++] = STARBOARD_RIBBON_RESTART;
+	return K;
+}
+
+
+
+/* Trace the edge of a ribbon as a closed loop, drawn as a line strip (GL_LINE_STRIP) back to where it started and
+ * ended by a restart index, so that the outlines of several ribbons can share one buffer without being joined to
+ * each other.
+ */
+void ribbon_to_outline(arena_t* arena, unsigned int num_vertices, \
                        GLuint** poly_out, unsigned int* num_indices)
 {
-	*num_indices = num_vertices + 1;
-	*poly_out = (GLuint*)malloc(*num_indices * sizeof(GLuint));
+	*num_indices = num_vertices + 2;
+	*poly_out = (GLuint*)arena_alloc(arena, *num_indices * sizeof(GLuint));
 	GLuint* poly = *poly_out;
-	// Essentially, we count up the even vertices (one edge), then down in odd vertices, then join the ends.
+	if (poly == NULL)
+		return;
+	// Essentially, we count up the even vertices (one edge), then down the odd vertices, then join the ends.
 	unsigned int K = 0;
 	for (unsigned int i = 0; i < num_vertices; i += 2)
 		poly[K++] = i;
 	for (unsigned int i = num_vertices; i > 0; i -= 2)
 		poly[K++] = i - 1;
 	poly[K++] = 0;
+	poly[K++] = STARBOARD_RIBBON_RESTART;
 }
 
 
 
-/* TODO.
+/* Pack the vertices of residues first to last of a ribbon that curve_to_ribbon() made within its bounds, for the
+ * GPU, with the residues counted from first_residue. The vertices and the packed vertices are those of the ribbon
+ * from its first residue, whose offsets these are.
+ * Returns the number of vertices that were outside the bounds, and clamped to them.
  */
-void residue_colors_to_vertex_colors(vec4* colors, unsigned int num_residues, \
-                                     GLfloat** color_components_out, unsigned int* num_color_components_out)
+unsigned int ribbon_pack_vertices(const GLfloat* vertices, const unsigned int* offsets, unsigned int first, \
+                                  unsigned int last, unsigned int first_residue, const vertex_bounds_t* bounds, \
+                                  packed_vertex_t* out)
 {
-	// Calculate the total number of RGBA components needed to store colour information about every vertex
-	// in the ribbon.
-	*num_color_components_out = num_residues * COUNT_PER_RESIDUE * 2 * 4;
-	unsigned int num_color_components = *num_color_components_out;
-	
-	// Allocate memory for the components.
-	*color_components_out = (GLfloat*)malloc(num_color_components * sizeof(GLfloat));
-	GLfloat* color_components = *color_components_out;
-	
-	// Set all of the colour components.
-	unsigned int K = 0;
-	for (unsigned int i = 0; i < num_residues; ++i)
-		for (unsigned int j = 0; j < COUNT_PER_RESIDUE * 2; ++j)
-			for (unsigned int k = 0; k < 4; ++k)
-				color_components[K++] = colors[i][k];
+	unsigned int outside = 0;
+	for (unsigned int r = first; r <= last; ++r)
+	{
+		// Each residue has two vertices for each of its points, including the one it shares with the next.
+		const unsigned int end = 2 * (offsets[r + 1] - offsets[0] + r + 1);
+		for (unsigned int v = 2 * (offsets[r] - offsets[0] + r); v < end; ++v)
+			if (not pack_vertex(vertices + SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX * v, first_residue + r, bounds, \
+			                    &out[v]))
+				++outside;
+	}
+	return outside;
 }
@@ -1,4 +1,6 @@
 #include "linmath/linmath.h"
+#include "arena.h"
+#include "vertex.h"
 
 #include <iso646.h>
 #include <stdlib.h>
@@ -8,6 +10,51 @@
 #include <GL/glew.h>
 #include <GL/gl.h>
 
+// We could equally well work with GLfloat* -> vec4, but we prefer GLfloat* -> vec3 as it takes a quarter less
+// memory. The GPU gets the vertices packed (see vertex.h).
+#define SHIPYARD_RIBBON_COMPONENTS_PER_VERTEX 3
+
+// Room (Å) around the vertices of a ribbon within its bounds, for atoms to move into without rebuilding it.
+#define STARBOARD_RIBBON_MARGIN 8.0
+
+// The primitive-restart index that separates the segments of a ribbon drawn as strips.
+#define STARBOARD_RIBBON_RESTART 0xFFFFFFFF
+
+// The most pieces that the shaders which extrude a ribbon cut each piece of its curve into (see GL/ribbon.geom).
+#define STARBOARD_RIBBON_SUBDIVISIONS_MAX 16
+
+// The style of a residue is the colour map it takes its colour from in its low byte, and these flags above it.
+#define STARBOARD_RIBBON_MAP_MASK    0xFF
+#define STARBOARD_RIBBON_SELECTED    (1 << 8)
+#define STARBOARD_RIBBON_HIDDEN      (1 << 9)
+#define STARBOARD_RIBBON_HIGHLIGHTED (1 << 10)
+
+
+
+/* One point of a curve, as a shader that extrudes the ribbon itself reads it: the point, its normal, already
+ * turned so that the ribbon does not twist, the half-width of the ribbon there, the residue whose piece of the
+ * curve starts at the point, and the slot of the object's transform, as with packed vertices. The residue picks
+ * the colour of the piece up to the next point.
+ */
+typedef struct ribbon_point
+{
+	GLfloat position[3];
+	GLfloat normal[3];
+	GLfloat pitch;
+	GLuint  residue;
+	GLuint  object;
+} ribbon_point_t;
+
+/* How the shaders draw a residue, besides its own colour, which they look up by the residue: where it falls in a
+ * colour map, from 0 to 1, and its style, i.e. which map, with 0 for none, and whether it is selected, hidden or
+ * highlighted. Changing any of these uploads only the attributes, and no vertices.
+ */
+typedef struct residue_attribute
+{
+	GLfloat value;
+	GLuint  style;
+} residue_attribute_t;
+
 typedef struct ribbon2
 {
 	unsigned int num_vertices;
@@ -17,16 +64,21 @@ typedef struct ribbon2
 	GLuint*      element_components;
 	unsigned int num_element_components;
 	
-	vec4*        residue_colors;
-	GLfloat*     vertex_color_components;
-	unsigned int num_vertex_color_components;
+	packed_vertex_t* packed_vertices;                // The vertices as the GPU gets them, within the bounds.
+	vertex_bounds_t  bounds;
+	
+	vec4*        residue_colors;                     // Of each residue, which the shaders look up.
+	residue_attribute_t* residue_attributes;         // Likewise.
 	
 	GLuint*      outline_element_components;
 	unsigned int num_outline_element_components;
 	
 	vec4*        outline_colors;
-	GLfloat*     outline_color_components;
-	unsigned int num_outline_color_components;
+	
+	ribbon_point_t* control_points;                  // Instead of the vertices, if a shader extrudes the ribbon.
+	unsigned int    num_control_points;
+	GLuint*         control_element_components;      // Each segment as a line strip with adjacency.
+	unsigned int    num_control_element_components;
 } ribbon2_t;
 
 
@@ -36,11 +88,23 @@ typedef struct ribbon2
 // representation that is thicker when the curve's curvature is higher.
 //
 
-extern int curve_to_ribbon(vec4*, unsigned int, vec4*, float*, \
+extern int curve_to_ribbon(arena_t*, vec4*, unsigned int, vec4*, float*, const unsigned int*, unsigned int, \
                            GLfloat**, unsigned int*, GLuint**, unsigned int*);
 
-extern void ribbon_to_outline(unsigned int num_vertices, \
+extern unsigned int ribbon_update_vertices(vec4*, vec4*, const unsigned int*, unsigned int, \
+                                           unsigned int, unsigned int, GLfloat*);
+
+extern void ribbon_to_outline(arena_t*, unsigned int num_vertices, \
                               GLuint** poly_out, unsigned int* num_indices);
 
-extern void residue_colors_to_vertex_colors(vec4*, unsigned int, \
-                                            GLfloat**, unsigned int*);
+extern unsigned int ribbon_pack_vertices(const GLfloat*, const unsigned int*, unsigned int, unsigned int, \
+                                         unsigned int, const vertex_bounds_t*, packed_vertex_t*);
+
+extern int curve_to_control_points(vec4*, unsigned int, vec4*, float*, const unsigned int*, unsigned int, \
+                                   unsigned int, ribbon_point_t*);
+
+extern unsigned int ribbon_update_control_points(vec4*, vec4*, const unsigned int*, unsigned int, \
+                                                 unsigned int, unsigned int, ribbon_point_t*);
+
+extern unsigned int ribbon_control_elements(unsigned int, unsigned int, GLuint*);
+
@@ -0,0 +1,252 @@
+#include "sbc.h"
+
+
+
+/* Hash the contents of a file for cache invalidation. Four independent multiply-rotate lanes consume 32 bytes
+ * per step, so this runs at close to memory bandwidth. It is not cryptographic.
+ */
+static inline uint64_t __rotl(const uint64_t x, const unsigned int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+uint64_t sbc_hash(const char* data, const size_t size)
+{
+	static const uint64_t K = 0x9E3779B97F4A7C15ull;
+	uint64_t lanes[4] = {K, ~K, K ^ size, size};
+	uint64_t w[4];
+	size_t   i = 0;
+	for (; i + sizeof(w) <= size; i += sizeof(w))
+	{
+		memcpy(w, data + i, sizeof(w));
+		for (unsigned int j = 0; j < 4; ++j)
+			lanes[j] = __rotl(lanes[j] ^ w[j], 29) * K;
+	}
+	
+	// Fold in the tail, then the lanes.
+	uint64_t tail[4] = {0, 0, 0, 0};
+	memcpy(tail, data + i, size - i);
+	uint64_t h = size;
+	for (unsigned int j = 0; j < 4; ++j)
+		h = __rotl(h ^ __rotl(lanes[j] ^ tail[j], 29) * K, 31) * K;
+	return h ^ (h >> 32);
+}
+
+
+
+/* Calculate the offset of each section of an .sbc file from the counts in its header.
+ * Returns the total size of the file.
+ */
+static inline size_t __align(const size_t o)
+{
+	return (o + STARBOARD_SBC_ALIGNMENT - 1) / STARBOARD_SBC_ALIGNMENT * STARBOARD_SBC_ALIGNMENT;
+}
+static inline size_t __sbc_residues_size(const sbc_header_t* h)
+{
+	return ((size_t)h->residues_len + 1 + h->runs_len + 1 + h->atoms_len + h->slots_len) * sizeof(uint32_t);
+}
+static size_t _sbc_layout(const sbc_header_t* h, size_t offsets[SBC_END + 1])
+{
+	const size_t n = h->atoms_len;
+	const size_t sizes[SBC_END] = \
+	{ \
+		[SBC_ID]          = n * sizeof(uint32_t), \
+		[SBC_RES_ID]      = n * sizeof(uint32_t), \
+		[SBC_X]           = n * sizeof(float), \
+		[SBC_Y]           = n * sizeof(float), \
+		[SBC_Z]           = n * sizeof(float), \
+		[SBC_ATOM_NAME]   = n * sizeof(uint32_t), \
+		[SBC_RES_NAME]    = n * sizeof(uint16_t), \
+		[SBC_CHAIN]       = n * sizeof(uint16_t), \
+		[SBC_ELEMENT]     = n * sizeof(uint8_t), \
+		[SBC_ICODE]       = n * sizeof(char), \
+		[SBC_RESIDUES]    = __sbc_residues_size(h), \
+		[SBC_RES_NAMES]   = (size_t)h->res_names_len * 4, \
+		[SBC_CHAIN_NAMES] = (size_t)h->chain_names_len * 5 \
+	};
+	size_t o = sizeof(sbc_header_t);
+	for (unsigned int s = 0; s < SBC_END; ++s)
+	{
+		o          = __align(o);
+		offsets[s] = o;
+		o         += sizes[s];
+	}
+	offsets[SBC_END] = o;
+	return o;
+}
+
+
+
+/* Load the columns and residues of a chain from an .sbc file, if it exists and is still valid for the source file
+ * described by source, whose contents are hashed only if everything else in the header matches. Each section is
+ * copied into place as it is; only the indices into the name tables and the ends of the residue index are
+ * checked. The chain has no atoms.
+ * Returns: the number of atoms on success; -1 no cache; -2 unreadable; -3 stale or foreign; -4 truncated;
+ * -5 corrupt; -6 out of memory.
+ */
+int sbc_read(chain_t* chain, const char* filename, const struct stat* source, const char* source_data)
+{
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	struct stat st;
+	if (fstat(fd, &st) < 0 or (size_t)st.st_size < sizeof(sbc_header_t))
+	{
+		close(fd);
+		return -2;
+	}
+	const size_t size = (size_t)st.st_size;
+	const char*  data = (const char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return -2;
+	
+	// Check that the cache was written by this version, on a host like this one, for this exact source file.
+	int                 e = 0;
+	const sbc_header_t* h = (const sbc_header_t*)data;
+	size_t              offsets[SBC_END + 1];
+	if (memcmp(h->magic, "SBC", 4) or h->version != STARBOARD_SBC_VERSION or \
+	    h->byte_order != STARBOARD_SBC_BYTE_ORDER or \
+	    h->source_size != (uint64_t)source->st_size or \
+	    h->source_mtime_sec != (int64_t)source->st_mtim.tv_sec or \
+	    h->source_mtime_nsec != (int64_t)source->st_mtim.tv_nsec or \
+	    h->source_hash != sbc_hash(source_data, (size_t)source->st_size))
+		e = -3;
+	else if (_sbc_layout(h, offsets) > size)
+		e = -4;
+	if (e < 0)
+	{
+		munmap((void*)data, size);
+		return e;
+	}
+	
+	// Check what would otherwise be read out of bounds later: the names that atoms index, and the residue index.
+	const unsigned int n         = h->atoms_len;
+	const uint16_t*    res_names = (const uint16_t*)(data + offsets[SBC_RES_NAME]);
+	const uint16_t*    chains    = (const uint16_t*)(data + offsets[SBC_CHAIN]);
+	const uint32_t*    starts    = (const uint32_t*)(data + offsets[SBC_RESIDUES]);
+	const uint32_t*    runs      = starts + h->residues_len + 1;
+	if (h->slots_len == 0 or (h->slots_len & (h->slots_len - 1)) != 0 or starts[h->residues_len] != n or \
+	    runs[h->runs_len] != h->residues_len)
+		e = -5;
+	for (unsigned int i = 0; i < n and e == 0; ++i)
+		if (res_names[i] >= h->res_names_len or chains[i] >= h->chain_names_len)
+			e = -5;
+	
+	// Every slot of the hash must name a residue or be empty, and one must be empty for a probe to end.
+	const uint32_t* slots = runs + h->runs_len + 1 + n;
+	unsigned int    empty = 0;
+	for (unsigned int i = 0; i < h->slots_len and e == 0; ++i)
+	{
+		if (slots[i] > h->residues_len)
+			e = -5;
+		empty += (slots[i] == 0);
+	}
+	if (empty == 0)
+		e = -5;
+	
+	// Copy each section into the columns and residues.
+	chain->atoms     = NULL;
+	chain->atoms_len = n;
+	const size_t names = (h->res_names_len > h->chain_names_len) ? h->res_names_len : h->chain_names_len;
+	if (e == 0 and chain_allocate_columns(chain, names > 0 ? names : 1) < 0)
+		e = -6;
+	else if (e == 0 and chain_allocate_residues(chain, h->residues_len, h->runs_len, h->slots_len) < 0)
+	{
+		chain_free_columns(chain);
+		e = -6;
+	}
+	if (e < 0)
+	{
+		chain->atoms_len = 0;
+		munmap((void*)data, size);
+		return e;
+	}
+	columns_t* c = &chain->cols;
+	memcpy(c->ids,        data + offsets[SBC_ID],        n * sizeof(uint32_t));
+	memcpy(c->res_ids,    data + offsets[SBC_RES_ID],    n * sizeof(uint32_t));
+	memcpy(c->x,          data + offsets[SBC_X],         n * sizeof(float));
+	memcpy(c->y,          data + offsets[SBC_Y],         n * sizeof(float));
+	memcpy(c->z,          data + offsets[SBC_Z],         n * sizeof(float));
+	memcpy(c->atom_names, data + offsets[SBC_ATOM_NAME], n * sizeof(uint32_t));
+	memcpy(c->res_names,  res_names,                     n * sizeof(uint16_t));
+	memcpy(c->chains,     chains,                        n * sizeof(uint16_t));
+	memcpy(c->elements,   data + offsets[SBC_ELEMENT],   n * sizeof(uint8_t));
+	memcpy(c->icodes,     data + offsets[SBC_ICODE],     n * sizeof(char));
+	memcpy(c->res_name_table, data + offsets[SBC_RES_NAMES],   h->res_names_len * sizeof(c->res_name_table[0]));
+	memcpy(c->chain_table,    data + offsets[SBC_CHAIN_NAMES], h->chain_names_len * sizeof(c->chain_table[0]));
+	c->res_name_table_len = h->res_names_len;
+	c->chain_table_len    = h->chain_names_len;
+	memcpy(chain->residues.memory, starts, __sbc_residues_size(h));
+	munmap((void*)data, size);
+	return n;
+}
+
+
+
+/* Write the columns and residues of a chain, which must have been built, to an .sbc file for the source file
+ * described by source and hash. The file is written under a temporary name and renamed into place, so a reader
+ * never sees a partial cache.
+ * Returns: 0 success; -2 out of memory; -3 could not write.
+ */
+int sbc_write(const chain_t* chain, const char* filename, const struct stat* source, const uint64_t hash)
+{
+	const columns_t*   c = &chain->cols;
+	const residues_t*  r = &chain->residues;
+	const unsigned int n = chain->atoms_len;
+	
+	// Fill in the header, then lay out the whole file in memory.
+	sbc_header_t h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, "SBC", 4);
+	h.version           = STARBOARD_SBC_VERSION;
+	h.byte_order        = STARBOARD_SBC_BYTE_ORDER;
+	h.atoms_len         = n;
+	h.source_size       = (uint64_t)source->st_size;
+	h.source_mtime_sec  = (int64_t)source->st_mtim.tv_sec;
+	h.source_mtime_nsec = (int64_t)source->st_mtim.tv_nsec;
+	h.source_hash       = hash;
+	h.residues_len      = r->len;
+	h.runs_len          = r->chains_len;
+	h.slots_len         = r->slots_mask + 1;
+	h.res_names_len     = c->res_name_table_len;
+	h.chain_names_len   = c->chain_table_len;
+	size_t offsets[SBC_END + 1];
+	size_t size  = _sbc_layout(&h, offsets);
+	char*  image = (char*)calloc(size, 1);    // calloc image, so padding is written as zeroes
+	if (image == NULL)
+		return -2;
+	memcpy(image, &h, sizeof(h));
+	memcpy(image + offsets[SBC_ID],          c->ids,            n * sizeof(uint32_t));
+	memcpy(image + offsets[SBC_RES_ID],      c->res_ids,        n * sizeof(uint32_t));
+	memcpy(image + offsets[SBC_X],           c->x,              n * sizeof(float));
+	memcpy(image + offsets[SBC_Y],           c->y,              n * sizeof(float));
+	memcpy(image + offsets[SBC_Z],           c->z,              n * sizeof(float));
+	memcpy(image + offsets[SBC_ATOM_NAME],   c->atom_names,     n * sizeof(uint32_t));
+	memcpy(image + offsets[SBC_RES_NAME],    c->res_names,      n * sizeof(uint16_t));
+	memcpy(image + offsets[SBC_CHAIN],       c->chains,         n * sizeof(uint16_t));
+	memcpy(image + offsets[SBC_ELEMENT],     c->elements,       n * sizeof(uint8_t));
+	memcpy(image + offsets[SBC_ICODE],       c->icodes,         n * sizeof(char));
+	memcpy(image + offsets[SBC_RESIDUES],    r->memory,         __sbc_residues_size(&h));
+	memcpy(image + offsets[SBC_RES_NAMES],   c->res_name_table, h.res_names_len * sizeof(c->res_name_table[0]));
+	memcpy(image + offsets[SBC_CHAIN_NAMES], c->chain_table,    h.chain_names_len * sizeof(c->chain_table[0]));
+	
+	// Write under a temporary name, then rename over the old cache.
+	int  e = 0;
+	char tmp[PATH_MAX + 32];
+	snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", filename, (long)getpid());
+	FILE* f = fopen(tmp, "wb");
+	if (f == NULL)
+	{
+		free(image);
+		return -3;
+	}
+	bool ok = (fwrite(image, 1, size, f) == size);
+	ok = (fclose(f) == 0) and ok;
+	if (not ok or rename(tmp, filename) != 0)
+	{
+		unlink(tmp);
+		e = -3;
+	}
+	free(image);
+	return e;
+}
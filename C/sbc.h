@@ -0,0 +1,84 @@
+#ifndef STARBOARD_SBC
+#define STARBOARD_SBC
+
+#include <iso646.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pdb.h"
+
+
+//
+// A binary structure cache (.sbc) is a sidecar to a structure file that holds its parsed columns, with their names
+// already interned, and the index of its residues, just as chain_build_columns() lays them out, so that loading
+// the same structure again is a memory mapping and a copy of each section, rather than a text parse. It is
+// invalidated whenever the size, modification time or content hash of the source file differ from those recorded
+// in its header. The source is only hashed once its size and modification time match, since hashing it costs
+// about as much as the load.
+//
+
+#define STARBOARD_SBC_VERSION    7
+#define STARBOARD_SBC_BYTE_ORDER 0x01020304    // Read back differently on a host of the other endianness.
+#define STARBOARD_SBC_ALIGNMENT  64            // Every section starts on a cache line.
+
+
+
+/* The fixed-size header at the start of every .sbc file. The sections follow it in the order of sbc_section_t,
+ * each one aligned to STARBOARD_SBC_ALIGNMENT bytes.
+ */
+typedef struct sbc_header
+{
+	char     magic[4];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t atoms_len;
+	uint64_t source_size;
+	int64_t  source_mtime_sec;
+	int64_t  source_mtime_nsec;
+	uint64_t source_hash;
+	uint32_t residues_len;
+	uint32_t runs_len;           // Runs of one chain.
+	uint32_t slots_len;          // Slots of the residue hash, a power of two.
+	uint32_t res_names_len;
+	uint32_t chain_names_len;
+} sbc_header_t;
+
+
+
+/* The sections of an .sbc file: the columns of columns_t, then the residue index as residues_t lays it out (the
+ * first atom of each residue, plus one past the end, the first residue of each run, plus one past the end, the
+ * residue of each atom, and the slots of the hash), then the name tables that the name columns index into.
+ */
+typedef enum sbc_section
+{
+	SBC_ID,           // uint32_t[atoms_len]
+	SBC_RES_ID,       // uint32_t[atoms_len]
+	SBC_X,            // float[atoms_len]
+	SBC_Y,            // float[atoms_len]
+	SBC_Z,            // float[atoms_len]
+	SBC_ATOM_NAME,    // uint32_t[atoms_len], keys from atom_name_key()
+	SBC_RES_NAME,     // uint16_t[atoms_len]
+	SBC_CHAIN,        // uint16_t[atoms_len]
+	SBC_ELEMENT,      // uint8_t[atoms_len]
+	SBC_ICODE,        // char[atoms_len]
+	SBC_RESIDUES,     // uint32_t[residues_len + 1 + runs_len + 1 + atoms_len + slots_len]
+	SBC_RES_NAMES,    // char[res_names_len][4]
+	SBC_CHAIN_NAMES,  // char[chain_names_len][5]
+	SBC_END
+} sbc_section_t;
+
+
+
+extern uint64_t sbc_hash(const char*, const size_t);
+
+extern int sbc_read(chain_t*, const char*, const struct stat*, const char*);
+
+extern int sbc_write(const chain_t*, const char*, const struct stat*, const uint64_t);
+
+#endif
@@ -0,0 +1,309 @@
+#ifndef STARBOARD_SCENE
+#define STARBOARD_SCENE
+
+#include <iso646.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+
+//
+// Objects do not have buffers of their own on the GPU, but ranges of a few buffers that every object shares: its
+// vertices, in a buffer for each kind of vertex, its indices, the colours and attributes of its residues, and its
+// transform. Then the objects whose vertices are alike can be drawn by one call for each shader and class of
+// primitive, however many of them there are (see draw_all_objects()).
+//
+// An object can also be drawn several times by one draw, as the copies of a biological assembly, each moved by an
+// operator of its own, which are in a shared buffer too. The operators of the copies in view are listed again each
+// frame, in a buffer that shaders look each copy up in (see draw_batches()).
+//
+// A range is counted in units of its buffer, e.g. vertices or colours. Ranges that are released are reused, first
+// fit, and a buffer that runs out of room grows, keeping its name, so that the vertex arrays and textures over it
+// still read it.
+//
+
+#define STARBOARD_SCENE_CAPACITY_MIN   4096      // Units that a shared buffer has room for to begin with.
+#define STARBOARD_SCENE_TRANSFORM_TEXELS 7       // RGBA texels of floats in the transform of an object.
+#define STARBOARD_SCENE_SLOTS_MAX      0x10000   // Transforms, i.e. the most drawables there can be at once, as
+                                                 // vertices name theirs in 16 bits (see vertex.h).
+#define STARBOARD_SCENE_OPERATOR_TEXELS 4        // RGBA texels of floats in an operator, i.e. a 4x4 matrix.
+
+
+
+/* A range of units of a shared buffer.
+ */
+typedef struct scene_range
+{
+	unsigned int first;
+	unsigned int count;
+} scene_range_t;
+
+/* A buffer on the GPU that objects share, and which of its units are in use.
+ */
+typedef struct scene_buffer
+{
+	GLuint         buffer;
+	size_t         unit;        // Bytes in each unit.
+	unsigned int   capacity;    // Units that the buffer has room for.
+	unsigned int   used;        // Units up to the end of the last range in use.
+	unsigned int   limit;       // The most units that the buffer can grow to, or 0 for no limit.
+	scene_range_t* free;        // Ranges below used that are not in use, in order, and none touching another.
+	unsigned int   free_len;
+	unsigned int   free_cap;
+} scene_buffer_t;
+
+
+
+// The buffers that every object shares, whatever its vertices: indices, in units of four bytes so that indices of
+// either width are aligned, RGBA colours of a byte each, the attributes of residues, of two words each, and
+// transforms and the operators of copies, which shaders read as textures in the units that shader.h gives them.
+scene_buffer_t SceneElements;
+scene_buffer_t SceneColors;
+scene_buffer_t SceneAttributes;
+scene_buffer_t SceneTransforms;
+scene_buffer_t SceneOperators;
+GLuint         SceneColorsTexture;
+GLuint         SceneAttributesTexture;
+GLuint         SceneTransformsTexture;
+GLuint         SceneOperatorsTexture;
+
+// The operators of the copies in view, by their place in SceneOperators, which draw_batches() uploads each frame.
+GLuint         SceneInstances;
+GLuint         SceneInstancesTexture;
+
+
+
+/* Create a shared buffer of units of a number of bytes each, which can grow to limit units, or without limit if
+ * that is 0.
+ */
+void scene_buffer_create(scene_buffer_t* buf, size_t unit, unsigned int limit)
+{
+	memset(buf, 0, sizeof(scene_buffer_t));
+	buf->unit     = unit;
+	buf->limit    = limit;
+	buf->capacity = (limit > 0 and limit < STARBOARD_SCENE_CAPACITY_MIN) ? limit : STARBOARD_SCENE_CAPACITY_MIN;
+	glGenBuffers(1, &buf->buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buf->buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, buf->capacity * unit, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+
+
+/* Make room for a number of units in a shared buffer, by copying the units in use out of it, giving it a larger
+ * store, and copying them back. It keeps its name, so whatever reads it reads the larger store.
+ */
+static void _scene_buffer_grow(scene_buffer_t* buf, unsigned int capacity)
+{
+	const size_t size = buf->used * buf->unit;
+	GLuint       copy = 0;
+	if (size > 0)
+	{
+		glGenBuffers(1, &copy);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, copy);
+		glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_COPY);
+		glBindBuffer(GL_COPY_READ_BUFFER, buf->buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buf->buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, capacity * buf->unit, NULL, GL_DYNAMIC_DRAW);
+	if (size > 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, copy);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+		glDeleteBuffers(1, &copy);
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	#ifdef DEBUG
+	printf("[DEBUG] %s: %u to %u units of %zu bytes.\n", "Grew a shared buffer", buf->capacity, capacity, \
+	       buf->unit);
+	#endif
+	buf->capacity = capacity;
+}
+
+
+
+/* Find a range of count units of a shared buffer that is not in use, the first that was released which is large
+ * enough, or else after the last range in use, growing the buffer if need be. An empty range is at 0.
+ * Returns 0, or -1 if the buffer cannot grow any more, in which case the range is empty, so there is nothing to
+ * release.
+ */
+int scene_buffer_alloc(scene_buffer_t* buf, unsigned int count, scene_range_t* range_out)
+{
+	range_out->first = 0;
+	range_out->count = 0;
+	if (count == 0)
+		return 0;
+	for (unsigned int i = 0; i < buf->free_len; ++i)
+	{
+		scene_range_t* range = &buf->free[i];
+		if (range->count < count)
+			continue;
+		range_out->first = range->first;
+		range_out->count = count;
+		range->first    += count;
+		range->count    -= count;
+		if (range->count == 0)
+		{
+			memmove(range, range + 1, (buf->free_len - i - 1) * sizeof(scene_range_t));
+			--buf->free_len;
+		}
+		return 0;
+	}
+	if (buf->limit > 0 and count > buf->limit - buf->used)
+		return -1;
+	if (buf->used + count > buf->capacity)
+	{
+		unsigned int capacity = 2 * buf->capacity;
+		if (capacity < buf->used + count)
+			capacity = buf->used + count;
+		if (buf->limit > 0 and capacity > buf->limit)
+			capacity = buf->limit;
+		_scene_buffer_grow(buf, capacity);
+	}
+	range_out->first = buf->used;
+	range_out->count = count;
+	buf->used       += count;
+	return 0;
+}
+
+
+
+/* Give a range that scene_buffer_alloc() found back to its shared buffer, joining it to any range either side of
+ * it that is not in use either. The buffer keeps its store.
+ */
+void scene_buffer_release(scene_buffer_t* buf, scene_range_t range)
+{
+	if (range.count == 0)
+		return;
+	
+	// Find where the range goes among those not in use, and join it to those it touches.
+	unsigned int i = 0;
+	while (i < buf->free_len and buf->free[i].first < range.first)
+		++i;
+	if (i > 0 and buf->free[i - 1].first + buf->free[i - 1].count == range.first)
+	{
+		--i;
+		range.first  = buf->free[i].first;
+		range.count += buf->free[i].count;
+		memmove(&buf->free[i], &buf->free[i + 1], (buf->free_len - i - 1) * sizeof(scene_range_t));
+		--buf->free_len;
+	}
+	if (i < buf->free_len and range.first + range.count == buf->free[i].first)
+	{
+		range.count += buf->free[i].count;
+		memmove(&buf->free[i], &buf->free[i + 1], (buf->free_len - i - 1) * sizeof(scene_range_t));
+		--buf->free_len;
+	}
+	
+	// A range at the end is no longer in use at all. Otherwise, keep it for later.
+	if (range.first + range.count == buf->used)
+	{
+		buf->used = range.first;
+		return;
+	}
+	if (buf->free_len == buf->free_cap)
+	{
+		const unsigned int cap    = (buf->free_cap > 0) ? 2 * buf->free_cap : 16;
+		scene_range_t*     ranges = (scene_range_t*)realloc(buf->free, cap * sizeof(scene_range_t));
+		if (ranges == NULL)
+			return;    // The range is lost to the buffer, rather than anything else going wrong.
+		buf->free     = ranges;
+		buf->free_cap = cap;
+	}
+	memmove(&buf->free[i + 1], &buf->free[i], (buf->free_len - i) * sizeof(scene_range_t));
+	buf->free[i] = range;
+	++buf->free_len;
+}
+
+
+
+/* Upload count units to a shared buffer, from the first onwards.
+ */
+void scene_buffer_upload(const scene_buffer_t* buf, unsigned int first, unsigned int count, const void* data)
+{
+	if (count == 0)
+		return;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buf->buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, first * buf->unit, count * buf->unit, data);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+
+
+/* Make a texture whose texels are the units of a shared buffer, in an internal format as large as a unit.
+ */
+static GLuint _scene_buffer_texture(const scene_buffer_t* buf, GLenum format)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, buf->buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	return texture;
+}
+
+
+
+/* Upload the list of the operators of the copies in view, over whatever was listed before.
+ */
+void scene_upload_instances(const GLuint* operators, unsigned int len)
+{
+	glBindBuffer(GL_TEXTURE_BUFFER, SceneInstances);
+	glBufferData(GL_TEXTURE_BUFFER, len * sizeof(GLuint), operators, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+
+
+/* Create the buffers that every object shares, and the textures over them.
+ */
+void scene_initialize(void)
+{
+	scene_buffer_create(&SceneElements,   sizeof(GLuint),      0);
+	scene_buffer_create(&SceneColors,     4 * sizeof(GLubyte), 0);
+	scene_buffer_create(&SceneAttributes, 2 * sizeof(GLuint),  0);
+	scene_buffer_create(&SceneTransforms, 4 * STARBOARD_SCENE_TRANSFORM_TEXELS * sizeof(GLfloat), \
+	                    STARBOARD_SCENE_SLOTS_MAX);
+	SceneColorsTexture     = _scene_buffer_texture(&SceneColors,     GL_RGBA8);
+	SceneAttributesTexture = _scene_buffer_texture(&SceneAttributes, GL_RG32UI);
+	scene_buffer_create(&SceneOperators,  4 * STARBOARD_SCENE_OPERATOR_TEXELS * sizeof(GLfloat), 0);
+	SceneTransformsTexture = _scene_buffer_texture(&SceneTransforms, GL_RGBA32F);
+	SceneOperatorsTexture  = _scene_buffer_texture(&SceneOperators,  GL_RGBA32F);
+	
+	// The list is given as much room as it needs as it is uploaded.
+	glGenBuffers(1, &SceneInstances);
+	glBindBuffer(GL_TEXTURE_BUFFER, SceneInstances);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(GLuint), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	glGenTextures(1, &SceneInstancesTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, SceneInstancesTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, SceneInstances);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+
+
+/* Bind the textures over the shared buffers to the units that shader.h gives their samplers, e.g. before drawing
+ * the objects.
+ */
+void scene_bind_textures(void)
+{
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_BUFFER, SceneColorsTexture);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_BUFFER, SceneAttributesTexture);
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_BUFFER, SceneTransformsTexture);
+	glActiveTexture(GL_TEXTURE4);
+	glBindTexture(GL_TEXTURE_BUFFER, SceneInstancesTexture);
+	glActiveTexture(GL_TEXTURE5);
+	glBindTexture(GL_TEXTURE_BUFFER, SceneOperatorsTexture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+#endif
@@ -0,0 +1,793 @@
+#include "select.h"
+
+
+
+//
+// Compilation: a recursive descent parser that emits postfix code.
+//
+
+/* The state of the parser over a selection string.
+ */
+typedef struct select_parser
+{
+	const char*    p;
+	char           token[64];
+	const chain_t* chain;
+	selection_t*   out;
+	int            e;
+} select_parser_t;
+
+
+
+/* Read the next token into the parser. Parentheses are tokens of their own; everything else is separated by
+ * blanks. The token is empty at the end of the string.
+ */
+static void _select_next(select_parser_t* s)
+{
+	while (*s->p == ' ' or *s->p == '\t')
+		++s->p;
+	size_t len = 0;
+	if (*s->p == '(' or *s->p == ')')
+		s->token[len++] = *s->p++;
+	else
+		while (*s->p != '\0' and *s->p != ' ' and *s->p != '\t' and *s->p != '(' and *s->p != ')')
+		{
+			if (len < sizeof(s->token) - 1)
+				s->token[len++] = *s->p;
+			++s->p;
+		}
+	s->token[len] = '\0';
+}
+
+
+
+/* Report a syntax error at the current token, unless one has been reported already.
+ */
+static void _select_error(select_parser_t* s, const char* message)
+{
+	if (s->e == 0)
+		printf("[ERROR] %s, at \"%s\".\n", message, s->token);
+	s->e = -1;
+}
+
+
+
+/* Append an instruction to the compiled code.
+ * Returns the instruction, or NULL if the code is full.
+ */
+static select_instr_t* _select_emit(select_parser_t* s, const select_op_t op)
+{
+	if (s->out->code_len == STARBOARD_SELECT_CODE_MAX)
+	{
+		_select_error(s, "Selection is too long");
+		return NULL;
+	}
+	select_instr_t* instr = &s->out->code[s->out->code_len++];
+	memset(instr, 0, sizeof(select_instr_t));
+	instr->op = op;
+	return instr;
+}
+
+
+
+/* Find a name in one of the chain's interning tables.
+ * Returns its id, or -1 if no atom has that name.
+ */
+static inline int __select_lookup(const char* table, const unsigned int len, const size_t size, const char* name)
+{
+	for (unsigned int i = 0; i < len; ++i)
+		if (strncmp(table + i * size, name, size) == 0)
+			return i;
+	return -1;
+}
+
+
+
+/* Compile the comma-separated list that follows a keyword into the values of an instruction. Names are resolved
+ * against the chain here, so that evaluation only ever compares integers; a list that names nothing in the chain
+ * compiles to `none`.
+ */
+static void _select_list(select_parser_t* s, select_instr_t* instr)
+{
+	const chain_t* chain = s->chain;
+	char*          item  = s->token;
+	if (*item == '\0')
+	{
+		_select_error(s, "Expected a list after keyword");
+		return;
+	}
+	while (item != NULL and s->e == 0)
+	{
+		char* comma = strchr(item, ',');
+		if (comma != NULL)
+			*comma = '\0';
+		
+		long v = -1;
+		char* end;
+		switch (instr->op)
+		{
+			case SELECT_CHAIN:
+				v = chain_find_chain(chain, item);
+			break;
+			
+			case SELECT_RES_NAME:
+				v = __select_lookup((const char*)chain->cols.res_name_table, chain->cols.res_name_table_len, \
+				                    sizeof(chain->cols.res_name_table[0]), item);
+			break;
+			
+			case SELECT_ATOM_NAME:
+				if (strlen(item) > 4)
+					_select_error(s, "Atom names have at most four characters");
+				v = atom_name_key(item);
+			break;
+			
+			case SELECT_ELEMENT:
+				for (char* c = item; *c != '\0'; ++c)
+					*c = (*c >= 'a' and *c <= 'z') ? *c - 'a' + 'A' : *c;
+				v = (strlen(item) <= 2) ? element_code(item) : 0;
+				if (v == 0 or (strlen(item) == 2 and v != 34))    // SE is the only two-letter element read.
+					_select_error(s, "Unknown element");
+			break;
+			
+			case SELECT_RES_ID:
+			case SELECT_ID:
+			{
+				// A number, or a range lo-hi. Values are clamped to INT_MAX, which is as high as they are read.
+				// A residue number on its own, with or without an insertion code, names one residue exactly.
+				unsigned long lo = strtoul(item, &end, 10);
+				unsigned long hi = lo;
+				bool          exact = (instr->op == SELECT_RES_ID and end != item and *end != '-');
+				char          icode = '\0';
+				if (exact and ((*end >= 'A' and *end <= 'Z') or (*end >= 'a' and *end <= 'z')))
+					icode = *end++;
+				if (end != item and *end == '-')
+				{
+					const char* start = end + 1;
+					hi = strtoul(start, &end, 10);
+					if (end == start)
+						end = (char*)start - 1;
+				}
+				if (end == item or *end != '\0')
+				{
+					_select_error(s, "Expected a number or range lo-hi");
+					break;
+				}
+				if (instr->values_len + 2 > STARBOARD_SELECT_VALUES_MAX)
+				{
+					_select_error(s, "Too many values in list");
+					break;
+				}
+				lo = (lo < INT_MAX) ? lo : INT_MAX;
+				hi = (hi < INT_MAX) ? hi : INT_MAX;
+				instr->values[instr->values_len++] = exact ? ((uint32_t)lo | STARBOARD_SELECT_EXACT) : (uint32_t)lo;
+				instr->values[instr->values_len++] = exact ? (uint32_t)(unsigned char)icode : (uint32_t)hi;
+			}
+			break;
+			
+			default:
+			break;
+		}
+		if (v >= 0 and instr->op != SELECT_RES_ID and instr->op != SELECT_ID and s->e == 0)
+		{
+			if (instr->values_len == STARBOARD_SELECT_VALUES_MAX)
+				_select_error(s, "Too many values in list");
+			else
+				instr->values[instr->values_len++] = (uint32_t)v;
+		}
+		item = (comma != NULL) ? comma + 1 : NULL;
+	}
+	if (instr->values_len == 0)
+		instr->op = SELECT_NONE;
+	_select_next(s);
+}
+
+
+
+static void _select_or(select_parser_t*);
+
+
+
+/* primary := '(' or ')' | all | none | keyword list | within R of unary
+ * unary   := not unary | primary
+ */
+static void _select_unary(select_parser_t* s)
+{
+	if (s->e < 0)
+		return;
+	
+	static const struct
+	{
+		const char* keyword;
+		select_op_t op;
+	} KEYWORDS[] = \
+	{ \
+		{"chain", SELECT_CHAIN}, \
+		{"resn",  SELECT_RES_NAME}, \
+		{"name",  SELECT_ATOM_NAME}, \
+		{"elem",  SELECT_ELEMENT}, \
+		{"resi",  SELECT_RES_ID}, \
+		{"id",    SELECT_ID} \
+	};
+	
+	const char* t = s->token;
+	if (strcasecmp(t, "not") == 0)
+	{
+		_select_next(s);
+		_select_unary(s);
+		_select_emit(s, SELECT_NOT);
+	}
+	else if (strcmp(t, "(") == 0)
+	{
+		_select_next(s);
+		_select_or(s);
+		if (strcmp(s->token, ")") != 0)
+			_select_error(s, "Expected )");
+		_select_next(s);
+	}
+	else if (strcasecmp(t, "all") == 0 or strcasecmp(t, "none") == 0)
+	{
+		_select_emit(s, (strcasecmp(t, "all") == 0) ? SELECT_ALL : SELECT_NONE);
+		_select_next(s);
+	}
+	else if (strcasecmp(t, "within") == 0)
+	{
+		_select_next(s);
+		char* end;
+		float radius = strtof(s->token, &end);
+		if (end == s->token or *end != '\0' or not (radius >= 0.0))
+		{
+			_select_error(s, "Expected a distance after within");
+			return;
+		}
+		_select_next(s);
+		if (strcasecmp(s->token, "of") != 0)
+		{
+			_select_error(s, "Expected of");
+			return;
+		}
+		_select_next(s);
+		_select_unary(s);
+		select_instr_t* instr = _select_emit(s, SELECT_WITHIN);
+		if (instr != NULL)
+			instr->radius = radius;
+	}
+	else
+	{
+		for (unsigned int i = 0; i < sizeof(KEYWORDS) / sizeof(KEYWORDS[0]); ++i)
+			if (strcasecmp(t, KEYWORDS[i].keyword) == 0)
+			{
+				_select_next(s);
+				select_instr_t* instr = _select_emit(s, KEYWORDS[i].op);
+				if (instr != NULL)
+					_select_list(s, instr);
+				return;
+			}
+		_select_error(s, "Expected a selection");
+	}
+}
+
+
+
+/* and := unary (and unary)*
+ */
+static void _select_and(select_parser_t* s)
+{
+	_select_unary(s);
+	while (s->e == 0 and strcasecmp(s->token, "and") == 0)
+	{
+		_select_next(s);
+		_select_unary(s);
+		_select_emit(s, SELECT_AND);
+	}
+}
+
+
+
+/* or := and (or and)*
+ */
+static void _select_or(select_parser_t* s)
+{
+	_select_and(s);
+	while (s->e == 0 and strcasecmp(s->token, "or") == 0)
+	{
+		_select_next(s);
+		_select_and(s);
+		_select_emit(s, SELECT_OR);
+	}
+}
+
+
+
+/* Compile a selection string against a chain, whose columns must have been built.
+ * Returns: 0 success; -1 syntax error; -2 too deeply nested.
+ */
+int select_compile(selection_t* out, const chain_t* chain, const char* text)
+{
+	select_parser_t s = {.p = text, .chain = chain, .out = out, .e = 0};
+	out->code_len = 0;
+	_select_next(&s);
+	_select_or(&s);
+	if (s.e == 0 and s.token[0] != '\0')
+		_select_error(&s, "Unexpected text after selection");
+	if (s.e < 0)
+		return -1;
+	
+	// Check how many bitsets evaluation needs at once.
+	int depth = 0;
+	for (unsigned int i = 0; i < out->code_len; ++i)
+	{
+		const select_op_t op = out->code[i].op;
+		depth += (op == SELECT_AND or op == SELECT_OR) ? -1 : (op == SELECT_NOT or op == SELECT_WITHIN) ? 0 : 1;
+		if (depth + (op == SELECT_WITHIN) > STARBOARD_SELECT_DEPTH_MAX)    // `within` needs a scratch bitset.
+		{
+			printf("[ERROR] %s\n", "Selection is too deeply nested.");
+			return -2;
+		}
+	}
+	return 0;
+}
+
+
+
+//
+// Evaluation: each predicate scans one column, 16 atoms at a time, into a bitset. Every column is padded to a
+// whole cache line, so the last block may read past the last atom; the bits for those are cleared at the end.
+//
+
+/* Set the bit of every atom whose uint8 column value is in the list.
+ */
+static void _select_u8_in(const uint8_t* col, const unsigned int n, const uint32_t* values, const unsigned int k, \
+                          uint64_t* bits)
+{
+	for (unsigned int i = 0; i < n; i += 16)
+	{
+		unsigned int mask = 0;
+		#ifdef __SSE2__
+		const __m128i v = _mm_load_si128((const __m128i*)(col + i));
+		__m128i       m = _mm_setzero_si128();
+		for (unsigned int j = 0; j < k; ++j)
+			m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8((char)values[j])));
+		mask = (unsigned int)_mm_movemask_epi8(m);
+		#else
+		for (unsigned int b = 0; b < 16; ++b)
+			for (unsigned int j = 0; j < k; ++j)
+				mask |= (unsigned int)(col[i + b] == values[j]) << b;
+		#endif
+		bits[i / 64] |= (uint64_t)mask << (i % 64);
+	}
+}
+
+
+
+/* Set the bit of every atom whose uint16 column value is in the list.
+ */
+static void _select_u16_in(const uint16_t* col, const unsigned int n, const uint32_t* values, const unsigned int k, \
+                           uint64_t* bits)
+{
+	for (unsigned int i = 0; i < n; i += 16)
+	{
+		unsigned int mask = 0;
+		#ifdef __SSE2__
+		const __m128i lo = _mm_load_si128((const __m128i*)(col + i));
+		const __m128i hi = _mm_load_si128((const __m128i*)(col + i + 8));
+		__m128i       ml = _mm_setzero_si128();
+		__m128i       mh = _mm_setzero_si128();
+		for (unsigned int j = 0; j < k; ++j)
+		{
+			const __m128i v = _mm_set1_epi16((short)values[j]);
+			ml = _mm_or_si128(ml, _mm_cmpeq_epi16(lo, v));
+			mh = _mm_or_si128(mh, _mm_cmpeq_epi16(hi, v));
+		}
+		mask = (unsigned int)_mm_movemask_epi8(_mm_packs_epi16(ml, mh));
+		#else
+		for (unsigned int b = 0; b < 16; ++b)
+			for (unsigned int j = 0; j < k; ++j)
+				mask |= (unsigned int)(col[i + b] == values[j]) << b;
+		#endif
+		bits[i / 64] |= (uint64_t)mask << (i % 64);
+	}
+}
+
+
+
+/* Set the bit of every atom whose uint32 column value is in the list.
+ */
+static void _select_u32_in(const uint32_t* col, const unsigned int n, const uint32_t* values, const unsigned int k, \
+                           uint64_t* bits)
+{
+	for (unsigned int i = 0; i < n; i += 16)
+	{
+		unsigned int mask = 0;
+		#ifdef __SSE2__
+		for (unsigned int q = 0; q < 4; ++q)
+		{
+			const __m128i v = _mm_load_si128((const __m128i*)(col + i + 4 * q));
+			__m128i       m = _mm_setzero_si128();
+			for (unsigned int j = 0; j < k; ++j)
+				m = _mm_or_si128(m, _mm_cmpeq_epi32(v, _mm_set1_epi32((int)values[j])));
+			mask |= (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(m)) << (4 * q);
+		}
+		#else
+		for (unsigned int b = 0; b < 16; ++b)
+			for (unsigned int j = 0; j < k; ++j)
+				mask |= (unsigned int)(col[i + b] == values[j]) << b;
+		#endif
+		bits[i / 64] |= (uint64_t)mask << (i % 64);
+	}
+}
+
+
+
+/* Set the bit of every atom whose unsigned integer column value is in one of the ranges, given as lo, hi pairs.
+ * Column values are at most INT_MAX, so signed comparisons are safe.
+ */
+static void _select_u32_ranges(const unsigned int* col, const unsigned int n, const uint32_t* values, \
+                               const unsigned int k, uint64_t* bits)
+{
+	for (unsigned int i = 0; i < n; i += 16)
+	{
+		unsigned int mask = 0;
+		#ifdef __SSE2__
+		for (unsigned int q = 0; q < 4; ++q)
+		{
+			const __m128i v = _mm_load_si128((const __m128i*)(col + i + 4 * q));
+			__m128i       m = _mm_setzero_si128();
+			for (unsigned int j = 0; j + 1 < k; j += 2)
+			{
+				const __m128i out = _mm_or_si128(_mm_cmpgt_epi32(_mm_set1_epi32((int)values[j]), v), \
+				                                 _mm_cmpgt_epi32(v, _mm_set1_epi32((int)values[j + 1])));
+				m = _mm_or_si128(m, _mm_andnot_si128(out, _mm_set1_epi32(-1)));
+			}
+			mask |= (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(m)) << (4 * q);
+		}
+		#else
+		for (unsigned int b = 0; b < 16; ++b)
+			for (unsigned int j = 0; j + 1 < k; j += 2)
+				mask |= (unsigned int)(col[i + b] >= values[j] and col[i + b] <= values[j + 1]) << b;
+		#endif
+		bits[i / 64] |= (uint64_t)mask << (i % 64);
+	}
+}
+
+
+
+/* Set the bits of atoms [begin, end).
+ */
+static inline void __select_set_run(uint64_t* bits, const unsigned int begin, const unsigned int end)
+{
+	const unsigned int first = begin / 64;
+	const unsigned int last  = (end - 1) / 64;
+	const uint64_t     head  = ~(uint64_t)0 << (begin % 64);
+	const uint64_t     tail  = ~(uint64_t)0 >> (63 - (end - 1) % 64);
+	if (first == last)
+	{
+		bits[first] |= head & tail;
+		return;
+	}
+	bits[first] |= head;
+	for (unsigned int w = first + 1; w < last; ++w)
+		bits[w] = ~(uint64_t)0;
+	bits[last] |= tail;
+}
+
+
+
+/* Set the bits of the atoms of every residue whose number is in one of the ranges, given as lo, hi pairs, or that
+ * one of the exact pairs names. An exact pair looks its residue up in each chain with the residue hash; only if
+ * there are ranges are the residues scanned, each tested once, rather than each of its atoms.
+ */
+static void _select_res_ranges(const chain_t* chain, const uint32_t* values, const unsigned int k, uint64_t* bits)
+{
+	const residues_t* r      = &chain->residues;
+	bool              ranges = false;
+	for (unsigned int j = 0; j + 1 < k; j += 2)
+	{
+		if (not (values[j] & STARBOARD_SELECT_EXACT))
+		{
+			ranges = true;
+			continue;
+		}
+		const unsigned int res_id = values[j] & ~STARBOARD_SELECT_EXACT;
+		for (unsigned int chn = 0; chn < chain->cols.chain_table_len; ++chn)
+			for (int i = chain_find_residue(chain, chn, res_id, (char)values[j + 1], -1); i >= 0; \
+			     i = chain_find_residue(chain, chn, res_id, (char)values[j + 1], i))
+				__select_set_run(bits, r->starts[i], r->starts[i + 1]);
+	}
+	if (not ranges)
+		return;
+	
+	for (unsigned int i = 0; i < r->len; ++i)
+	{
+		const unsigned int res_id = chain->cols.res_ids[r->starts[i]];
+		bool               in     = false;
+		for (unsigned int j = 0; j + 1 < k; j += 2)
+			in |= (not (values[j] & STARBOARD_SELECT_EXACT) and res_id >= values[j] and res_id <= values[j + 1]);
+		if (in)
+			__select_set_run(bits, r->starts[i], r->starts[i + 1]);
+	}
+}
+
+
+
+/* Set the bit of every atom within radius r of an atom in src. The atoms of src are bucketed into a grid of
+ * cells at least r wide, so each atom only has to be tested against the atoms in the 27 cells around it.
+ * Returns 0 on success, or -2 out of memory.
+ */
+static int _select_within(const chain_t* chain, const uint64_t* src, const float r, uint64_t* bits)
+{
+	const columns_t*   c     = &chain->cols;
+	const unsigned int n     = chain->atoms_len;
+	const unsigned int words = (n + 63) / 64;
+	
+	// Find the bounds of the source atoms.
+	unsigned int s      = 0;
+	float        lo[3]  = {INFINITY, INFINITY, INFINITY};
+	float        hi[3]  = {-INFINITY, -INFINITY, -INFINITY};
+	for (unsigned int w = 0; w < words; ++w)
+		for (uint64_t b = src[w]; b != 0; b &= b - 1)
+		{
+			const unsigned int i = 64 * w + __builtin_ctzll(b);
+			const float        p[3] = {c->x[i], c->y[i], c->z[i]};
+			for (unsigned int d = 0; d < 3; ++d)
+			{
+				lo[d] = (p[d] < lo[d]) ? p[d] : lo[d];
+				hi[d] = (p[d] > hi[d]) ? p[d] : hi[d];
+			}
+			++s;
+		}
+	if (s == 0)
+		return 0;
+	
+	// Choose the cell size: at least r, and large enough that the grid has not many more cells than atoms.
+	float        cell = (r > 1e-3f) ? r : 1e-3f;
+	unsigned int dims[3];
+	size_t       cells;
+	for (;;)
+	{
+		cells = 1;
+		for (unsigned int d = 0; d < 3; ++d)
+		{
+			dims[d] = (unsigned int)((hi[d] - lo[d]) / cell) + 1;
+			cells  *= dims[d];
+		}
+		if (cells <= 8 * (size_t)s + 4096)
+			break;
+		cell *= 1.5f;
+	}
+	
+	// Sort the source atoms by cell, keeping their coordinates together.
+	unsigned int* starts = (unsigned int*)calloc(cells + 1, sizeof(unsigned int));    // malloc starts
+	float*        points = (float*)malloc(3 * (size_t)s * sizeof(float));            // malloc points
+	unsigned int* keys   = (unsigned int*)malloc((size_t)s * sizeof(unsigned int));   // malloc keys
+	if (starts == NULL or points == NULL or keys == NULL)
+	{
+		free(starts);
+		free(points);
+		free(keys);
+		return -2;
+	}
+	#define STARBOARD_SELECT_CELL(X, D) ((unsigned int)(((X) - lo[D]) / cell))
+	unsigned int j = 0;
+	for (unsigned int w = 0; w < words; ++w)
+		for (uint64_t b = src[w]; b != 0; b &= b - 1)
+		{
+			const unsigned int i = 64 * w + __builtin_ctzll(b);
+			keys[j] = (STARBOARD_SELECT_CELL(c->z[i], 2) * dims[1] + STARBOARD_SELECT_CELL(c->y[i], 1)) * dims[0] \
+			          + STARBOARD_SELECT_CELL(c->x[i], 0);
+			++starts[keys[j] + 1];
+			++j;
+		}
+	for (size_t k = 0; k < cells; ++k)
+		starts[k + 1] += starts[k];
+	j = 0;
+	for (unsigned int w = 0; w < words; ++w)
+		for (uint64_t b = src[w]; b != 0; b &= b - 1)
+		{
+			const unsigned int i = 64 * w + __builtin_ctzll(b);
+			const unsigned int k = starts[keys[j]]++;
+			points[3 * k + 0] = c->x[i];
+			points[3 * k + 1] = c->y[i];
+			points[3 * k + 2] = c->z[i];
+			++j;
+		}
+	for (size_t k = cells; k > 0; --k)    // Undo the increments, so starts[k] is the first point of cell k again.
+		starts[k] = starts[k - 1];
+	starts[0] = 0;
+	
+	// Mark the cells that have a source atom in or around them, so most atoms are rejected with one lookup.
+	uint8_t* near = (uint8_t*)calloc(cells, sizeof(uint8_t));    // malloc near
+	if (near == NULL)
+	{
+		free(starts);
+		free(points);
+		free(keys);
+		return -2;
+	}
+	for (unsigned int z = 0; z < dims[2]; ++z)
+		for (unsigned int y = 0; y < dims[1]; ++y)
+			for (unsigned int x = 0; x < dims[0]; ++x)
+			{
+				const size_t k = ((size_t)z * dims[1] + y) * dims[0] + x;
+				if (starts[k] == starts[k + 1])
+					continue;
+				for (unsigned int zz = (z > 0 ? z - 1 : 0); zz <= z + 1 and zz < dims[2]; ++zz)
+					for (unsigned int yy = (y > 0 ? y - 1 : 0); yy <= y + 1 and yy < dims[1]; ++yy)
+						for (unsigned int xx = (x > 0 ? x - 1 : 0); xx <= x + 1 and xx < dims[0]; ++xx)
+							near[((size_t)zz * dims[1] + yy) * dims[0] + xx] = 1;
+			}
+	
+	// Test every atom against the cells around it.
+	const float r2 = r * r;
+	for (unsigned int i = 0; i < n; ++i)
+	{
+		// Atoms outside the grid can only be near its boundary cells, so clamp them there; the distance test is
+		// exact either way.
+		const float p[3] = {c->x[i], c->y[i], c->z[i]};
+		int         q[3];
+		bool        outside = false;
+		for (unsigned int d = 0; d < 3; ++d)
+		{
+			const float f = (p[d] - lo[d]) / cell;
+			outside = outside or not (f >= -1.0f and f < (float)dims[d] + 1.0f);
+			q[d]    = (f < 0.0f) ? 0 : (f >= (float)dims[d]) ? (int)dims[d] - 1 : (int)f;
+		}
+		if (outside or not near[((size_t)q[2] * dims[1] + q[1]) * dims[0] + q[0]])
+			continue;
+		bool found = false;
+		for (int z = q[2] - 1; z <= q[2] + 1 and not found; ++z)
+			for (int y = q[1] - 1; y <= q[1] + 1 and not found; ++y)
+				for (int x = q[0] - 1; x <= q[0] + 1 and not found; ++x)
+				{
+					if (x < 0 or y < 0 or z < 0 or x >= (int)dims[0] or y >= (int)dims[1] or z >= (int)dims[2])
+						continue;
+					const size_t k = ((size_t)z * dims[1] + y) * dims[0] + x;
+					for (unsigned int m = starts[k]; m < starts[k + 1]; ++m)
+					{
+						const float dx = points[3 * m + 0] - p[0];
+						const float dy = points[3 * m + 1] - p[1];
+						const float dz = points[3 * m + 2] - p[2];
+						if (dx * dx + dy * dy + dz * dz <= r2)
+						{
+							found = true;
+							break;
+						}
+					}
+				}
+		bits[i / 64] |= (uint64_t)found << (i % 64);
+	}
+	#undef STARBOARD_SELECT_CELL
+	
+	free(near);
+	free(starts);
+	free(points);
+	free(keys);
+	return 0;
+}
+
+
+
+/* Evaluate a compiled selection against the chain it was compiled for, writing one bit per atom to out, which
+ * must have room for (atoms_len + 63) / 64 words.
+ * Returns the number of atoms selected, or less than 0 on error.
+ */
+int select_eval(const selection_t* sel, const chain_t* chain, uint64_t* out)
+{
+	const columns_t*   c     = &chain->cols;
+	const unsigned int n     = chain->atoms_len;
+	const size_t       words = (n + 63) / 64;
+	const size_t       bytes = (words > 0 ? words : 1) * sizeof(uint64_t);
+	const size_t       last  = (words > 0) ? words - 1 : 0;
+	const uint64_t     tail  = (n % 64 != 0) ? ((uint64_t)1 << (n % 64)) - 1 : ~(uint64_t)0;
+	uint64_t*          stack = (uint64_t*)malloc(STARBOARD_SELECT_DEPTH_MAX * bytes);    // malloc stack
+	if (stack == NULL)
+		return -2;
+	
+	unsigned int top = 0;    // The number of bitsets on the stack.
+	int          e   = 0;
+	for (unsigned int i = 0; i < sel->code_len and e == 0; ++i)
+	{
+		const select_instr_t* instr = &sel->code[i];
+		uint64_t*             a     = stack + (top - 1) * words;    // The top, for unary and binary operations.
+		uint64_t*             b     = stack + top * words;          // A new bitset, for predicates.
+		switch (instr->op)
+		{
+			case SELECT_NOT:
+				for (size_t w = 0; w < words; ++w)
+					a[w] = ~a[w];
+				a[last] &= tail;
+				continue;
+			
+			case SELECT_AND:
+			case SELECT_OR:
+			{
+				uint64_t* l = a - words;
+				if (instr->op == SELECT_AND)
+					for (size_t w = 0; w < words; ++w)
+						l[w] &= a[w];
+				else
+					for (size_t w = 0; w < words; ++w)
+						l[w] |= a[w];
+				--top;
+			}
+			continue;
+			
+			case SELECT_WITHIN:
+				memcpy(b, a, bytes);    // b is free scratch space above the top.
+				memset(a, 0, bytes);
+				e = _select_within(chain, b, instr->radius, a);
+				continue;
+			
+			default:
+			break;
+		}
+		
+		// Everything else pushes the result of a predicate.
+		memset(b, 0, bytes);
+		++top;
+		const uint32_t*    v = instr->values;
+		const unsigned int k = instr->values_len;
+		switch (instr->op)
+		{
+			case SELECT_ALL:       memset(b, 0xff, bytes);                                  break;
+			case SELECT_CHAIN:     _select_u16_in(c->chains, n, v, k, b);                  break;
+			case SELECT_RES_NAME:  _select_u16_in(c->res_names, n, v, k, b);               break;
+			case SELECT_ATOM_NAME: _select_u32_in(c->atom_names, n, v, k, b);              break;
+			case SELECT_ELEMENT:   _select_u8_in(c->elements, n, v, k, b);                 break;
+			case SELECT_RES_ID:    _select_res_ranges(chain, v, k, b);                     break;
+			case SELECT_ID:        _select_u32_ranges(c->ids, n, v, k, b);                 break;
+			default:                                                                        break;
+		}
+		
+		// Clear the bits past the last atom, which the block-wise predicates may have set, before anything reads
+		// them, e.g. `within`, which would take them for atoms.
+		b[last] &= tail;
+	}
+	
+	int count = e;
+	if (e == 0)
+	{
+		memcpy(out, stack, words * sizeof(uint64_t));
+		for (size_t w = 0; w < words; ++w)
+			count += __builtin_popcountll(out[w]);
+	}
+	free(stack);
+	return count;
+}
+
+
+
+/* Compile and evaluate a selection string, allocating the bitset.
+ * Returns the number of atoms selected, or less than 0 on error.
+ */
+int select_atoms(const chain_t* chain, const char* text, uint64_t** out)
+{
+	selection_t sel;
+	int e = select_compile(&sel, chain, text);
+	if (e < 0)
+		return e;
+	const size_t words = (chain->atoms_len + 63) / 64;
+	*out = (uint64_t*)malloc((words > 0 ? words : 1) * sizeof(uint64_t));    // malloc *out
+	if (*out == NULL)
+		return -3;
+	e = select_eval(&sel, chain, *out);
+	if (e < 0)
+	{
+		free(*out);
+		*out = NULL;
+	}
+	return e;
+}
+
+
+
+/* Write the index of every selected atom to out, in order.
+ * Returns the number of atoms selected.
+ */
+int select_indices(const uint64_t* bits, const unsigned int n, unsigned int* out)
+{
+	unsigned int found = 0;
+	for (unsigned int w = 0; w < (n + 63) / 64; ++w)
+		for (uint64_t b = bits[w]; b != 0; b &= b - 1)
+			out[found++] = 64 * w + __builtin_ctzll(b);
+	return found;
+}
@@ -0,0 +1,91 @@
+#ifndef STARBOARD_SELECT
+#define STARBOARD_SELECT
+
+#include <iso646.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "pdb.h"
+
+
+//
+// A small atom selection language, compiled against a chain into predicates over its columns and evaluated into
+// bitsets, one bit per atom. For example:
+//
+//     name CA and chain A,B and resi 10-20,25
+//     within 5.0 of (resn HEM or elem SE) and not resn HOH
+//
+// The primaries are `all`, `none`, `chain`, `resn`, `name` and `elem` (each taking a comma-separated list),
+// `resi` and `id` (taking a comma-separated list of numbers or lo-hi ranges), and `within R of X`. They combine
+// with `not`, `and`, `or` (in decreasing order of precedence) and parentheses. A range of residue numbers takes in
+// every insertion code, while a single residue number names one residue in each chain, e.g. `resi 52` is residue 52
+// without an insertion code and `resi 52A` the one inserted after it.
+//
+
+#define STARBOARD_SELECT_CODE_MAX   64    // Instructions in a compiled selection.
+#define STARBOARD_SELECT_VALUES_MAX 32    // Values in one list, where a range counts as two.
+#define STARBOARD_SELECT_DEPTH_MAX  16    // Bitsets on the evaluation stack at once.
+#define STARBOARD_SELECT_EXACT      0x80000000u    // Marks a residue number and insertion code pair in `resi`.
+
+
+
+/* The instructions of a compiled selection, which run on a stack of bitsets.
+ */
+typedef enum select_op
+{
+	SELECT_ALL,
+	SELECT_NONE,
+	SELECT_CHAIN,        // Interned chain ids.
+	SELECT_RES_NAME,     // Interned residue name ids.
+	SELECT_ATOM_NAME,    // Atom name keys.
+	SELECT_ELEMENT,      // Atomic numbers.
+	SELECT_RES_ID,       // Ranges of residue numbers as lo, hi pairs, or exact residue number, insertion code pairs.
+	SELECT_ID,           // Ranges of atom serial numbers, as lo, hi pairs.
+	SELECT_WITHIN,       // Replace the top of the stack by every atom within radius of it.
+	SELECT_NOT,
+	SELECT_AND,
+	SELECT_OR
+} select_op_t;
+
+
+
+/* One instruction, and the values it tests against.
+ */
+typedef struct select_instr
+{
+	select_op_t  op;
+	unsigned int values_len;
+	uint32_t     values[STARBOARD_SELECT_VALUES_MAX];
+	float        radius;
+} select_instr_t;
+
+
+
+/* A selection compiled for one chain. Names are resolved to the chain's interned ids, so it can only be
+ * evaluated against the chain it was compiled for.
+ */
+typedef struct selection
+{
+	select_instr_t code[STARBOARD_SELECT_CODE_MAX];
+	unsigned int   code_len;
+} selection_t;
+
+
+
+extern int select_compile(selection_t*, const chain_t*, const char*);
+
+extern int select_eval(const selection_t*, const chain_t*, uint64_t*);
+
+extern int select_atoms(const chain_t*, const char*, uint64_t**);
+
+extern int select_indices(const uint64_t*, const unsigned int, unsigned int*);
+
+#endif
@@ -1,8 +1,98 @@
+#include <iso646.h>
 #include <GL/glew.h>
 #include <GL/gl.h>
 
 
 
+// The uniforms that are set as objects are drawn, whose locations are found once, as each program is created,
+// rather than on every draw. A program that does not use one has -1 for it.
+typedef enum shader_uniform
+{
+	SHADER_UNIFORM_OUTLINE,
+	SHADER_UNIFORM_RESIDUE_COLORS,
+	SHADER_UNIFORM_RESIDUE_ATTRIBUTES,
+	SHADER_UNIFORM_COLORMAPS,
+	SHADER_UNIFORM_OBJECT_TRANSFORMS,
+	SHADER_UNIFORM_INSTANCE_FIRST,
+	SHADER_UNIFORM_INSTANCE_LIST,
+	SHADER_UNIFORM_INSTANCE_OPERATORS,
+	SHADER_UNIFORM_LEN
+} shader_uniform_t;
+
+static const char* SHADER_UNIFORM_NAMES[SHADER_UNIFORM_LEN] = \
+{ \
+	"outline", "residue_colors", "residue_attributes", "colormaps", "object_transforms", "instance_first", \
+	"instance_list", "instance_operators" \
+};
+
+// The texture unit that each sampler reads, which is set as its program is created, or -1 for other uniforms.
+static const GLint SHADER_UNIFORM_UNITS[SHADER_UNIFORM_LEN] = {-1, 0, 1, 2, 3, -1, 4, 5};
+
+// The binding of the uniform block of the camera's matrices, which every program shares (see GL/main.vert).
+#define STARBOARD_SHADER_CAMERA_BINDING 0
+
+// A hard limit on how many programs can be created.
+#define STARBOARD_SHADER_PROGRAMS_MAX 16
+
+// The code that every stage shares, which is compiled in after the #version line of each.
+#define STARBOARD_SHADER_COMMON "GL/residue.glsl"
+
+
+
+/* The locations of the uniforms of a program.
+ */
+typedef struct shader_locations
+{
+	GLuint program;
+	GLint  uniforms[SHADER_UNIFORM_LEN];
+} shader_locations_t;
+
+shader_locations_t ShaderLocations[STARBOARD_SHADER_PROGRAMS_MAX];
+unsigned int       ShaderLocationsLen;
+
+
+
+/* Find the locations of the uniforms of a program that shader_program_create_geometry() created.
+ * Returns them, in the order of shader_uniform_t, or NULL for any other program.
+ */
+const GLint* shader_uniforms(GLuint program)
+{
+	for (unsigned int i = 0; i < ShaderLocationsLen; ++i)
+		if (ShaderLocations[i].program == program)
+			return ShaderLocations[i].uniforms;
+	return NULL;
+}
+
+
+
+/* Look up the uniforms of a program that has just linked, once: find their locations, give each sampler its
+ * texture unit, and bind the camera's uniform block, if the program has them.
+ * Returns 0, or -1 if there is no room for another program.
+ */
+static int _reflect_program(GLuint program)
+{
+	if (ShaderLocationsLen == STARBOARD_SHADER_PROGRAMS_MAX)
+		return -1;
+	shader_locations_t* locations = &ShaderLocations[ShaderLocationsLen++];
+	locations->program = program;
+	GLint current;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+	glUseProgram(program);
+	for (unsigned int u = 0; u < SHADER_UNIFORM_LEN; ++u)
+	{
+		locations->uniforms[u] = glGetUniformLocation(program, SHADER_UNIFORM_NAMES[u]);
+		if (SHADER_UNIFORM_UNITS[u] >= 0 and locations->uniforms[u] >= 0)
+			glUniform1i(locations->uniforms[u], SHADER_UNIFORM_UNITS[u]);
+	}
+	glUseProgram((GLuint)current);
+	GLuint camera = glGetUniformBlockIndex(program, "Camera");
+	if (camera != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, camera, STARBOARD_SHADER_CAMERA_BINDING);
+	return 0;
+}
+
+
+
 /* TODO.
  */
 static inline int _get_all(char* filename, char** out)
@@ -42,81 +132,114 @@ static inline int _get_all(char* filename, char** out)
 
 
 
-/* TODO.
+/* Load and compile the shader of one stage (vertex, geometry or fragment) from a file, named in errors by what,
+ * with the common code (STARBOARD_SHADER_COMMON) put in after its #version line. The lines after that are numbered
+ * as they are in the file, so that errors point into it.
+ * Returns 0 on success, -1 if a file could not be read, or -2 if it did not compile.
  */
-int shader_program_create(char* vertex_shader_filename, char* fragment_shader_filename, GLuint* shader_out)
+static int _compile_shader(GLenum stage, char* filename, const char* what, GLuint* shader_out)
 {
 	GLint  e;
 	GLchar s[1024];
 	
-	
-	// Vertex shader.
-	// 
-	
-	// Load the vertex shader code.
-	char* vertex_shader_code;
-	e = (GLint)_get_all(vertex_shader_filename, &vertex_shader_code); // malloc vertex_shader_code
+	// Load the shader code, and the code that every stage shares.
+	char* code;
+	char* common;
+	e = (GLint)_get_all(filename, &code); // malloc code
+	if (e < 0)
+	{
+		printf("[ERROR] %s %s %s: %i.\n", "Call to _get_all(...) for", what, "shader failed with code", e);
+		return -1;
+	}
+	e = (GLint)_get_all(STARBOARD_SHADER_COMMON, &common); // malloc common
 	if (e < 0)
 	{
-		printf("[ERROR] %s: %i.\n", "Call to _get_all(...) for vertex shader failed with code", e);
+		printf("[ERROR] %s %s: %i.\n", "Call to _get_all(...) for the code that shaders share failed with code", \
+		       STARBOARD_SHADER_COMMON, e);
+		free(code);
 		return -1;
 	}
 	
+	// Split the code after its #version line, which must come first.
+	char*         rest       = strchr(code, '\n');
+	rest                     = (rest != NULL) ? rest + 1 : code + strlen(code);
+	const GLchar* sources[4] = {code, common, "\n#line 2 0\n", rest};
+	const GLint   lengths[4] = {(GLint)(rest - code), -1, -1, -1};
 	
-	// Compile the vertex shader.
-	GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex_shader, 1, (const GLchar**)&vertex_shader_code, (GLvoid*)NULL);
-	glCompileShader(vertex_shader);
-	glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &e);
+	// Compile the shader.
+	*shader_out   = glCreateShader(stage);
+	GLuint shader = *shader_out;
+	glShaderSource(shader, 4, sources, lengths);
+	glCompileShader(shader);
+	free(code);   // free code
+	free(common); // free common
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &e);
 	if (e == GL_FALSE)
 	{
-		glGetShaderInfoLog(vertex_shader, 1024, (GLvoid*)NULL, s);
-		printf("[ERROR] %s: %i:\n", "Failed to compile vertex shader with code", e);
+		glGetShaderInfoLog(shader, 1024, (GLvoid*)NULL, s);
+		printf("[ERROR] %s %s %s: %i:\n", "Failed to compile", what, "shader with code", e);
 		printf("....... %s\n", s);
+		glDeleteShader(shader);
 		return -2;
 	}
+	return 0;
+}
+
+
+
+/* Create a shader program from a vertex shader, a geometry shader and a fragment shader, e.g. one that extrudes
+ * lines into surfaces. The geometry shader might be NULL, to go straight from the vertex to the fragment shader.
+ * The locations of its uniforms are found once, here (see shader_uniforms()).
+ * Returns the program, or an error code: -1 or -2 from the vertex shader, -3 or -4 from the fragment shader,
+ * -5 if the program did not link, -6 or -7 from the geometry shader, or -8 if there are too many programs.
+ */
+int shader_program_create_geometry(char* vertex_shader_filename, char* geometry_shader_filename, \
+                                   char* fragment_shader_filename, GLuint* shader_out)
+{
+	GLint  e;
+	GLchar s[1024];
+	GLuint vertex_shader, geometry_shader, fragment_shader;
 	
-	
-	// Fragment shader.
-	//
-	
-	// Load the fragment shader code.
-	char* fragment_shader_code;
-	e = (GLint)_get_all(fragment_shader_filename, &fragment_shader_code); // malloc fragment_shader_code
+	// Compile each shader.
+	e = _compile_shader(GL_VERTEX_SHADER, vertex_shader_filename, "vertex", &vertex_shader);
 	if (e < 0)
+		return e;
+	if (geometry_shader_filename != NULL)
 	{
-		printf("[ERROR] %s: %i.\n", "Call to _get_all(...) for fragment shader failed with code", e);
-		return -3;
+		e = _compile_shader(GL_GEOMETRY_SHADER, geometry_shader_filename, "geometry", &geometry_shader);
+		if (e < 0)
+		{
+			glDeleteShader(vertex_shader);
+			return e - 5;
+		}
 	}
-	
-	// Compile the fragment shader.
-	GLint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment_shader, 1, (const GLchar**)&fragment_shader_code, (GLvoid*)NULL);
-	glCompileShader(fragment_shader);
-	glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &e);
-	if (e == GL_FALSE)
+	e = _compile_shader(GL_FRAGMENT_SHADER, fragment_shader_filename, "fragment", &fragment_shader);
+	if (e < 0)
 	{
-		glGetShaderInfoLog(fragment_shader, 1024, (GLvoid*)NULL, s);
-		printf("[ERROR] %s: %i:\n", "Failed to compile fragment shader with code", e);
-		printf("....... %s\n", s);
 		glDeleteShader(vertex_shader);
-		return -4;
+		if (geometry_shader_filename != NULL)
+			glDeleteShader(geometry_shader);
+		return e - 2;
 	}
 	
 	
 	// Linking.
 	//
 	
-	// Attach the vertex and fragment shaders to a shader program.
+	// Attach the shaders to a shader program.
 	*shader_out   = glCreateProgram();
 	GLuint shader = *shader_out;
 	glAttachShader(shader, vertex_shader);
+	if (geometry_shader_filename != NULL)
+		glAttachShader(shader, geometry_shader);
 	glAttachShader(shader, fragment_shader);
 	
 	// Link the shaders into a shader program.
 	glLinkProgram(shader);
 	glGetProgramiv(shader, GL_LINK_STATUS, &e);
 	glDeleteShader(vertex_shader);
+	if (geometry_shader_filename != NULL)
+		glDeleteShader(geometry_shader);
 	glDeleteShader(fragment_shader);  
 	if (e == GL_FALSE)
 	{
@@ -125,9 +248,19 @@ int shader_program_create(char* vertex_shader_filename, char* fragment_shader_fi
 		printf("....... %s\n", s);
 		return -5;
 	}
+	if (_reflect_program(shader) < 0)
+	{
+		printf("[ERROR] %s %u.\n", "Too many shader programs; the most is", STARBOARD_SHADER_PROGRAMS_MAX);
+		return -8;
+	}
 	return shader;
-	
-	// Clean up.
-	free(vertex_shader_code); // free vertex_shader_code, fragment_shader_code
-	free(fragment_shader_code);
+}
+
+
+
+/* Create a shader program from a vertex shader and a fragment shader.
+ */
+int shader_program_create(char* vertex_shader_filename, char* fragment_shader_filename, GLuint* shader_out)
+{
+	return shader_program_create_geometry(vertex_shader_filename, NULL, fragment_shader_filename, shader_out);
 }
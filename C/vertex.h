@@ -0,0 +1,97 @@
+#ifndef STARBOARD_VERTEX
+#define STARBOARD_VERTEX
+
+#include <iso646.h>
+#include <stdbool.h>
+#include <math.h>
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+
+//
+// Vertices go to the GPU packed into 12 bytes: a position quantized to 16 bits along each axis within a box around
+// the object, the slot of the object's transform (see scene.h), and the residue that the vertex belongs to, by
+// which the shader looks up its colour. A quantum is the size of the box over 65,534, i.e. a few thousandths of an
+// ångström for a box a few hundred ångströms across.
+//
+
+#define STARBOARD_VERTEX_QUANTA 32767    // Quanta either side of the centre of the box.
+
+
+
+/* A vertex as the GPU reads it.
+ */
+typedef struct packed_vertex
+{
+	GLshort  position[3];    // Quanta from the centre of the box along each axis.
+	GLushort object;         // Which is given as the vertex is uploaded, so that objects can be drawn together.
+	GLuint   residue;
+} packed_vertex_t;
+
+
+
+/* The box that packed positions are relative to: its centre, and the size of a quantum along each axis, so that a
+ * position is origin + scale * quanta, as the vertex shader unpacks it.
+ */
+typedef struct vertex_bounds
+{
+	GLfloat origin[3];
+	GLfloat scale[3];
+} vertex_bounds_t;
+
+
+
+/* Grow the box from low to high to hold n vertices of three components each.
+ */
+static inline void vertex_box(const GLfloat* components, unsigned int n, GLfloat low[3], GLfloat high[3])
+{
+	for (unsigned int i = 0; i < n; ++i)
+		for (unsigned int k = 0; k < 3; ++k)
+		{
+			low[k]  = fminf(low[k],  components[3 * i + k]);
+			high[k] = fmaxf(high[k], components[3 * i + k]);
+		}
+}
+
+
+
+/* Find the bounds for a box from low to high, with a margin (Å) on every side. An empty box, i.e. one where low is
+ * above high, gets bounds around the origin.
+ */
+static inline void vertex_bounds_from_box(const GLfloat low[3], const GLfloat high[3], float margin, \
+                                          vertex_bounds_t* out)
+{
+	for (unsigned int k = 0; k < 3; ++k)
+	{
+		const bool empty = (low[k] > high[k]);
+		out->origin[k] = empty ? 0.0 : 0.5 * (low[k] + high[k]);
+		out->scale[k]  = ((empty ? 0.0 : 0.5 * (high[k] - low[k])) + margin) / STARBOARD_VERTEX_QUANTA;
+	}
+}
+
+
+
+/* Pack a vertex of three components within the bounds, and give it a residue. A position outside the bounds is
+ * clamped to their edge.
+ * Returns whether the position was inside the bounds.
+ */
+static inline bool pack_vertex(const GLfloat* components, GLuint residue, const vertex_bounds_t* bounds, \
+                               packed_vertex_t* out)
+{
+	bool inside = true;
+	for (unsigned int k = 0; k < 3; ++k)
+	{
+		float q = rintf((components[k] - bounds->origin[k]) / bounds->scale[k]);
+		if (not (q >= -STARBOARD_VERTEX_QUANTA and q <= STARBOARD_VERTEX_QUANTA))
+		{
+			inside = false;
+			q      = (q > 0.0) ? STARBOARD_VERTEX_QUANTA : -STARBOARD_VERTEX_QUANTA;
+		}
+		out->position[k] = (GLshort)q;
+	}
+	out->object  = 0;
+	out->residue = residue;
+	return inside;
+}
+
+#endif
@@ -0,0 +1,261 @@
+#include "zstream.h"
+
+
+
+/* Recognise compressed data by its magic number.
+ */
+zformat_t zstream_format(const char* data, const size_t size)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	if (size >= 2 and p[0] == 0x1f and p[1] == 0x8b)
+		return ZFORMAT_GZIP;
+	if (size >= 4 and p[0] == 0x28 and p[1] == 0xb5 and p[2] == 0x2f and p[3] == 0xfd)
+		return ZFORMAT_ZSTD;
+	return ZFORMAT_NONE;
+}
+
+
+
+/* The state of the decoder on the producer thread.
+ */
+typedef struct zdecoder
+{
+	z_stream      gz;
+	size_t        offset;    // Input handed to zlib so far, which takes at most UINT_MAX bytes at a time.
+#ifdef STARBOARD_ZSTD
+	ZSTD_DStream* zs;
+	ZSTD_inBuffer in;
+#endif
+} zdecoder_t;
+
+
+
+/* Decompress gzip data into out until it is full or the input ends. Concatenated gzip members are read as one
+ * stream, as gunzip does, and anything after the last member is ignored.
+ * Returns: 0 more to come; 1 end of input; less than 0 error.
+ */
+static int _zstream_inflate(zstream_t* z, zdecoder_t* d, char* out, const size_t size, size_t* len)
+{
+	d->gz.next_out  = (Bytef*)out;
+	d->gz.avail_out = (uInt)size;
+	while (d->gz.avail_out > 0)
+	{
+		if (d->gz.avail_in == 0)
+		{
+			const size_t left = z->size - d->offset;
+			if (left == 0)    // The input ended in the middle of a member.
+				return -4;
+			d->gz.next_in   = (Bytef*)(z->data + d->offset);
+			d->gz.avail_in  = (left > UINT_MAX) ? UINT_MAX : (uInt)left;
+			d->offset      += d->gz.avail_in;
+		}
+		int e = inflate(&d->gz, Z_NO_FLUSH);
+		if (e == Z_STREAM_END)
+		{
+			const size_t next = d->offset - d->gz.avail_in;
+			if (zstream_format(z->data + next, z->size - next) != ZFORMAT_GZIP)
+			{
+				*len = size - d->gz.avail_out;
+				return 1;
+			}
+			inflateReset(&d->gz);
+		}
+		else if (e != Z_OK)
+			return (e == Z_MEM_ERROR) ? -2 : -5;
+	}
+	*len = size;
+	return 0;
+}
+
+
+
+#ifdef STARBOARD_ZSTD
+/* Decompress zstd data into out until it is full or the input ends. Concatenated frames are read as one stream.
+ * Returns: 0 more to come; 1 end of input; less than 0 error.
+ */
+static int _zstream_zstd(zstream_t* z, zdecoder_t* d, char* out, const size_t size, size_t* len)
+{
+	ZSTD_outBuffer o = {out, size, 0};
+	while (o.pos < o.size)
+	{
+		size_t e = ZSTD_decompressStream(d->zs, &o, &d->in);
+		if (ZSTD_isError(e))
+			return -5;
+		if (d->in.pos == d->in.size and o.pos < o.size)
+		{
+			*len = o.pos;
+			return (e == 0) ? 1 : -4;    // Otherwise the input ended in the middle of a frame.
+		}
+	}
+	*len = o.pos;
+	return 0;
+}
+#endif
+
+
+
+/* Thread entry point: fill the buffers of the ring in turn, waiting whenever the consumer falls behind.
+ */
+static void* _zstream_produce(void* arg)
+{
+	zstream_t* z = (zstream_t*)arg;
+	zdecoder_t d;
+	memset(&d, 0, sizeof(d));
+	int e = 0;
+	if (z->format == ZFORMAT_GZIP)
+		e = (inflateInit2(&d.gz, 15 + 16) == Z_OK) ? 0 : -2;    // + 16 expects a gzip header.
+#ifdef STARBOARD_ZSTD
+	else
+	{
+		d.zs = ZSTD_createDStream();
+		e    = (d.zs == NULL or ZSTD_isError(ZSTD_initDStream(d.zs))) ? -2 : 0;
+		d.in = (ZSTD_inBuffer){z->data, z->size, 0};
+	}
+#endif
+	
+	for (unsigned int i = 0; ; i = (i + 1) % STARBOARD_ZSTREAM_BUFFERS)
+	{
+		zbuffer_t* b = &z->ring[i];
+		pthread_mutex_lock(&z->lock);
+		while (b->full and not z->stop)
+			pthread_cond_wait(&z->emptied, &z->lock);
+		bool stop = z->stop;
+		pthread_mutex_unlock(&z->lock);
+		if (stop)
+			break;
+		
+		// Decompress outside the lock, so the consumer can parse the previous buffer meanwhile.
+		size_t len = 0;
+		if (e == 0)
+		{
+#ifdef STARBOARD_ZSTD
+			if (z->format == ZFORMAT_ZSTD)
+				e = _zstream_zstd(z, &d, b->memory + STARBOARD_ZSTREAM_HEADROOM, STARBOARD_ZSTREAM_SIZE, &len);
+			else
+#endif
+			e = _zstream_inflate(z, &d, b->memory + STARBOARD_ZSTREAM_HEADROOM, STARBOARD_ZSTREAM_SIZE, &len);
+		}
+		
+		pthread_mutex_lock(&z->lock);
+		b->len  = len;
+		b->last = (e != 0);
+		b->full = true;
+		if (e < 0)
+			z->e = e;
+		pthread_cond_signal(&z->filled);
+		pthread_mutex_unlock(&z->lock);
+		if (e != 0)
+			break;
+	}
+	
+	if (z->format == ZFORMAT_GZIP)
+		inflateEnd(&d.gz);
+#ifdef STARBOARD_ZSTD
+	else
+		ZSTD_freeDStream(d.zs);
+#endif
+	return NULL;
+}
+
+
+
+/* Start decompressing data on a producer thread. The data must stay mapped until zstream_close().
+ * Returns: 0 success; -1 unsupported format; -2 out of memory; -3 could not start thread.
+ */
+int zstream_open(zstream_t* z, const char* data, const size_t size, const zformat_t format)
+{
+#ifndef STARBOARD_ZSTD
+	if (format == ZFORMAT_ZSTD)
+	{
+		printf("[ERROR] %s.\n", "Built without zstd support (compile with -D STARBOARD_ZSTD -l zstd)");
+		return -1;
+	}
+#endif
+	if (format == ZFORMAT_NONE)
+		return -1;
+	
+	memset(z, 0, sizeof(*z));
+	z->data   = data;
+	z->size   = size;
+	z->format = format;
+	for (unsigned int i = 0; i < STARBOARD_ZSTREAM_BUFFERS; ++i)
+	{
+		z->ring[i].memory = (char*)malloc(STARBOARD_ZSTREAM_HEADROOM + STARBOARD_ZSTREAM_SIZE); // malloc memory
+		if (z->ring[i].memory == NULL)
+		{
+			for (unsigned int j = 0; j < i; ++j)
+				free(z->ring[j].memory);
+			return -2;
+		}
+	}
+	pthread_mutex_init(&z->lock, NULL);
+	pthread_cond_init(&z->filled, NULL);
+	pthread_cond_init(&z->emptied, NULL);
+	if (pthread_create(&z->producer, NULL, _zstream_produce, z))
+	{
+		z->stop = true;    // So zstream_close() does not wait for a thread that never started.
+		zstream_close(z);
+		return -3;
+	}
+	return 0;
+}
+
+
+
+/* Wait for the next buffer of decompressed data. Its len bytes start at *data, and the STARBOARD_ZSTREAM_HEADROOM
+ * bytes in front of it may be overwritten. Every buffer taken must be given back with zstream_release().
+ * Returns: 1 more buffers follow; 0 this is the last buffer; less than 0 decompression failed, and no buffer
+ * was taken.
+ */
+int zstream_next(zstream_t* z, char** data, size_t* len)
+{
+	zbuffer_t* b = &z->ring[z->next];
+	pthread_mutex_lock(&z->lock);
+	while (not b->full)
+		pthread_cond_wait(&z->filled, &z->lock);
+	int e = z->e;
+	pthread_mutex_unlock(&z->lock);
+	if (e < 0 and b->last)
+		return e;
+	
+	*data = b->memory + STARBOARD_ZSTREAM_HEADROOM;
+	*len  = b->len;
+	return b->last ? 0 : 1;
+}
+
+
+
+/* Give the buffer taken by zstream_next() back to the producer.
+ */
+void zstream_release(zstream_t* z)
+{
+	zbuffer_t* b = &z->ring[z->next];
+	pthread_mutex_lock(&z->lock);
+	b->full = false;
+	pthread_cond_signal(&z->emptied);
+	pthread_mutex_unlock(&z->lock);
+	z->next = (z->next + 1) % STARBOARD_ZSTREAM_BUFFERS;
+}
+
+
+
+/* Stop the producer, whether or not the stream was read to the end, and free the ring.
+ * Returns: 0 success; less than 0 the error that stopped decompression (-4 truncated; -5 corrupt).
+ */
+int zstream_close(zstream_t* z)
+{
+	pthread_mutex_lock(&z->lock);
+	bool started = not z->stop;
+	z->stop = true;
+	pthread_cond_broadcast(&z->emptied);
+	pthread_mutex_unlock(&z->lock);
+	if (started)
+		pthread_join(z->producer, NULL);
+	
+	pthread_cond_destroy(&z->filled);
+	pthread_cond_destroy(&z->emptied);
+	pthread_mutex_destroy(&z->lock);
+	for (unsigned int i = 0; i < STARBOARD_ZSTREAM_BUFFERS; ++i)
+		free(z->ring[i].memory);
+	return z->e;
+}
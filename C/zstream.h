@@ -0,0 +1,78 @@
+#ifndef STARBOARD_ZSTREAM
+#define STARBOARD_ZSTREAM
+
+#include <iso646.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <zlib.h>
+#ifdef STARBOARD_ZSTD
+#include <zstd.h>
+#endif
+
+
+//
+// Decompress a gzip or zstd file on a producer thread into a bounded ring of buffers, which a parser consumes in
+// order while the next buffers are being filled. zstd support is compiled in with -D STARBOARD_ZSTD -l zstd.
+//
+
+#define STARBOARD_ZSTREAM_BUFFERS  4
+#define STARBOARD_ZSTREAM_SIZE     (4 * 1024 * 1024)
+#define STARBOARD_ZSTREAM_HEADROOM (64 * 1024)    // Writable space in front of each buffer, for the consumer to
+                                                  // prepend a partial line carried over from the previous one.
+
+
+
+/* The compression formats that can be detected.
+ */
+typedef enum zformat
+{
+	ZFORMAT_NONE,
+	ZFORMAT_GZIP,
+	ZFORMAT_ZSTD
+} zformat_t;
+
+
+
+/* One buffer of the ring.
+ */
+typedef struct zbuffer
+{
+	char*  memory;    // STARBOARD_ZSTREAM_HEADROOM bytes of headroom, then STARBOARD_ZSTREAM_SIZE of data.
+	size_t len;
+	bool   full;
+	bool   last;      // No buffers follow this one.
+} zbuffer_t;
+
+
+
+/* A decompression stream over compressed data in memory.
+ */
+typedef struct zstream
+{
+	const char*     data;
+	size_t          size;
+	zformat_t       format;
+	zbuffer_t       ring[STARBOARD_ZSTREAM_BUFFERS];
+	unsigned int    next;       // The buffer the consumer will take next.
+	bool            stop;       // Set by the consumer to abandon the stream early.
+	int             e;          // Set by the producer on error.
+	pthread_t       producer;
+	pthread_mutex_t lock;
+	pthread_cond_t  filled;
+	pthread_cond_t  emptied;
+} zstream_t;
+
+
+
+extern zformat_t zstream_format(const char*, const size_t);
+
+extern int  zstream_open(zstream_t*, const char*, const size_t, const zformat_t);
+extern int  zstream_next(zstream_t*, char**, size_t*);
+extern void zstream_release(zstream_t*);
+extern int  zstream_close(zstream_t*);
+
+#endif
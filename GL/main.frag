@@ -18,6 +18,10 @@ float linearize_depth(float depth, float near, float far)
 
 void main(void) 
 {
+	// Hidden residues are transparent, and are not drawn at all.
+	if (fragment_color.w == 0.0) 
+		discard; 
+	
 	// Fade effect based on distance from camera.
 	//
 
@@ -1,16 +1,45 @@
 #version 330 
 
-layout(location = 0) in vec3 position; // This vertex shader assumes input is vec3 and adds own w-coordinate.
-layout(location = 1) in vec4 vertex_color; 
+layout(location = 0) in vec3 position; // Packed: quanta from the origin, each of them scale long.
+layout(location = 1) in uint residue; 
+layout(location = 2) in uint object;   // The slot of the object's transform. 
 
-uniform mat4 model; 
-uniform mat4 view; 
-uniform mat4 projection; 
+layout(std140) uniform Camera // Shared by every program, and uploaded only when the camera moves. 
+{ 
+	mat4 projection; 
+	mat4 view; 
+}; 
+
+uniform samplerBuffer object_transforms; // Of every object, by its slot: its model matrix, the origin and scale 
+                                         // of its packed vertices, and where its colours start, as in C/render.h. 
 
 out vec4 fragment_color; 
 
+#define STARBOARD_TRANSFORM_TEXELS 7       // As in C/scene.h.
+#define STARBOARD_OPERATOR_TEXELS  4       // As in C/scene.h.
+
+uniform int            instance_first;     // Where the operators of the copies drawn are listed, or -1 for none. 
+uniform usamplerBuffer instance_list;      // The operators of the copies in view, by their place among them all. 
+uniform samplerBuffer  instance_operators; // Of every copy: a matrix that moves it before its model matrix does. 
+
+/* The operator of the copy being drawn, if the object is drawn as copies. 
+ */
+mat4 instance_operator(void) 
+{ 
+	int base = STARBOARD_OPERATOR_TEXELS * int(texelFetch(instance_list, instance_first + gl_InstanceID).x); 
+	return mat4(texelFetch(instance_operators, base),     texelFetch(instance_operators, base + 1), \
+	            texelFetch(instance_operators, base + 2), texelFetch(instance_operators, base + 3)); 
+} 
+
 void main(void) 
 { 
-	gl_Position = projection * view * model * vec4(position, 1.0); 
-	fragment_color = vertex_color; 
+	int  base   = STARBOARD_TRANSFORM_TEXELS * int(object); 
+	mat4 model  = mat4(texelFetch(object_transforms, base),     texelFetch(object_transforms, base + 1), \
+	                   texelFetch(object_transforms, base + 2), texelFetch(object_transforms, base + 3)); 
+	if (instance_first >= 0) 
+		model = model * instance_operator(); 
+	vec3 origin = texelFetch(object_transforms, base + 4).xyz; 
+	vec3 scale  = texelFetch(object_transforms, base + 5).xyz; 
+	gl_Position = projection * view * model * vec4(origin + scale * position, 1.0); 
+	fragment_color = residue_color(residue, texelFetch(object_transforms, base + 6)); 
 } 
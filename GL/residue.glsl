@@ -0,0 +1,40 @@
+/* What every stage of every program shares, which is compiled in after the #version line of each (see 
+ * C/shader.h): how the colour of a residue is found. 
+ */
+
+#define STARBOARD_MAP_MASK        0xFFu     // The style of a residue, as in C/ribbon.h.
+#define STARBOARD_SELECTED        0x100u
+#define STARBOARD_HIDDEN          0x200u
+#define STARBOARD_HIGHLIGHTED     0x400u
+#define STARBOARD_COLORMAP_TEXELS 256.0     // As in C/colorwheel.h.
+
+uniform samplerBuffer  residue_colors;     // Colours are looked up by residue, rather than given for each vertex. 
+uniform usamplerBuffer residue_attributes; // As are where it falls in a colour map, and its style. 
+uniform sampler1DArray colormaps; 
+uniform bool           outline;            // An outline keeps its own colours, rather than taking a map's. 
+
+/* The colour of a residue: its own, or from its colour map, then lightened if it is highlighted and tinted if it 
+ * is selected. A hidden residue is transparent, which is not drawn. The colours of its object's residues, or of 
+ * their outlines, and their attributes start at x, y and z of starts. 
+ */
+vec4 residue_color(uint residue, vec4 starts) 
+{ 
+	const vec4 SELECTION = vec4(1.0, 0.85, 0.2, 1.0); 
+	vec4  color     = texelFetch(residue_colors, int(outline ? starts.y : starts.x) + int(residue)); 
+	uvec2 attributes = texelFetch(residue_attributes, int(starts.z) + int(residue)).xy; 
+	uint  map       = attributes.y & STARBOARD_MAP_MASK; 
+	if (map > 0u && !outline) 
+	{ 
+		// Sample between the centres of the first and last texels, so that 0 and 1 are the ends of the map. 
+		float t = clamp(uintBitsToFloat(attributes.x), 0.0, 1.0); 
+		color   = texture(colormaps, vec2((0.5 + t * (STARBOARD_COLORMAP_TEXELS - 1.0)) / STARBOARD_COLORMAP_TEXELS, \
+		                                  float(map - 1u))); 
+	} 
+	if ((attributes.y & STARBOARD_HIGHLIGHTED) != 0u) 
+		color = mix(color, vec4(1.0), 0.5); 
+	if ((attributes.y & STARBOARD_SELECTED) != 0u) 
+		color = outline ? SELECTION : mix(color, SELECTION, 0.3); 
+	if ((attributes.y & STARBOARD_HIDDEN) != 0u) 
+		color.w = 0.0; 
+	return color; 
+} 
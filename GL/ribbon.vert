@@ -0,0 +1,32 @@
+#version 330 
+
+layout(location = 0) in vec3  position; // The points of the curve, which the geometry shader extrudes.
+layout(location = 1) in vec3  normal; 
+layout(location = 2) in float pitch; 
+layout(location = 3) in uint  residue; 
+layout(location = 4) in uint  object;   // The slot of the object's transform. 
+
+out vec3      control_normal; 
+out float     control_pitch; 
+flat out uint control_residue; 
+flat out vec4 control_color; 
+flat out int  control_object; 
+flat out int  control_operator; // Of the copy, by its place among them all, or -1 for none. 
+
+#define STARBOARD_TRANSFORM_TEXELS 7       // As in C/scene.h.
+
+uniform samplerBuffer  object_transforms;  // Where the colours of each object start, among the rest (see main.vert). 
+uniform int            instance_first;     // Where the operators of the copies drawn are listed, or -1 for none. 
+uniform usamplerBuffer instance_list;      // The operators of the copies in view, by their place among them all. 
+
+void main(void) 
+{ 
+	gl_Position     = vec4(position, 1.0); 
+	control_normal  = normal; 
+	control_pitch   = pitch; 
+	control_residue = residue; 
+	control_color   = residue_color(residue, \
+	                                texelFetch(object_transforms, STARBOARD_TRANSFORM_TEXELS * int(object) + 6)); 
+	control_object  = int(object); 
+	control_operator = (instance_first < 0) ? -1 : int(texelFetch(instance_list, instance_first + gl_InstanceID).x); 
+} 